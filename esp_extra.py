@@ -1,15 +1,55 @@
 from SCons.Script import DefaultEnvironment
 
+import gzip
+import io
+import os
+import zlib
+
 env = DefaultEnvironment()
 
-env.Replace(
-    MYUPLOADERFLAGS=[
-        "-vv",
-        "-cd", "nodemcu",
-        "-cb", "$UPLOAD_SPEED",
-        "-cp", "$UPLOAD_PORT",
-        "-ca", "0x00000",
-        "-cf", "$SOURCE"
-    ],
-    UPLOADCMD='$UPLOADER $MYUPLOADERFLAGS',
-)
\ No newline at end of file
+#-- Static web assets (web/*) are gzip compressed into PROGMEM blobs so the
+#   browser can fetch them once and cache them (see mavesp8266_httpd.cpp).
+WEB_ASSETS = [
+    # (source file, symbol prefix)
+    ("mavesp.css", "kCSS"),
+    ("mavesp.js",  "kJS"),
+]
+
+def build_web_assets(project_dir):
+    web_dir = os.path.join(project_dir, "web")
+    out     = os.path.join(project_dir, "src", "mavesp8266_HtmlAssets.h")
+    lines = [
+        "//-- Generated by esp_extra.py from web/*. Do not edit.",
+        "#ifndef MAVESP8266_HTMLASSETS_H",
+        "#define MAVESP8266_HTMLASSETS_H",
+        "",
+    ]
+    for name, prefix in WEB_ASSETS:
+        with open(os.path.join(web_dir, name), "rb") as f:
+            raw = f.read()
+        buf = io.BytesIO()
+        #-- mtime=0 keeps the output (and therefore the ETag) reproducible
+        gz = gzip.GzipFile(filename="", mode="wb", compresslevel=9, fileobj=buf, mtime=0)
+        gz.write(raw)
+        gz.close()
+        data = bytearray(buf.getvalue())
+        etag = "%08x" % (zlib.crc32(bytes(data)) & 0xFFFFFFFF)
+        lines.append("//-- %s (%u bytes, %u compressed)" % (name, len(raw), len(data)))
+        lines.append("#define %s_ETAG \"%s\"" % (prefix, etag))
+        lines.append("#define %s_GZ_LEN %u" % (prefix, len(data)))
+        lines.append("const uint8_t PROGMEM %s_GZ[] = {" % prefix)
+        for i in range(0, len(data), 16):
+            lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+    lines.append("#endif")
+    content = "\n".join(lines) + "\n"
+    #-- Only touch the header if it changed to avoid needless rebuilds
+    if os.path.isfile(out):
+        with open(out, "r") as f:
+            if f.read() == content:
+                return
+    with open(out, "w") as f:
+        f.write(content)
+
+build_web_assets(env.subst("$PROJECT_DIR"))
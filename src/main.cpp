@@ -41,6 +41,14 @@
 #include "mavesp8266_vehicle.h"
 #include "mavesp8266_httpd.h"
 #include "mavesp8266_component.h"
+#include "mavesp8266_recorder.h"
+#include "mavesp8266_events.h"
+#include "mavesp8266_scheduler.h"
+#include "mavesp8266_paramcache.h"
+#include "mavesp8266_mission.h"
+#include "mavesp8266_logdata.h"
+#include "mavesp8266_ftp.h"
+#include "mavesp8266_telemetry.h"
 
 #include <ESP8266mDNS.h>
 
@@ -83,6 +91,14 @@ MavESP8266Vehicle       Vehicle;
 MavESP8266Httpd         updateServer;
 MavESP8266UpdateImp     updateStatus;
 MavESP8266Log           Logger;
+MavESP8266Recorder      Recorder;
+MavESP8266Events        Events;
+MavESP8266Scheduler     Scheduler;
+MavESP8266ParamCache    ParamCache;
+MavESP8266Mission       Mission;
+MavESP8266LogData       LogData;
+MavESP8266Ftp           Ftp;
+MavESP8266Telemetry     Telemetry;
 
 //---------------------------------------------------------------------------------
 //-- Accessors
@@ -93,6 +109,14 @@ public:
     MavESP8266Vehicle*      getVehicle      () { return &Vehicle;       }
     MavESP8266GCS*          getGCS          () { return &GCS;           }
     MavESP8266Log*          getLogger       () { return &Logger;        }
+    MavESP8266Recorder*     getRecorder     () { return &Recorder;      }
+    MavESP8266Events*       getEvents       () { return &Events;        }
+    MavESP8266Scheduler*    getScheduler    () { return &Scheduler;     }
+    MavESP8266ParamCache*   getParamCache   () { return &ParamCache;    }
+    MavESP8266Mission*      getMission      () { return &Mission;       }
+    MavESP8266LogData*      getLogData      () { return &LogData;       }
+    MavESP8266Ftp*          getFtp          () { return &Ftp;           }
+    MavESP8266Telemetry*    getTelemetry    () { return &Telemetry;     }
 };
 
 MavESP8266WorldImp      World;
@@ -102,6 +126,66 @@ MavESP8266World* getWorld()
     return &World;
 }
 
+//---------------------------------------------------------------------------------
+//-- Scheduler tasks. Each gets its budget (us) and returns true if it has more work.
+bool taskUart(uint32_t budget) {
+    if(Component.inRawMode()) {
+        Vehicle.readMessageRaw();
+    } else {
+        Vehicle.readMessage(budget);
+    }
+    return false;
+}
+
+bool taskUdp(uint32_t budget) {
+    if(Component.inRawMode()) {
+        GCS.readMessageRaw();
+    } else {
+        GCS.readMessage(budget);
+    }
+    return false;
+}
+
+bool taskFlush(uint32_t budget) {
+    Vehicle.flush();
+    return false;
+}
+
+bool taskRadioStatus(uint32_t budget) {
+    GCS.sendRadioStatus();
+    Vehicle.sendRadioStatus();
+    return false;
+}
+
+bool taskParameters(uint32_t budget) {
+    return Component.streamParameters(budget);
+}
+
+bool taskHttp(uint32_t budget) {
+    updateServer.checkUpdates(budget);
+    return false;
+}
+
+bool taskStorage(uint32_t budget) {
+    ParamCache.service();
+    Recorder.service();
+    return false;
+}
+
+bool taskParamCache(uint32_t budget) {
+    return ParamCache.stream(budget);
+}
+
+bool taskMission(uint32_t budget) {
+    Mission.service();
+    return false;
+}
+
+bool taskLogData(uint32_t budget) {
+    LogData.service();
+    return LogData.stream(budget);
+}
+
 //---------------------------------------------------------------------------------
 //-- Wait for a DHCPD client
 void wait_for_client() {
@@ -196,28 +280,42 @@ void setup() {
 
     Parameters.setLocalIPAddress(localIP);
     IPAddress gcs_ip(localIP);
-    //-- I'm getting bogus IP from the DHCP server. Broadcasting for now.
+    //-- GCS address unknown until it talks to us. Until then telemetry goes to
+    //   each station with a DHCP lease and only a heartbeat is broadcast.
     gcs_ip[3] = 255;
     GCS.begin((MavESP8266Bridge*)&Vehicle, gcs_ip);
     Vehicle.begin((MavESP8266Bridge*)&GCS);
+    Events.begin(Vehicle.rxPin());
+    //-- Autopilot parameter cache (before the telemetry log, which gets the rest of the flash)
+    ParamCache.begin();
+    //-- Telemetry log
+    Recorder.begin();
     //-- Initialize Update Server
     updateServer.begin(&updateStatus);
+    //-- Tasks (name, priority, period us, budget us). Tasks whose work can't be
+    //   split (a page written to flash, a status message) only use the budget
+    //   to count overruns.
+    Scheduler.add("uart",    TASK_PRIORITY_DATA,   0,       Parameters.getUartBudget(), taskUart);
+    Scheduler.add("udp",     TASK_PRIORITY_DATA,   0,       Parameters.getUdpBudget(),  taskUdp);
+    Scheduler.add("flush",   TASK_PRIORITY_DATA,   0,       1000, taskFlush);
+    Scheduler.add("status",  TASK_PRIORITY_HIGH,   1000000, 500,  taskRadioStatus);
+    Scheduler.add("params",  TASK_PRIORITY_NORMAL, 0,       1000, taskParameters);
+    Scheduler.add("fcparams",TASK_PRIORITY_NORMAL, 0,       2000, taskParamCache);
+    Scheduler.add("mission", TASK_PRIORITY_NORMAL, 50000,   500,  taskMission);
+    Scheduler.add("logdata", TASK_PRIORITY_NORMAL, 0,       2000, taskLogData);
+    Scheduler.add("http",    TASK_PRIORITY_LOW,    0,       HTTPD_TIME_BUDGET, taskHttp);
+    Scheduler.add("storage", TASK_PRIORITY_LOW,    0,       5000, taskStorage);
 }
 
 //---------------------------------------------------------------------------------
 //-- Main Loop
 void loop() {
-    if(!updateStatus.isUpdating()) {
-        if (Component.inRawMode()) {
-            GCS.readMessageRaw();
-            delay(0);
-            Vehicle.readMessageRaw();
-
-        } else {
-            GCS.readMessage();
-            delay(0);
-            Vehicle.readMessage();
-        }
+    //-- Only the update server runs while updating
+    if(updateStatus.isUpdating()) {
+        updateServer.checkUpdates();
+        return;
     }
-    updateServer.checkUpdates();
+    Scheduler.run();
+    //-- Sleep until either link has data or a task is due
+    Events.idle(min(Scheduler.idleTime(), min(GCS.idleTime(), Vehicle.idleTime())));
 }
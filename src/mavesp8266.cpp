@@ -38,6 +38,23 @@
 #include "mavesp8266.h"
 #include "mavesp8266_parameters.h"
 
+//-- Messages that can skip batching and queues. Bit n of FAST_LANE enables entry n.
+static const uint8_t kFastLane[] = {
+    MAVLINK_MSG_ID_HEARTBEAT,
+    MAVLINK_MSG_ID_COMMAND_ACK,
+    MAVLINK_MSG_ID_COMMAND_LONG,
+    MAVLINK_MSG_ID_COMMAND_INT,
+    MAVLINK_MSG_ID_SET_MODE,
+    MAVLINK_MSG_ID_MANUAL_CONTROL,
+    MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE,
+    MAVLINK_MSG_ID_SET_ATTITUDE_TARGET,
+    MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED,
+    MAVLINK_MSG_ID_SET_POSITION_TARGET_GLOBAL_INT,
+    MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL,
+};
+
+const uint32_t kLatencyLimits[LATENCY_BUCKETS - 1] = {250, 500, 1000, 2000, 5000};
+
 //---------------------------------------------------------------------------------
 //-- Base Comm Link
 MavESP8266Bridge::MavESP8266Bridge()
@@ -46,10 +63,10 @@ MavESP8266Bridge::MavESP8266Bridge()
     , _component_id(0)
     , _seq_expected(0)
     , _last_heartbeat(0)
-    , _last_status_time(0)
     , _forwardTo(NULL)
 {
     memset(&_status, 0, sizeof(_status));
+    memset(_fast_lane, 0, sizeof(_fast_lane));
 }
 
 //---------------------------------------------------------------------------------
@@ -58,6 +75,50 @@ void
 MavESP8266Bridge::begin(MavESP8266Bridge* forwardTo)
 {
     _forwardTo  = forwardTo;
+    uint32_t mask = getWorld()->getParameters()->getFastLane();
+    for(uint8_t i = 0; i < sizeof(kFastLane); i++) {
+        if(mask & (1UL << i)) {
+            _fast_lane[kFastLane[i] >> 5] |= 1UL << (kFastLane[i] & 31);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Bridge::addLatency(uint32_t us)
+{
+    int i = 0;
+    while(i < LATENCY_BUCKETS - 1 && us > kLatencyLimits[i]) {
+        i++;
+    }
+    _status.fast_latency.count[i]++;
+    _status.fast_latency.sum += us;
+    _status.fast_latency.max = max(_status.fast_latency.max, us);
+}
+
+//---------------------------------------------------------------------------------
+//-- Raw mode buffers only exist while in raw mode
+bool
+MavESP8266Bridge::beginRaw()
+{
+    return _raw.begin(RAW_BUFFER_SIZE);
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Bridge::endRaw()
+{
+    _raw.end();
+}
+
+//---------------------------------------------------------------------------------
+//-- RADIO_STATUS, once we know who is on the other side
+void
+MavESP8266Bridge::sendRadioStatus()
+{
+    if(_heard_from) {
+        _sendRadioStatus();
+    }
 }
 
 //---------------------------------------------------------------------------------
@@ -43,6 +43,8 @@
 #include <WiFiUdp.h>
 #include <mavlink.h>
 
+#include "mavesp8266_ring.h"
+
  extern "C" {
     // Espressif SDK
     #include "user_interface.h"
@@ -52,6 +54,14 @@ class MavESP8266Parameters;
 class MavESP8266Component;
 class MavESP8266Vehicle;
 class MavESP8266GCS;
+class MavESP8266Recorder;
+class MavESP8266Events;
+class MavESP8266Scheduler;
+class MavESP8266ParamCache;
+class MavESP8266Mission;
+class MavESP8266LogData;
+class MavESP8266Ftp;
+class MavESP8266Telemetry;
 
 #define DEFAULT_UART_SPEED          921600
 #define DEFAULT_WIFI_CHANNEL        11
@@ -60,6 +70,13 @@ class MavESP8266GCS;
 
 #define HEARTBEAT_TIMEOUT           10 * 1000
 
+//-- Raw (transparent) mode used for flashing the flight controller
+#define RAW_BUFFER_SIZE             4096        // Per direction, only allocated while in raw mode
+#define RAW_MAX_DATAGRAM            1472
+#define RAW_FLUSH_CHARS             3           // UART idle time (in characters) before sending a partial datagram
+#define RAW_REBOOT_TIMEOUT          5000        // Leave raw mode this long after the bootloader reboot command
+#define RAW_IDLE_TIMEOUT            30 * 1000   // Leave raw mode after this long without any traffic
+
 //-- TODO: This needs to come from the build system
 #define MAVESP8266_VERSION_MAJOR    1
 #define MAVESP8266_VERSION_MINOR    1
@@ -75,6 +92,17 @@ class MavESP8266GCS;
 #define DEBUG_LOG(format, ...) do { } while(0)
 #endif
 
+//---------------------------------------------------------------------------------
+//-- Time (us) fast lane messages spent in the bridge
+#define LATENCY_BUCKETS         6
+extern const uint32_t kLatencyLimits[LATENCY_BUCKETS - 1]; // Upper bound of each bucket but the last
+
+struct latencyHistogram {
+    uint32_t    count[LATENCY_BUCKETS];
+    uint32_t    max;
+    uint32_t    sum;        // Of all the times (wraps)
+};
+
 //---------------------------------------------------------------------------------
 //-- Link Status
 struct linkStatus {
@@ -83,6 +111,17 @@ struct linkStatus {
     uint32_t    packets_sent;
     uint32_t    radio_status_sent;
     uint8_t     queue_status;
+    uint32_t    raw_bytes_received;
+    uint32_t    raw_bytes_sent;
+    uint32_t    uart_overruns;
+    uint32_t    uart_errors;
+    uint32_t    budget_exhausted;   // Reads cut short by the drain budget with data still waiting
+    uint32_t    bytes_sent;
+    uint32_t    broadcast_bytes;    // Part of bytes_sent that went out as broadcast
+    uint32_t    discovery_held;     // Messages not forwarded while no GCS was known
+    uint32_t    send_retries;       // Messages kept for another try after a failed send (once per try)
+    uint32_t    send_abandoned;     // Messages given up on after failed sends
+    latencyHistogram fast_latency;  // Fast lane messages sent out this link
 };
 
 //---------------------------------------------------------------------------------
@@ -92,15 +131,22 @@ public:
     MavESP8266Bridge();
     virtual ~MavESP8266Bridge(){;}
     virtual void    begin           (MavESP8266Bridge* forwardTo);
-    virtual void    readMessage     () = 0;
+    virtual void    readMessage     (uint32_t budget) = 0; // Read (and forward) for up to budget us
     virtual void    readMessageRaw  () = 0;
     virtual int     sendMessage     (mavlink_message_t* message, int count) = 0;
     virtual int     sendMessage     (mavlink_message_t* message) = 0;
     virtual int     sendMessagRaw   (uint8_t *buffer, int len) = 0;
+    virtual bool    beginRaw        ();
+    virtual void    endRaw          ();
+    virtual unsigned long idleTime  () = 0; // How long (us) the link can go without being serviced
+    virtual bool    sendBusy        () { return false; } // Too backed up to take more messages for now
+    virtual void    sendRadioStatus ();
     virtual bool    heardFrom       () { return _heard_from;    }
     virtual uint8_t systemID        () { return _system_id;     }
     virtual uint8_t componentID     () { return _component_id;  }
     virtual linkStatus* getStatus   () { return &_status;       }
+    bool            isFastLane      (uint32_t msgid) { return msgid < 256 && (_fast_lane[msgid >> 5] & (1UL << (msgid & 31))); } // MAVLink 2 ids above 255 never are
+    void            addLatency      (uint32_t us); // A fast lane message went out this link
 protected:
     virtual void    _checkLinkErrors(mavlink_message_t* msg);
     virtual void    _sendRadioStatus() = 0;
@@ -111,8 +157,9 @@ protected:
     uint8_t                 _seq_expected;
     uint32_t                _last_heartbeat;
     linkStatus              _status;
-    unsigned long           _last_status_time;
     MavESP8266Bridge*       _forwardTo;
+    uint32_t                _fast_lane[8];  // msgid bitmap, from FAST_LANE
+    MavESP8266Ring          _raw; // Raw mode data received on this link waiting to go out the other one
 };
 
 //---------------------------------------------------------------------------------
@@ -142,6 +189,14 @@ public:
     virtual MavESP8266Vehicle*      getVehicle      () = 0;
     virtual MavESP8266GCS*          getGCS          () = 0;
     virtual MavESP8266Log*          getLogger       () = 0;
+    virtual MavESP8266Recorder*     getRecorder     () = 0;
+    virtual MavESP8266Events*       getEvents       () = 0;
+    virtual MavESP8266Scheduler*    getScheduler    () = 0;
+    virtual MavESP8266ParamCache*   getParamCache   () = 0;
+    virtual MavESP8266Mission*      getMission      () = 0;
+    virtual MavESP8266LogData*      getLogData      () = 0;
+    virtual MavESP8266Ftp*          getFtp          () = 0;
+    virtual MavESP8266Telemetry*    getTelemetry    () = 0;
 };
 
 //---------------------------------------------------------------------------------
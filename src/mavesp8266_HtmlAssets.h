@@ -0,0 +1,73 @@
+//-- Generated by esp_extra.py from web/*. Do not edit.
+#ifndef MAVESP8266_HTMLASSETS_H
+#define MAVESP8266_HTMLASSETS_H
+
+//-- mavesp.css (1377 bytes, 536 compressed)
+#define kCSS_ETAG "4dbf8489"
+#define kCSS_GZ_LEN 536
+const uint8_t PROGMEM kCSS_GZ[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0xd5, 0x53, 0x4d, 0x8f, 0xda, 0x30,
+    0x10, 0xbd, 0xf7, 0x57, 0x44, 0xa0, 0xde, 0x30, 0x0a, 0xb0, 0x10, 0xea, 0x68, 0x57, 0x5a, 0xad,
+    0x44, 0x6f, 0x3d, 0x54, 0xbd, 0x55, 0x3d, 0x38, 0xc9, 0x24, 0xb1, 0x30, 0x76, 0x64, 0x3b, 0x25,
+    0x2c, 0xda, 0xff, 0x5e, 0x8f, 0xf3, 0x01, 0x01, 0xed, 0x6a, 0xaf, 0x95, 0x95, 0xc8, 0x99, 0xcc,
+    0xc7, 0x9b, 0x79, 0x6f, 0xe6, 0x09, 0x33, 0x3c, 0x25, 0x85, 0x86, 0xd3, 0xf9, 0xc0, 0x74, 0xc1,
+    0x25, 0x11, 0x90, 0x5b, 0xca, 0x6a, 0xab, 0xe2, 0xce, 0xa0, 0x79, 0x51, 0x0e, 0x96, 0x86, 0x1c,
+    0x79, 0x66, 0x4b, 0xba, 0x0d, 0xc3, 0xaa, 0x89, 0x13, 0x96, 0xee, 0x0b, 0xad, 0x6a, 0x99, 0xd1,
+    0x69, 0x1e, 0xe1, 0x89, 0x2b, 0x96, 0x65, 0x5c, 0x16, 0x74, 0xb9, 0xae, 0x9a, 0x60, 0x81, 0xaf,
+    0xf6, 0x86, 0xee, 0xb9, 0x92, 0x96, 0x2e, 0x96, 0xee, 0xf3, 0x3b, 0x28, 0x97, 0x9b, 0xcd, 0x26,
+    0xbf, 0xf8, 0x01, 0x4c, 0xf0, 0x03, 0x8e, 0xc1, 0x4f, 0x75, 0x60, 0x72, 0x32, 0xf3, 0x86, 0x99,
+    0x01, 0xcd, 0xf3, 0x38, 0x55, 0x42, 0x69, 0x3a, 0xdd, 0x6e, 0xb7, 0xb1, 0x85, 0xc6, 0x12, 0x53,
+    0xb2, 0x4c, 0x1d, 0xe9, 0x02, 0xf3, 0x75, 0xcf, 0x74, 0xb7, 0xdb, 0xc5, 0x89, 0xd2, 0x19, 0x68,
+    0x6f, 0x37, 0x4a, 0xf0, 0x2c, 0x98, 0xc2, 0x03, 0x9e, 0xb7, 0xf9, 0xa5, 0xbd, 0xa0, 0x5c, 0x9c,
+    0xb1, 0x3e, 0x31, 0xfc, 0x15, 0x3c, 0xba, 0x01, 0x6a, 0x18, 0x84, 0x1e, 0x5f, 0xf0, 0x80, 0x20,
+    0x33, 0x6e, 0x2a, 0xc1, 0x4e, 0x34, 0x11, 0x2a, 0xdd, 0x77, 0xa9, 0x49, 0xa2, 0xac, 0x55, 0x87,
+    0xfb, 0x0a, 0xdd, 0x8c, 0x28, 0xf1, 0xf1, 0xc4, 0xf7, 0xbb, 0x6a, 0xaf, 0x98, 0xeb, 0xd2, 0xc0,
+    0x0d, 0x94, 0x27, 0x53, 0x31, 0x79, 0x1e, 0x97, 0xba, 0xa0, 0x5b, 0xb8, 0x3a, 0xa3, 0x00, 0xc1,
+    0x12, 0x10, 0x37, 0xee, 0x5d, 0xe5, 0xf0, 0xde, 0xb1, 0x4d, 0x9e, 0x0b, 0xc5, 0x2c, 0x45, 0x36,
+    0xe3, 0x96, 0xb2, 0x65, 0xf8, 0xb5, 0x1d, 0x23, 0x13, 0xbc, 0x90, 0xd4, 0xd3, 0xda, 0xcf, 0xa0,
+    0x23, 0xd9, 0x83, 0xee, 0x68, 0xb7, 0xaa, 0xa2, 0x1f, 0x35, 0xc1, 0x65, 0x55, 0xdb, 0xdf, 0xf6,
+    0x54, 0xc1, 0xe3, 0x04, 0xd3, 0x4e, 0xfe, 0xcc, 0xde, 0xfb, 0x5d, 0x31, 0x63, 0x8e, 0x6e, 0x90,
+    0x37, 0x2e, 0x18, 0xc5, 0x34, 0xb0, 0x91, 0xd1, 0x80, 0x80, 0xd4, 0x9e, 0xef, 0x29, 0xcd, 0x18,
+    0x9e, 0x6b, 0x4d, 0x94, 0xe0, 0x41, 0xaf, 0xae, 0x40, 0xf7, 0x3c, 0x6d, 0x2e, 0xa6, 0xb6, 0xb3,
+    0xcd, 0xb8, 0x31, 0xa7, 0xc1, 0x58, 0xd5, 0x56, 0x70, 0x09, 0x8e, 0x7e, 0xa9, 0x24, 0x0c, 0x6a,
+    0x58, 0x21, 0x85, 0xdd, 0x83, 0x2a, 0x69, 0x87, 0x17, 0xb9, 0xe1, 0x5d, 0x11, 0x84, 0xf1, 0x18,
+    0x4c, 0x3a, 0x0c, 0x48, 0xbc, 0xd3, 0x4a, 0xd3, 0x4b, 0x94, 0x4b, 0x03, 0x16, 0x65, 0x85, 0xaa,
+    0x42, 0x99, 0x42, 0x8a, 0x27, 0x26, 0x07, 0xf5, 0x4a, 0x3e, 0xe3, 0x77, 0x84, 0x64, 0xcf, 0xed,
+    0x27, 0x5c, 0x47, 0x9c, 0x24, 0xb5, 0x6b, 0x5f, 0x9e, 0xaf, 0xd7, 0x12, 0x96, 0xd1, 0x3a, 0x5a,
+    0xf7, 0x2b, 0x12, 0x0e, 0x6d, 0x7a, 0xc1, 0x0e, 0xab, 0xe9, 0x6f, 0xfd, 0x6c, 0xdb, 0x95, 0x6a,
+    0x6e, 0xd7, 0x0d, 0x7d, 0xa7, 0xc9, 0x06, 0x4f, 0xbf, 0x16, 0x9a, 0x65, 0xbc, 0x36, 0x38, 0xb2,
+    0xf7, 0x17, 0xf4, 0x1b, 0xac, 0xf2, 0x95, 0xdb, 0xe5, 0x5a, 0x1b, 0x97, 0xbc, 0x52, 0x5c, 0x5a,
+    0xd0, 0x23, 0xd4, 0xf3, 0x16, 0xf6, 0x4b, 0xc9, 0x64, 0x01, 0x23, 0xf0, 0x79, 0x18, 0xfe, 0x0f,
+    0xc8, 0x69, 0xa9, 0xfe, 0x82, 0x1e, 0x21, 0x7f, 0xd9, 0x45, 0xcf, 0xd1, 0xf3, 0xdb, 0x97, 0x7f,
+    0xbe, 0xea, 0x2c, 0xae, 0x61, 0x05, 0x00, 0x00,
+};
+
+//-- mavesp.js (721 bytes, 352 compressed)
+#define kJS_ETAG "fc681a24"
+#define kJS_GZ_LEN 352
+const uint8_t PROGMEM kJS_GZ[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0x95, 0x52, 0x4d, 0x4f, 0xc2, 0x30,
+    0x18, 0xbe, 0xf3, 0x2b, 0x6a, 0x43, 0xc2, 0x9a, 0x91, 0xca, 0x7d, 0x36, 0x46, 0xd4, 0x83, 0x17,
+    0x4e, 0xc6, 0x0b, 0xe1, 0xd0, 0x6d, 0xdd, 0x56, 0x2d, 0x2d, 0xe9, 0x07, 0x84, 0x2c, 0xfb, 0xef,
+    0xbe, 0xdd, 0xc4, 0xa1, 0x21, 0x12, 0x6f, 0x7d, 0xd3, 0xe7, 0xeb, 0x7d, 0xda, 0x2a, 0xe8, 0xc2,
+    0x4b, 0xa3, 0xd1, 0x34, 0x91, 0x25, 0x69, 0xad, 0xf0, 0xc1, 0x6a, 0x54, 0x9a, 0x22, 0x6c, 0x85,
+    0xf6, 0xb4, 0x16, 0xfe, 0x59, 0x89, 0x78, 0x5c, 0x1e, 0x5f, 0xca, 0x08, 0xc9, 0xba, 0x49, 0x75,
+    0xe2, 0x48, 0xbd, 0x0b, 0x3e, 0x57, 0xc1, 0x26, 0x26, 0x7f, 0x27, 0xed, 0x9e, 0x5b, 0x94, 0x7b,
+    0xcd, 0x60, 0xa0, 0x3b, 0x6e, 0x81, 0xb4, 0x32, 0xa5, 0x38, 0x3f, 0x8e, 0x72, 0x6e, 0x79, 0x7c,
+    0xe5, 0xf5, 0x8a, 0x6f, 0x45, 0x82, 0xf3, 0xe0, 0xbd, 0xd1, 0x98, 0xac, 0x17, 0x9b, 0x4c, 0x56,
+    0x51, 0x2b, 0x02, 0x1f, 0xbc, 0xb7, 0x12, 0xae, 0x00, 0x60, 0x54, 0xf9, 0xc6, 0x55, 0x10, 0x98,
+    0xdc, 0x30, 0x1d, 0x94, 0x22, 0xed, 0x55, 0x58, 0xbc, 0xdd, 0xc7, 0x81, 0xb4, 0x10, 0x89, 0xba,
+    0x1f, 0xc0, 0x42, 0x71, 0xe7, 0xf0, 0xfc, 0xcb, 0xf8, 0xb1, 0xe1, 0xba, 0x06, 0x52, 0x27, 0x94,
+    0x13, 0x7f, 0xa0, 0x01, 0xd1, 0x75, 0xd9, 0xaf, 0xed, 0x2b, 0x68, 0xca, 0x0d, 0xeb, 0x5f, 0xca,
+    0x34, 0x3b, 0x65, 0x9a, 0x11, 0xc4, 0x18, 0x1a, 0xc2, 0x47, 0x94, 0xbb, 0x8c, 0x9a, 0x8f, 0xb9,
+    0xbb, 0xf3, 0xa6, 0x1d, 0xdf, 0x8b, 0xb1, 0xe4, 0xde, 0xf9, 0xdf, 0x35, 0xf7, 0xac, 0xa1, 0xe5,
+    0x83, 0xd4, 0xa5, 0x39, 0x50, 0x65, 0x0a, 0x1e, 0xe5, 0x69, 0x63, 0x45, 0xc5, 0xf0, 0x2d, 0x84,
+    0x02, 0x15, 0x00, 0x7b, 0x61, 0xdd, 0x3d, 0x46, 0x69, 0x4f, 0xa1, 0xb2, 0x44, 0x29, 0xc2, 0x0c,
+    0xe6, 0xc1, 0x79, 0x08, 0x78, 0x1e, 0x2f, 0x07, 0xbd, 0xa5, 0xd7, 0xc9, 0xf7, 0x1f, 0x70, 0x6c,
+    0x0a, 0xc5, 0x19, 0x5d, 0xc9, 0xfa, 0x89, 0x7b, 0x8e, 0xc9, 0x95, 0xa7, 0xcf, 0x2a, 0x63, 0x93,
+    0x7e, 0x35, 0xb6, 0xc8, 0xe4, 0x5d, 0x54, 0xa0, 0x4a, 0xe8, 0xda, 0x37, 0x99, 0x4c, 0xd3, 0xfe,
+    0x0d, 0xdd, 0x5a, 0x6e, 0xa8, 0xd1, 0x85, 0x92, 0xc5, 0x07, 0x3b, 0x39, 0x83, 0x63, 0x5f, 0x8d,
+    0x6f, 0xa4, 0x83, 0xaf, 0xd9, 0x75, 0x93, 0x4f, 0xe0, 0x10, 0xce, 0xe5, 0xd1, 0x02, 0x00, 0x00,
+};
+
+#endif
@@ -1,13 +1,18 @@
+#include "mavesp8266_HtmlAssets.h"
+
 const char PROGMEM kTEXTPLAIN[]  = "text/plain";
 const char PROGMEM kTEXTHTML[]   = "text/html";
 const char PROGMEM kAPPJSON[]    = "application/json";
+const char PROGMEM kTEXTCSS[]    = "text/css";
+const char PROGMEM kAPPJS[]      = "application/javascript";
+const char PROGMEM kOCTETSTREAM[] = "application/octet-stream";
 const char PROGMEM kACCESSCTL[]  = "Access-Control-Allow-Origin";
 const char PROGMEM kBADARG[]     = "BAD ARGS";
 
 
 //-----------------------------------------Web Template-------------------------------------------
 const char PROGMEM kTEMPLATE[]     = R"=====(
-<!DOCTYPE html><html><head><meta charset="UTF-8"><title>MavLink Bridge</title><style>.basic-grey{margin-left:auto;margin-right:auto;max-width:800px;background:#f7f7f7;padding:25px 15px 25px 10px;font:12px Georgia,"Times New Roman",Times,serif;color:#888;text-shadow:1px 1px 1px #FFF;border:1px solid #e4e4e4}.basic-grey h1{font-size:25px;padding:0 0 10px 40px;display:block;border-bottom:1px solid #e4e4e4;margin:-10px -15px 30px -10px;color:#888}.basic-grey h1>span{display:block;font-size:11px}.basic-grey label{display:block;margin:0}.basic-grey label>span{float:left;width:20%;text-align:right;padding-right:10px;margin-top:10px;color:#888}.basic-grey input[type="text"],.basic-grey input[type="password"],.basic-grey textarea,.basic-grey select{border:1px solid #dadada;color:#888;height:30px;margin-bottom:16px;margin-right:6px;margin-top:2px;outline:0 none;padding:3px 3px 3px 5px;width:70%;font-size:12px;line-height:15px;box-shadow:inset 0 1px 4px #ececec;-moz-box-shadow:inset 0 1px 4px #ececec;-webkit-box-shadow:inset 0 1px 4px #ececec}.basic-grey button{background:#e27575;border:0;padding:10px 25px 10px 25px;color:#FFF;box-shadow:1px 1px 5px #b6b6b6;border-radius:3px;text-shadow:1px 1px 1px #9e3f3f;cursor:pointer}.basic-grey .buttonChange{background:#f00;border:0;padding:10px 25px 10px 25px;color:#FFF;box-shadow:1px 1px 5px #b6b6b6;border-radius:3px;text-shadow:1px 1px 1px #9e3f3f;cursor:pointer}.basic-grey .button:hover{background:#CF7A7A}</style>
+<!DOCTYPE html><html><head><meta charset="UTF-8"><title>MavLink Bridge</title><link rel="stylesheet" href="/mavesp.css?v=)=====" kCSS_ETAG R"=====("><script src="/mavesp.js?v=)=====" kJS_ETAG R"=====("></script>
 </head>
 <body class="basic-grey">
 <h1><span><a href="/getsysconfig">System Config</a> | <a href="/getapconfig">AP MODE Config</a> | <a href="/getstaconfig">STA MODE Config</a> |<a href="/getstatus">Status</a> | <a href="/update">OTA</a> | <a href="/help">HELP</a> | <a href="/setparameters?reboot=1">Reboot</a> </span></h1>
@@ -16,13 +21,6 @@ const char PROGMEM kTEMPLATE[]     = R"=====(
 )=====";
 //------------------------------------------System Config------------------------------------------
 const char PROGMEM kSYSTEMCFG[]     = R"=====(
-<script>
-	function $(id){return document.getElementById(id);}
-	function inputblur(obj){var btn=obj.parentNode.parentNode.getElementsByTagName("button")[0];if(obj.getAttribute("oldValue")!=null){if(obj.getAttribute("oldValue")!=obj.value){btn.setAttribute("class","buttonChange")}else{btn.setAttribute("class","")}}};
-	function inputfocus(obj){if(obj.getAttribute('oldValue') == null){obj.setAttribute('oldValue',obj.value)};}
-	function save(obj){var input=obj.parentNode.parentNode.getElementsByTagName("input")[0];window.location.href="/setparameters?" +input.id + "=" + input.value;}
-	function bindBtn(){var btns=$("configData").getElementsByTagName("button");for(var i=0;i<btns.length;i++){btns[i].onclick=function(){save(this);}}}
-</script>
 <h1>System Config
 <span>
 <table id="configData" border='1' cellpadding='3' cellspacing='0' bordercolor='#999999' width="90%">
@@ -35,13 +33,6 @@ const char PROGMEM kSYSTEMCFG[]     = R"=====(
 )=====";
 //------------------------------------------AP Mode Config------------------------------------------
 const char PROGMEM kAPMODECFG[]     = R"=====(
-<script>
-	function $(id){return document.getElementById(id);}
-	function inputblur(obj){var btn=obj.parentNode.parentNode.getElementsByTagName("button")[0];if(obj.getAttribute("oldValue")!=null){if(obj.getAttribute("oldValue")!=obj.value){btn.setAttribute("class","buttonChange")}else{btn.setAttribute("class","")}}};
-	function inputfocus(obj){if(obj.getAttribute('oldValue') == null){obj.setAttribute('oldValue',obj.value)};}
-	function save(obj){var input=obj.parentNode.parentNode.getElementsByTagName("input")[0];window.location.href="/setparameters?" +input.id + "=" + input.value;}
-	function bindBtn(){var btns=$("configData").getElementsByTagName("button");for(var i=0;i<btns.length;i++){btns[i].onclick=function(){save(this);}}}
-</script>
 <h1>System Config
 <span>
 <table id="configData" border='1' cellpadding='3' cellspacing='0' bordercolor='#999999' width="90%">
@@ -55,13 +46,6 @@ const char PROGMEM kAPMODECFG[]     = R"=====(
 
 //------------------------------------------STA Mode Config------------------------------------------
 const char PROGMEM kSTAMODECFG[]     = R"=====(
-<script>
-	function $(id){return document.getElementById(id);}
-	function inputblur(obj){var btn=obj.parentNode.parentNode.getElementsByTagName("button")[0];if(obj.getAttribute("oldValue")!=null){if(obj.getAttribute("oldValue")!=obj.value){btn.setAttribute("class","buttonChange")}else{btn.setAttribute("class","")}}};
-	function inputfocus(obj){if(obj.getAttribute('oldValue') == null){obj.setAttribute('oldValue',obj.value)};}
-	function save(obj){var input=obj.parentNode.parentNode.getElementsByTagName("input")[0];window.location.href="/setparameters?" +input.id + "=" + input.value;}
-	function bindBtn(){var btns=$("configData").getElementsByTagName("button");for(var i=0;i<btns.length;i++){btns[i].onclick=function(){save(this);}}}
-</script>
 <h1>System Config
 <span>
 <table id="configData" border='1' cellpadding='3' cellspacing='0' bordercolor='#999999' width="90%">
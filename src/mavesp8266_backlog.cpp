@@ -0,0 +1,252 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_backlog.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_backlog.h"
+
+#define BACKLOG_RECORD  (sizeof(unsigned long) + sizeof(uint16_t))
+
+//---------------------------------------------------------------------------------
+MavESP8266Backlog::MavESP8266Backlog()
+    : _slots(NULL)
+    , _slot_next(0)
+    , _max_age(0)
+    , _releasing(false)
+    , _kept(0)
+    , _sent(0)
+    , _dropped(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------
+//-- Start keeping messages (or keep going if the GCS left again before it got them all)
+bool
+MavESP8266Backlog::begin(uint16_t seconds)
+{
+    _releasing = false;
+    _max_age   = seconds * 1000UL;
+    if(_slots || !seconds) {
+        return _slots != NULL;
+    }
+    if(ESP.getFreeHeap() < BACKLOG_URGENT_SIZE + BACKLOG_EVENTS_SIZE + BACKLOG_SLOTS * sizeof(backlogSlot) + BACKLOG_HEAP_RESERVE) {
+        getWorld()->getLogger()->log("GCS backlog: no room, not keeping messages\n");
+        return false;
+    }
+    _slots = (backlogSlot*)calloc(BACKLOG_SLOTS, sizeof(backlogSlot));
+    if(!_slots || !_urgent.begin(BACKLOG_URGENT_SIZE) || !_events.begin(BACKLOG_EVENTS_SIZE)) {
+        end();
+        return false;
+    }
+    _slot_next = 0;
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Backlog::end()
+{
+    free(_slots);
+    _slots     = NULL;
+    _urgent.end();
+    _events.end();
+    _releasing = false;
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266Backlog::_stale(unsigned long time)
+{
+    return (millis() - time) > _max_age;
+}
+
+//---------------------------------------------------------------------------------
+//-- Messages that only mean something as an answer to the GCS (or that it will
+//   get again anyway) are not kept. Slots hold 8-bit ids, so neither are MAVLink 2
+//   ids above 255.
+bool
+MavESP8266Backlog::_latest(uint32_t msgid)
+{
+    if(msgid > 255) {
+        return false;
+    }
+    switch(msgid) {
+        case MAVLINK_MSG_ID_HEARTBEAT:
+        case MAVLINK_MSG_ID_PARAM_VALUE:
+        case MAVLINK_MSG_ID_MISSION_ITEM:
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST:
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_COUNT:
+        case MAVLINK_MSG_ID_MISSION_ACK:
+        case MAVLINK_MSG_ID_LOG_ENTRY:
+        case MAVLINK_MSG_ID_LOG_DATA:
+        case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+        case MAVLINK_MSG_ID_TIMESYNC:
+            return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Add a frame to an event ring, making room by dropping the oldest
+void
+MavESP8266Backlog::_push(MavESP8266Ring* ring, const uint8_t* frame, uint16_t len)
+{
+    while(ring->space() < BACKLOG_RECORD + len && ring->available()) {
+        uint16_t old;
+        ring->peek(sizeof(unsigned long), (uint8_t*)&old, sizeof(old));
+        ring->consume(BACKLOG_RECORD + old);
+        _dropped++;
+    }
+    unsigned long now = millis();
+    ring->write((uint8_t*)&now, sizeof(now));
+    ring->write((uint8_t*)&len, sizeof(len));
+    ring->write(frame, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- A message the vehicle sent while nobody was listening
+void
+MavESP8266Backlog::keep(mavlink_message_t* message)
+{
+    if(!_slots || _releasing) {
+        return;
+    }
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+    if(message->msgid == MAVLINK_MSG_ID_STATUSTEXT || message->msgid == MAVLINK_MSG_ID_COMMAND_ACK) {
+        uint16_t len = mavlink_msg_to_send_buffer(frame, message);
+        bool urgent = message->msgid == MAVLINK_MSG_ID_COMMAND_ACK ||
+            mavlink_msg_statustext_get_severity(message) <= MAV_SEVERITY_WARNING;
+        _push(urgent ? &_urgent : &_events, frame, len);
+        _kept++;
+        return;
+    }
+    if(!_latest(message->msgid) || message->len + MAVLINK_NUM_NON_PAYLOAD_BYTES > BACKLOG_SLOT_LEN) {
+        return;
+    }
+    backlogSlot* slot = NULL;
+    for(uint8_t i = 0; i < BACKLOG_SLOTS; i++) {
+        if(!_slots[i].len || _slots[i].msgid == message->msgid) {
+            slot = &_slots[i];
+            break;
+        }
+    }
+    if(!slot) {
+        _dropped++;
+        return;
+    }
+    if(!slot->len) {
+        _kept++;
+    }
+    slot->msgid = message->msgid;
+    slot->len   = mavlink_msg_to_send_buffer(slot->frame, message);
+    slot->time  = millis();
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Backlog::release()
+{
+    if(_slots) {
+        _releasing = true;
+        _slot_next = 0;
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Length of the oldest frame in a ring that is still fresh (0 if none)
+uint16_t
+MavESP8266Backlog::_ringNext(MavESP8266Ring* ring)
+{
+    while(ring->available()) {
+        unsigned long time;
+        uint16_t len;
+        ring->peek(0, (uint8_t*)&time, sizeof(time));
+        ring->peek(sizeof(time), (uint8_t*)&len, sizeof(len));
+        if(!_stale(time)) {
+            return len;
+        }
+        ring->consume(BACKLOG_RECORD + len);
+        _dropped++;
+    }
+    return 0;
+}
+
+//---------------------------------------------------------------------------------
+uint16_t
+MavESP8266Backlog::nextLength()
+{
+    if(!_releasing) {
+        return 0;
+    }
+    uint16_t len = _ringNext(&_urgent);
+    if(!len) {
+        len = _ringNext(&_events);
+    }
+    while(!len && _slot_next < BACKLOG_SLOTS) {
+        backlogSlot* slot = &_slots[_slot_next];
+        if(slot->len && !_stale(slot->time)) {
+            len = slot->len;
+        } else {
+            _dropped += slot->len ? 1 : 0;
+            _slot_next++;
+        }
+    }
+    if(!len) {
+        end();
+    }
+    return len;
+}
+
+//---------------------------------------------------------------------------------
+//-- Copy out the frame nextLength() measured
+void
+MavESP8266Backlog::take(uint8_t* buffer)
+{
+    MavESP8266Ring* ring = _urgent.available() ? &_urgent : (_events.available() ? &_events : NULL);
+    if(ring) {
+        uint16_t len;
+        ring->peek(sizeof(unsigned long), (uint8_t*)&len, sizeof(len));
+        ring->peek(BACKLOG_RECORD, buffer, len);
+        ring->consume(BACKLOG_RECORD + len);
+    } else {
+        memcpy(buffer, _slots[_slot_next].frame, _slots[_slot_next].len);
+        _slot_next++;
+    }
+    _sent++;
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_backlog.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_BACKLOG_H
+#define MAVESP8266_BACKLOG_H
+
+#include "mavesp8266.h"
+#include "mavesp8266_ring.h"
+
+//-- What the vehicle said while the GCS was gone, sent to it when it comes back:
+//   warnings and command results first, other STATUSTEXT next and then the last
+//   value of each message. Nothing older than GCS_BACKLOG seconds is sent.
+#define BACKLOG_LATE            3000    // Start keeping once the GCS heartbeat is this late (ms)
+#define BACKLOG_URGENT_SIZE     1024    // STATUSTEXT up to MAV_SEVERITY_WARNING and COMMAND_ACK
+#define BACKLOG_EVENTS_SIZE     1024    // Other STATUSTEXT
+#define BACKLOG_SLOTS           20      // Last value of this many msgids
+#define BACKLOG_SLOT_LEN        64      // Largest frame kept as a last value
+#define BACKLOG_HEAP_RESERVE    (8 * 1024)      // RAM left free after allocating
+#define BACKLOG_BATCH           4       // Messages per datagram when sending it
+#define BACKLOG_PACE            20      // Time between those datagrams (ms)
+
+class MavESP8266Backlog {
+public:
+    MavESP8266Backlog();
+
+    bool        begin           (uint16_t seconds); // The GCS is gone
+    void        end             ();
+    void        keep            (mavlink_message_t* message);
+    void        release         ();                 // The GCS is back
+    //-- Next frame to send (0 when done). take() copies it out.
+    uint16_t    nextLength      ();
+    void        take            (uint8_t* buffer);
+    bool        active          () { return _slots != NULL; }
+    bool        releasing       () { return _releasing; }
+    //-- Status
+    uint32_t    kept            () { return _kept; }
+    uint32_t    sent            () { return _sent; }
+    uint32_t    dropped         () { return _dropped; }     // No room, or too old by the time the GCS came back
+
+private:
+    struct backlogSlot {
+        uint8_t         msgid;
+        uint8_t         len;            // 0 if empty
+        unsigned long   time;
+        uint8_t         frame[BACKLOG_SLOT_LEN];
+    };
+
+    bool        _stale          (unsigned long time);
+    void        _push           (MavESP8266Ring* ring, const uint8_t* frame, uint16_t len);
+    uint16_t    _ringNext       (MavESP8266Ring* ring);
+    bool        _latest         (uint32_t msgid);
+
+private:
+    MavESP8266Ring      _urgent;        // [unsigned long time][uint16_t length][frame]
+    MavESP8266Ring      _events;
+    backlogSlot*        _slots;
+    uint8_t             _slot_next;     // Next slot to send
+    uint32_t            _max_age;       // ms
+    bool                _releasing;
+    uint32_t            _kept;
+    uint32_t            _sent;
+    uint32_t            _dropped;
+};
+
+#endif
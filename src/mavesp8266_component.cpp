@@ -39,25 +39,77 @@
 #include "mavesp8266_component.h"
 #include "mavesp8266_parameters.h"
 #include "mavesp8266_vehicle.h"
+#include "mavesp8266_gcs.h"
+#include "mavesp8266_paramcache.h"
+#include "mavesp8266_mission.h"
+#include "mavesp8266_logdata.h"
+#include "mavesp8266_ftp.h"
+#include "mavesp8266_telemetry.h"
 
 const char* kHASH_PARAM = "_HASH_CHECK";
 
 
-MavESP8266Component::MavESP8266Component() {
-
+MavESP8266Component::MavESP8266Component()
+    : _param_sender(NULL)
+    , _param_index(0)
+{
 
 }
 
 bool
 MavESP8266Component::inRawMode() {
+  if (!_in_raw_mode) {
+    return false;
+  }
   // switch out of raw mode when not needed anymore
-  if (_in_raw_mode_time > 0 && millis() > _in_raw_mode_time + 5000) {
-    _in_raw_mode = false;
+  if (_in_raw_mode_time > 0 && millis() > _in_raw_mode_time + RAW_REBOOT_TIMEOUT) {
+    exitRawMode();
+    return false;
+  }
+  // or if nothing has been going through it for a while
+  uint32_t bytes = getWorld()->getVehicle()->getStatus()->raw_bytes_received + getWorld()->getGCS()->getStatus()->raw_bytes_received;
+  if (bytes != _raw_bytes) {
+    _raw_bytes = bytes;
+    _raw_activity = millis();
+  } else if (millis() - _raw_activity > RAW_IDLE_TIMEOUT) {
+    exitRawMode();
+    return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Switch to a transparent link (MavLink is no longer parsed)
+bool
+MavESP8266Component::enterRawMode() {
+  if (_in_raw_mode) {
     _in_raw_mode_time = 0;
-    getWorld()->getLogger()->log("Raw mode disabled\n");
+    return true;
+  }
+  if (!getWorld()->getVehicle()->beginRaw() || !getWorld()->getGCS()->beginRaw()) {
+    getWorld()->getVehicle()->endRaw();
+    getWorld()->getGCS()->endRaw();
+    getWorld()->getLogger()->log("Raw mode: not enough memory\n");
+    return false;
   }
+  _in_raw_mode = true;
+  _in_raw_mode_time = 0;
+  _raw_start = _raw_activity = millis();
+  _raw_bytes = getWorld()->getVehicle()->getStatus()->raw_bytes_received + getWorld()->getGCS()->getStatus()->raw_bytes_received;
+  return true;
+}
 
-  return _in_raw_mode;
+//---------------------------------------------------------------------------------
+void
+MavESP8266Component::exitRawMode() {
+  if (!_in_raw_mode) {
+    return;
+  }
+  _in_raw_mode = false;
+  _in_raw_mode_time = 0;
+  getWorld()->getVehicle()->endRaw();
+  getWorld()->getGCS()->endRaw();
+  getWorld()->getLogger()->log("Raw mode disabled\n");
 }
 
 bool
@@ -121,6 +173,16 @@ MavESP8266Component::handleMessage(MavESP8266Bridge* sender, mavlink_message_t*
       }
   }
 
+  //-- Telemetry, autopilot parameters, missions, logs and files: snoop what the vehicle sends, answer the GCS where possible
+  if(sender == getWorld()->getVehicle()) {
+      return getWorld()->getTelemetry()->vehicleMessage(message) || getWorld()->getParamCache()->vehicleMessage(message) || getWorld()->getMission()->vehicleMessage(message) ||
+             getWorld()->getLogData()->vehicleMessage(message) || getWorld()->getFtp()->vehicleMessage(message);
+  }
+  if(getWorld()->getParamCache()->gcsMessage(sender, message) || getWorld()->getMission()->gcsMessage(sender, message) ||
+     getWorld()->getLogData()->gcsMessage(sender, message) || getWorld()->getFtp()->gcsMessage(sender, message)) {
+      return true;
+  }
+
   //-- Couldn't handle the message, pass on
   return false;
 }
@@ -164,6 +226,10 @@ MavESP8266Component::_handleParamSet(MavESP8266Bridge* sender, mavlink_param_set
             if(!getWorld()->getParameters()->getAt(i)->readOnly) {
                 //-- Set new value
                 memcpy(getWorld()->getParameters()->getAt(i)->value, &param->param_value, getWorld()->getParameters()->getAt(i)->length);
+                //-- Web credentials changed?
+                if(i >= MavESP8266Parameters::ID_WEBACT1 && i <= MavESP8266Parameters::ID_WEBPWD4) {
+                    getWorld()->getParameters()->invalidateWebAuth();
+                }
             }
             //-- "Ack" it
             _sendParameter(sender, getWorld()->getParameters()->getAt(i)->index);
@@ -177,10 +243,28 @@ MavESP8266Component::_handleParamSet(MavESP8266Bridge* sender, mavlink_param_set
 void
 MavESP8266Component::_handleParamRequestList(MavESP8266Bridge* sender)
 {
-    for(int i = 0; i < MavESP8266Parameters::ID_COUNT; i++) {
-        _sendParameter(sender, getWorld()->getParameters()->getAt(i)->index);
-        delay(0);
+    //-- Sent by streamParameters() a few at a time (starting over if already under way)
+    _param_sender = sender;
+    _param_index  = 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- Send requested parameters for up to budget us. Returns true while there are more.
+bool
+MavESP8266Component::streamParameters(uint32_t budget)
+{
+    if(!_param_sender) {
+        return false;
     }
+    unsigned long start = micros();
+    do {
+        _sendParameter(_param_sender, getWorld()->getParameters()->getAt(_param_index)->index);
+        if(++_param_index >= MavESP8266Parameters::ID_COUNT) {
+            _param_sender = NULL;
+            return false;
+        }
+    } while(micros() - start < budget);
+    return true;
 }
 
 //---------------------------------------------------------------------------------
@@ -282,9 +366,9 @@ MavESP8266Component::_handleCmdLong(MavESP8266Bridge* sender, mavlink_command_lo
 
         // recognize FC reboot command and switch to raw mode for bootloader protocol to work
         if(compID == MAV_COMP_ID_ALL && (uint8_t)cmd->param1 > 0) {
-          getWorld()->getLogger()->log("Raw mode enabled (cmd %d %d)\n", cmd->command, compID);
-          _in_raw_mode = true;
-          _in_raw_mode_time = 0;
+          if (enterRawMode()) {
+            getWorld()->getLogger()->log("Raw mode enabled (cmd %d %d)\n", cmd->command, compID);
+          }
         }
     }
     //-- Response
@@ -48,6 +48,10 @@ public:
     bool handleMessage        (MavESP8266Bridge* sender, mavlink_message_t* message);
     bool inRawMode            ();
     void resetRawMode         () { _in_raw_mode_time = millis(); }
+    bool enterRawMode         ();
+    void exitRawMode          ();
+    unsigned long rawModeTime () { return _in_raw_mode ? millis() - _raw_start : 0; }
+    bool streamParameters     (uint32_t budget);
 
 private:
     void    _sendStatusMessage      (MavESP8266Bridge* sender, uint8_t type, const char* text);
@@ -63,6 +67,11 @@ private:
 
     bool            _in_raw_mode;
     unsigned long   _in_raw_mode_time;
+    unsigned long   _raw_start;
+    unsigned long   _raw_activity;
+    uint32_t        _raw_bytes;
+    MavESP8266Bridge* _param_sender;    // Who asked for the parameter list (while sending it)
+    int             _param_index;
 };
 
 #endif
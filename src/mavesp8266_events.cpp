@@ -0,0 +1,137 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_events.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_events.h"
+
+extern "C" void esp_schedule();
+
+volatile bool   MavESP8266Events::_signaled = false;
+volatile bool   MavESP8266Events::_sleeping = false;
+uint8_t         MavESP8266Events::_rx_pin   = 3;
+
+//---------------------------------------------------------------------------------
+MavESP8266Events::MavESP8266Events()
+    : _idle_percent(0)
+    , _wakeups(0)
+    , _timeouts(0)
+    , _idle_us(0)
+    , _stats_time(0)
+{
+}
+
+//---------------------------------------------------------------------------------
+//-- The core owns the UART interrupt (it already moves bytes from the FIFO into
+//   Serial's ring). To find out when a byte starts arriving we also watch the RX
+//   pin itself. The GPIO edge interrupt works whatever function the pin is in.
+void
+MavESP8266Events::begin(uint8_t uartRxPin)
+{
+    _rx_pin = uartRxPin;
+    attachInterrupt(_rx_pin, _uartEdge, CHANGE);
+    _disarm();
+    _stats_time = millis();
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Events::idle(unsigned long us)
+{
+    unsigned long ms = min(us / 1000, (unsigned long)EVENT_MAX_SLEEP);
+    if(ms) {
+        unsigned long start = micros();
+        _signaled = false;
+        _sleeping = true;
+        _arm();
+        //-- A byte may have come in before the interrupt was armed
+        if(!Serial.available()) {
+            delay(ms);
+        }
+        noInterrupts();
+        _sleeping = false;
+        _disarm();
+        interrupts();
+        if(_signaled) {
+            _wakeups++;
+        } else {
+            _timeouts++;
+        }
+        _idle_us += micros() - start;
+    }
+    if(millis() - _stats_time >= EVENT_STATS_PERIOD) {
+        _idle_percent = min(_idle_us / (EVENT_STATS_PERIOD * 10), (uint32_t)100);
+        _idle_us      = 0;
+        _stats_time   = millis();
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Resume loop() if it is sleeping in idle(). Never schedule it otherwise as that
+//   would cut short some other delay() it may be in.
+void ICACHE_RAM_ATTR
+MavESP8266Events::signal()
+{
+    _signaled = true;
+    if(_sleeping) {
+        _sleeping = false;
+        esp_schedule();
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Events::_arm()
+{
+    GPIEC = (1 << _rx_pin);
+    GPC(_rx_pin) |= ((CHANGE & 0x07) << GPCI);
+}
+
+//---------------------------------------------------------------------------------
+void ICACHE_RAM_ATTR
+MavESP8266Events::_disarm()
+{
+    GPC(_rx_pin) &= ~(0x07 << GPCI);
+}
+
+//---------------------------------------------------------------------------------
+//-- One edge is all we need. Disarm until the next sleep.
+void ICACHE_RAM_ATTR
+MavESP8266Events::_uartEdge()
+{
+    _disarm();
+    signal();
+}
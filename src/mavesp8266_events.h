@@ -0,0 +1,77 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_events.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_EVENTS_H
+#define MAVESP8266_EVENTS_H
+
+#include "mavesp8266.h"
+
+#define EVENT_MAX_SLEEP         10      // Longest sleep (ms). Bounds HTTP and housekeeping latency.
+#define EVENT_STATS_PERIOD      1000    // Idle time is reported over this period (ms)
+
+//---------------------------------------------------------------------------------
+//-- Lets loop() sleep until there is work. The UDP receive callback and a wake-up
+//   interrupt on the UART RX pin (armed only while sleeping) end the sleep early.
+class MavESP8266Events {
+public:
+    MavESP8266Events();
+
+    void        begin           (uint8_t uartRxPin);
+    void        idle            (unsigned long us); // Sleep up to us (rounded down to ms) unless there is work
+    static void signal          (); // Wake loop(). Safe from interrupts and network callbacks.
+    //-- Status
+    uint8_t     idlePercent     () { return _idle_percent; }
+    uint32_t    wakeups         () { return _wakeups; }     // Sleeps ended by an event
+    uint32_t    timeouts        () { return _timeouts; }    // Sleeps that ran their course
+
+private:
+    static void _arm            ();
+    static void _disarm         ();
+    static void _uartEdge       ();
+
+private:
+    uint8_t                 _idle_percent;
+    uint32_t                _wakeups;
+    uint32_t                _timeouts;
+    uint32_t                _idle_us;
+    unsigned long           _stats_time;
+    static volatile bool    _signaled;
+    static volatile bool    _sleeping;
+    static uint8_t          _rx_pin;
+};
+
+#endif
@@ -0,0 +1,342 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_ftp.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_ftp.h"
+#include "mavesp8266_parameters.h"
+#include "mavesp8266_vehicle.h"
+
+//---------------------------------------------------------------------------------
+MavESP8266Ftp::MavESP8266Ftp()
+    : _window(NULL)
+    , _window_next(0)
+    , _open_seq(0)
+    , _open_opcode(FTP_OP_NONE)
+    , _resent(0)
+{
+    memset(_sessions, 0, sizeof(_sessions));
+    memset(_open_path, 0, sizeof(_open_path));
+    memset(_window_path, 0, sizeof(_window_path));
+}
+
+//---------------------------------------------------------------------------------
+ftpSession*
+MavESP8266Ftp::getSession(int index)
+{
+    if(index < 0 || index >= FTP_MAX_SESSIONS || !_sessions[index].start) {
+        return NULL;
+    }
+    return &_sessions[index];
+}
+
+//---------------------------------------------------------------------------------
+ftpSession*
+MavESP8266Ftp::_find(uint8_t session)
+{
+    for(int i = 0; i < FTP_MAX_SESSIONS; i++) {
+        if(_sessions[i].open && _sessions[i].session == session) {
+            return &_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------------
+//-- A slot for a new session: one never used, or the one closed the longest
+ftpSession*
+MavESP8266Ftp::_open(uint8_t session)
+{
+    ftpSession* slot = _find(session);
+    for(int i = 0; !slot && i < FTP_MAX_SESSIONS; i++) {
+        if(!_sessions[i].start) {
+            slot = &_sessions[i];
+        }
+    }
+    for(int i = 0; !slot && i < FTP_MAX_SESSIONS; i++) {
+        if(!_sessions[i].open && (!slot || _sessions[i].last < slot->last)) {
+            slot = &_sessions[i];
+        }
+    }
+    if(!slot) {
+        slot = &_sessions[0];
+    }
+    //-- Autopilots hand out the same session numbers again. Whatever was read
+    //   under this one before (closed or not) belongs to another file.
+    _purge(session);
+    memset(slot, 0, sizeof(ftpSession));
+    slot->open    = true;
+    slot->session = session;
+    slot->start   = millis();
+    slot->last    = slot->start;
+    return slot;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Ftp::_close(ftpSession* session)
+{
+    if(session) {
+        session->open = false;
+    }
+    if(!_readsOpen()) {
+        _freeWindow();
+    }
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266Ftp::_readsOpen()
+{
+    for(int i = 0; i < FTP_MAX_SESSIONS; i++) {
+        if(_sessions[i].open && !_sessions[i].write) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Ftp::_freeWindow()
+{
+    free(_window);
+    _window      = NULL;
+    _window_next = 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- Keep a chunk read from the autopilot (replacing the oldest)
+void
+MavESP8266Ftp::_keep(ftpHeader* header, const uint8_t* data)
+{
+    uint8_t slot = _window_next;
+    for(uint8_t i = 0; i < FTP_WINDOW; i++) {
+        if(_window[i].size && _window[i].session == header->session && _window[i].offset == header->offset) {
+            slot = i;
+            break;
+        }
+    }
+    if(slot == _window_next) {
+        _window_next = (_window_next + 1) % FTP_WINDOW;
+    }
+    ftpChunk* chunk = &_window[slot];
+    chunk->session = header->session;
+    chunk->size    = min(header->size, (uint8_t)FTP_DATA_LEN);
+    chunk->offset  = header->offset;
+    memcpy(chunk->data, data, chunk->size);
+}
+
+//---------------------------------------------------------------------------------
+//-- Forget the chunks read in a session
+void
+MavESP8266Ftp::_purge(uint8_t session)
+{
+    for(uint8_t i = 0; _window && i < FTP_WINDOW; i++) {
+        if(_window[i].session == session) {
+            _window[i].size = 0;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Answer a ReadFile from the window, the way the autopilot would have
+bool
+MavESP8266Ftp::_resend(MavESP8266Bridge* sender, mavlink_message_t* message, ftpHeader* request)
+{
+    for(uint8_t i = 0; i < FTP_WINDOW; i++) {
+        ftpChunk* chunk = &_window[i];
+        if(!chunk->size || chunk->session != request->session || chunk->offset != request->offset) {
+            continue;
+        }
+        uint8_t payload[MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN];
+        memset(payload, 0, sizeof(payload));
+        ftpHeader header;
+        memset(&header, 0, sizeof(header));
+        header.seq        = request->seq + 1;
+        header.session    = request->session;
+        header.opcode     = FTP_OP_ACK;
+        header.size       = request->size ? min(request->size, chunk->size) : chunk->size;
+        header.req_opcode = FTP_OP_READ;
+        header.offset     = request->offset;
+        memcpy(payload, &header, sizeof(header));
+        memcpy(&payload[sizeof(header)], chunk->data, header.size);
+        MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+        mavlink_message_t msg;
+        mavlink_msg_file_transfer_protocol_pack(vehicle->systemID(), vehicle->componentID(), &msg, 0, message->sysid, message->compid, payload);
+        sender->sendMessage(&msg);
+        ftpSession* session = _find(request->session);
+        if(session) {
+            session->resent++;
+            session->last = millis();
+        }
+        _resent++;
+        return true;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- FTP requests from the GCS. Only a ReadFile for a chunk still in the window
+//   is handled here. Everything else goes on to the autopilot.
+bool
+MavESP8266Ftp::gcsMessage(MavESP8266Bridge* sender, mavlink_message_t* message)
+{
+    if(message->msgid != MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL) {
+        return false;
+    }
+    mavlink_file_transfer_protocol_t ftp;
+    mavlink_msg_file_transfer_protocol_decode(message, &ftp);
+    MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+    if(!vehicle->heardFrom() || ftp.target_system != vehicle->systemID()) {
+        return false;
+    }
+    ftpHeader header;
+    memcpy(&header, ftp.payload, sizeof(header));
+    const uint8_t* data = &ftp.payload[sizeof(header)];
+    switch(header.opcode) {
+        case FTP_OP_OPEN_RO:
+        case FTP_OP_OPEN_WO:
+        case FTP_OP_CREATE: {
+            //-- The session number comes with the ACK
+            _open_seq    = header.seq;
+            _open_opcode = header.opcode;
+            uint8_t len  = min(header.size, (uint8_t)(FTP_PATH_LEN - 1));
+            for(uint8_t i = 0; i < len; i++) {
+                //-- Shown in JSON as is
+                _open_path[i] = (data[i] < ' ' || data[i] == '"' || data[i] == '\\') ? '_' : data[i];
+            }
+            _open_path[len] = 0;
+            break;
+        }
+        case FTP_OP_WRITE: {
+            ftpSession* session = _find(header.session);
+            if(session) {
+                session->messages++;
+                session->bytes += header.size;
+                session->last   = millis();
+            }
+            break;
+        }
+        case FTP_OP_READ:
+            if(_window && _resend(sender, message, &header)) {
+                return true;
+            }
+            break;
+        case FTP_OP_TERMINATE:
+            _close(_find(header.session));
+            break;
+        case FTP_OP_RESET:
+            for(int i = 0; i < FTP_MAX_SESSIONS; i++) {
+                _sessions[i].open = false;
+            }
+            _close(NULL);
+            break;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- FTP replies from the autopilot (all of them go on to the GCS)
+bool
+MavESP8266Ftp::vehicleMessage(mavlink_message_t* message)
+{
+    if(message->msgid != MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL) {
+        return false;
+    }
+    mavlink_file_transfer_protocol_t ftp;
+    mavlink_msg_file_transfer_protocol_decode(message, &ftp);
+    ftpHeader header;
+    memcpy(&header, ftp.payload, sizeof(header));
+    const uint8_t* data = &ftp.payload[sizeof(header)];
+    if(header.opcode != FTP_OP_ACK) {
+        return false;
+    }
+    switch(header.req_opcode) {
+        case FTP_OP_OPEN_RO:
+        case FTP_OP_OPEN_WO:
+        case FTP_OP_CREATE: {
+            if(header.req_opcode != _open_opcode || header.seq != (uint16_t)(_open_seq + 1)) {
+                break;
+            }
+            _open_opcode = FTP_OP_NONE;
+            //-- A different file: nothing in the window can be trusted for it
+            if(_window && strncmp(_open_path, _window_path, FTP_PATH_LEN)) {
+                memset(_window, 0, sizeof(ftpChunk) * FTP_WINDOW);
+                _window_next = 0;
+            }
+            memcpy(_window_path, _open_path, sizeof(_window_path));
+            ftpSession* session = _open(header.session);
+            memcpy(session->path, _open_path, sizeof(session->path));
+            session->write = header.req_opcode != FTP_OP_OPEN_RO;
+            if(!session->write && header.size >= sizeof(uint32_t)) {
+                memcpy(&session->size, data, sizeof(uint32_t));
+            }
+            if(!session->write && !_window && getWorld()->getParameters()->getFtpResend() &&
+               ESP.getFreeHeap() >= sizeof(ftpChunk) * FTP_WINDOW + FTP_HEAP_RESERVE) {
+                _window = (ftpChunk*)calloc(FTP_WINDOW, sizeof(ftpChunk));
+            }
+            break;
+        }
+        case FTP_OP_READ:
+        case FTP_OP_BURST_READ: {
+            ftpSession* session = _find(header.session);
+            if(!session) {
+                break;
+            }
+            session->messages++;
+            session->bytes += header.size;
+            session->last   = millis();
+            if(header.req_opcode == FTP_OP_BURST_READ) {
+                if(header.offset != session->next) {
+                    session->gaps++;
+                }
+                if(header.burst_complete) {
+                    session->bursts++;
+                }
+                session->next = header.offset + header.size;
+            }
+            if(_window && header.size) {
+                _keep(&header, data);
+            }
+            break;
+        }
+        case FTP_OP_TERMINATE:
+            _close(_find(header.session));
+            break;
+    }
+    return false;
+}
@@ -0,0 +1,136 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_ftp.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_FTP_H
+#define MAVESP8266_FTP_H
+
+#include "mavesp8266.h"
+
+//-- MAVLink FTP (FILE_TRANSFER_PROTOCOL) sessions seen between the GCS and the
+//   autopilot. Read chunks are kept for a while so a GCS asking again for one
+//   it lost over WiFi is answered by the bridge.
+#define FTP_MAX_SESSIONS        4               // Sessions tracked (open or recently closed)
+#define FTP_PATH_LEN            40
+#define FTP_DATA_LEN            (MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN - 12)
+#define FTP_WINDOW              24              // Read chunks kept (about 6KB)
+#define FTP_HEAP_RESERVE        (8 * 1024)      // RAM left free after allocating the window
+
+//-- Opcodes (see the MAVLink FTP protocol)
+enum {
+    FTP_OP_NONE             = 0,
+    FTP_OP_TERMINATE        = 1,
+    FTP_OP_RESET            = 2,
+    FTP_OP_LIST             = 3,
+    FTP_OP_OPEN_RO          = 4,
+    FTP_OP_READ             = 5,
+    FTP_OP_CREATE           = 6,
+    FTP_OP_WRITE            = 7,
+    FTP_OP_OPEN_WO          = 11,
+    FTP_OP_BURST_READ       = 15,
+    FTP_OP_ACK              = 128,
+    FTP_OP_NAK              = 129,
+};
+
+//-- The header at the start of every FTP payload
+struct ftpHeader {
+    uint16_t    seq;
+    uint8_t     session;
+    uint8_t     opcode;
+    uint8_t     size;
+    uint8_t     req_opcode;
+    uint8_t     burst_complete;
+    uint8_t     padding;
+    uint32_t    offset;
+};
+
+struct ftpSession {
+    bool            open;
+    bool            write;
+    uint8_t         session;
+    char            path[FTP_PATH_LEN];
+    uint32_t        size;           // File size (reads)
+    uint32_t        bytes;          // Read or written so far
+    uint32_t        messages;
+    uint32_t        bursts;
+    uint32_t        gaps;           // Chunks that did not follow the one before (lost on the UART)
+    uint32_t        resent;         // Chunks the bridge sent again itself
+    uint32_t        next;           // Offset expected next
+    unsigned long   start;
+    unsigned long   last;
+};
+
+class MavESP8266Ftp {
+public:
+    MavESP8266Ftp();
+
+    //-- True if the message was handled here (and goes no further)
+    bool        vehicleMessage  (mavlink_message_t* message);
+    bool        gcsMessage      (MavESP8266Bridge* sender, mavlink_message_t* message);
+    //-- Status
+    ftpSession* getSession      (int index);    // NULL if that slot was never used
+    uint32_t    resent          () { return _resent; }
+
+private:
+    struct ftpChunk {
+        uint8_t     session;
+        uint8_t     size;           // 0 if empty
+        uint32_t    offset;
+        uint8_t     data[FTP_DATA_LEN];
+    };
+
+    ftpSession* _find           (uint8_t session);
+    ftpSession* _open           (uint8_t session);
+    void        _close          (ftpSession* session);
+    void        _keep           (ftpHeader* header, const uint8_t* data);
+    void        _purge          (uint8_t session);
+    bool        _resend         (MavESP8266Bridge* sender, mavlink_message_t* message, ftpHeader* request);
+    void        _freeWindow     ();
+    bool        _readsOpen      ();
+
+private:
+    ftpSession          _sessions[FTP_MAX_SESSIONS];
+    ftpChunk*           _window;
+    uint8_t             _window_next;   // Slot the next chunk goes in
+    char                _window_path[FTP_PATH_LEN]; // File opened last
+    //-- The last open request from the GCS (waiting for its ACK)
+    uint16_t            _open_seq;
+    uint8_t             _open_opcode;
+    char                _open_path[FTP_PATH_LEN];
+    uint32_t            _resent;
+};
+
+#endif
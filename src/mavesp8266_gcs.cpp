@@ -39,12 +39,25 @@
 #include "mavesp8266_gcs.h"
 #include "mavesp8266_parameters.h"
 #include "mavesp8266_component.h"
+#include "mavesp8266_events.h"
 
 //---------------------------------------------------------------------------------
 MavESP8266GCS::MavESP8266GCS()
     : _udp_port(DEFAULT_UDP_HPORT)
+    , _client_count(0)
+    , _client_time(0)
+    , _discovery_len(0)
+    , _discovery_time(0)
+    , _discovery_filter(true)
+    , _send_failures(0)
+    , _backoff(0)
+    , _backoff_time(0)
+    , _backlog_time(0)
+    , _gcs_late(false)
 {
     memset(&_message, 0, sizeof(_message));
+    memset(_discovery_ids, 0, sizeof(_discovery_ids));
+    memset(_discovery_sent, 0, sizeof(_discovery_sent));
 }
 
 //---------------------------------------------------------------------------------
@@ -56,27 +69,66 @@ MavESP8266GCS::begin(MavESP8266Bridge* forwardTo, IPAddress gcsIP)
     _ip = gcsIP;
     //-- Init variables that shouldn't change unless we reboot
     _udp_port = getWorld()->getParameters()->getWifiUdpHport();
+    _discovery_filter = getWorld()->getParameters()->getGcsDiscovery() == GCS_DISCOVERY_ON;
+    uint32_t ids = getWorld()->getParameters()->getGcsDiscoveryMsgs();
+    for(int i = 0; i < 4; i++) {
+        _discovery_ids[i] = (ids >> (i * 8)) & 0xFF;
+    }
+    _retry.begin(GCS_RETRY_SIZE);
     //-- Start UDP
-    _udp.begin(getWorld()->getParameters()->getWifiUdpCport());
+    if(!_udp.begin(getWorld()->getParameters()->getWifiUdpCport())) {
+        getWorld()->getLogger()->log("Could not open UDP port %u\n", getWorld()->getParameters()->getWifiUdpCport());
+    }
 }
 
 //---------------------------------------------------------------------------------
-//-- Read MavLink message from GCS
-void
-MavESP8266GCS::readMessage()
+//-- How long (us) we can go without being serviced
+unsigned long
+MavESP8266GCS::idleTime()
 {
-    //-- Read UDP
-    if(_readMessage()) {
-        //-- If we have a message, forward it
-        _forwardTo->sendMessage(&_message);
-        memset(&_message, 0, sizeof(_message));
+    if(_raw.available() || ((_udp.available() || _udp.pending()) && !_forwardTo->sendBusy())) {
+        return 0;
     }
-    //-- Update radio status (1Hz)
-    if(_heard_from && (millis() - _last_status_time > 1000)) {
-        delay(0);
-        _sendRadioStatus();
-        _last_status_time = millis();
+    if(_retry.available()) {
+        return _backingOff() ? _backoff - (micros() - _backoff_time) : 0;
+    }
+    if(_backlog.releasing()) {
+        unsigned long elapsed = millis() - _backlog_time;
+        return elapsed >= BACKLOG_PACE ? 0 : (BACKLOG_PACE - elapsed) * 1000UL;
+    }
+    return EVENT_MAX_SLEEP * 1000UL;
+}
+
+//---------------------------------------------------------------------------------
+//-- Read MavLink messages from GCS for up to budget us
+void
+MavESP8266GCS::readMessage(uint32_t budget)
+{
+    unsigned long start = micros();
+    _sendDiscovery();
+    //-- Our own messages that did not make it last time
+    if(_retry.available()) {
+        sendMessage(NULL, 0);
     }
+    _sendBacklog();
+    //-- Read UDP
+    do {
+        //-- The vehicle's uplink is backed up. Leave the rest waiting in the socket.
+        if(_forwardTo->sendBusy()) {
+            break;
+        }
+        if(_readMessage()) {
+            //-- If we have a message, forward it
+            _forwardTo->sendMessage(&_message);
+            memset(&_message, 0, sizeof(_message));
+        }
+        if(micros() - start >= budget) {
+            if(_udp.available() || _udp.pending()) {
+                _status.budget_exhausted++;
+            }
+            break;
+        }
+    } while(_udp.available() || _udp.pending());
 }
 
 //---------------------------------------------------------------------------------
@@ -85,7 +137,11 @@ bool
 MavESP8266GCS::_readMessage()
 {
     bool msgReceived = false;
-    int udp_count = _udp.parsePacket();
+    //-- Finish the current datagram before starting on the next one
+    int udp_count = _udp.available();
+    if(!udp_count) {
+        udp_count = _udp.parsePacket();
+    }
     if(udp_count > 0)
     {
         mavlink_status_t gcs_status;
@@ -115,10 +171,19 @@ MavESP8266GCS::_readMessage()
                             _component_id    = _message.compid;
                             _seq_expected    = _message.seq + 1;
                             _last_heartbeat  = millis();
+                            //-- Tell it what it missed
+                            _backlog.release();
+                            _gcs_late = false;
                         }
                     } else {
-                        if(_message.msgid == MAVLINK_MSG_ID_HEARTBEAT)
+                        if(_message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
                             _last_heartbeat = millis();
+                            //-- It was only late, it got everything
+                            if(_gcs_late && !_backlog.releasing()) {
+                                _backlog.end();
+                            }
+                            _gcs_late = false;
+                        }
                         _checkLinkErrors(&_message);
                     }
 
@@ -148,35 +213,48 @@ MavESP8266GCS::_readMessage()
             _heard_from = false;
             _ip[3] = 255;
             getWorld()->getLogger()->log("Heartbeat timeout from GCS\n");
+        } else if(_heard_from && !_gcs_late && (millis() - _last_heartbeat) > BACKLOG_LATE) {
+            //-- What goes out from here on may never get there
+            _gcs_late = true;
+            _backlog.begin(getWorld()->getParameters()->getGcsBacklog());
         }
     }
     return msgReceived;
 }
 
+//---------------------------------------------------------------------------------
+//-- Raw mode: queue datagrams from the GCS and feed the vehicle as fast as it takes them
 void
 MavESP8266GCS::readMessageRaw() {
-    int udp_count = _udp.parsePacket();
-    char buf[1024];
-    int buf_index = 0;
-
-    if(udp_count > 0)
-    {
-        while(buf_index < udp_count)
-        {
-            int result = _udp.read();
-            if (result >= 0)
-            {
-                buf[buf_index] = (char)result;
-                buf_index++;
+    //-- A datagram has to be read whole so only pick one up if there is room for it
+    if(_raw.space() >= RAW_MAX_DATAGRAM) {
+        int udp_count = _udp.parsePacket();
+        bool first = true;
+        while(udp_count > 0) {
+            size_t block;
+            uint8_t* ptr = _raw.writePtr(&block);
+            block = _udp.read(ptr, min(block, (size_t)udp_count));
+            if(!block) {
+                break;
+            }
+            if(first && block >= 2 && ptr[0] == 0x30 && ptr[1] == 0x20) {
+                // reboot command, switch out of raw mode soon
+                getWorld()->getComponent()->resetRawMode();
             }
+            first = false;
+            _raw.commit(block);
+            _status.raw_bytes_received += block;
+            udp_count -= block;
         }
-
-        if (buf[0] == 0x30 && buf[1] == 0x20) {
-            // reboot command, switch out of raw mode soon
-            getWorld()->getComponent()->resetRawMode();
+    }
+    while(_raw.available()) {
+        size_t block;
+        const uint8_t* ptr = _raw.readPtr(&block);
+        int sent = _forwardTo->sendMessagRaw((uint8_t*)ptr, block);
+        if(sent <= 0) {
+            break;
         }
-
-        _forwardTo->sendMessagRaw((uint8_t*)buf, buf_index);
+        _raw.consume(sent);
     }
 }
 
@@ -185,29 +263,82 @@ MavESP8266GCS::readMessageRaw() {
 int
 MavESP8266GCS::sendMessage(mavlink_message_t* message, int count) {
     int sentCount = 0;
-    _udp.beginPacket(_ip, _udp_port);
+    int heldCount = 0;
+    int retryCount = 0;
+    bool discovering = _discovery_filter && _ip[3] == 255;
+    //-- Anything not sent stays with the vehicle until a later pass
+    if(_backingOff()) {
+        return 0;
+    }
+    int res = _udp.beginPacket(_ip, _udp_port);
+    if(res != UDP_SEND_OK) {
+        int dropped = _sendFailed(res, count);
+        _keepBacklog(message, dropped);
+        return dropped;
+    }
+    //-- Whatever was waiting goes first
+    size_t retryBytes = _addRetries(&retryCount);
+    int taken = 0;
     for(int i = 0; i < count; i++) {
-        // Translate message to buffer
-        char buf[300];
-        unsigned len = mavlink_msg_to_send_buffer((uint8_t*)buf, &message[i]);
-        // Send it
-        _status.packets_sent++;
-        size_t sent = _udp.write((uint8_t*)(void*)buf, len);
-        if(sent != len) {
+        //-- Serialize straight into the datagram. Whatever does not fit goes in the next one.
+        uint8_t* buf = _udp.reserve(message[i].len + MAVLINK_NUM_NON_PAYLOAD_BYTES);
+        if(!buf) {
             break;
-            //-- Fibble attempt at not losing data until we get access to the socket TX buffer
-            //   status before we try to send.
-            _udp.endPacket();
-            delay(2);
-            _udp.beginPacket(_ip, _udp_port);
-            _udp.write((uint8_t*)(void*)&buf[sent], len - sent);
-            _udp.endPacket();
-            return sentCount;
         }
+        taken++;
+        bool heartbeat = message[i].msgid == MAVLINK_MSG_ID_HEARTBEAT;
+        //-- Nobody is listening yet. Drop everything but a trickle of heartbeats.
+        bool hold = discovering && !_discoveryAllows(&message[i]);
+        if(hold && !heartbeat) {
+            heldCount++;
+            continue;
+        }
+        unsigned len = mavlink_msg_to_send_buffer(buf, &message[i]);
+        //-- Keep the latest vehicle heartbeat for discovery broadcasts
+        if(heartbeat && len <= sizeof(_discovery)) {
+            memcpy(_discovery, buf, len);
+            _discovery_len = len;
+        }
+        if(hold) {
+            heldCount++;
+            continue;
+        }
+        _udp.commit(len);
         sentCount++;
     }
-    _udp.endPacket();
-    return sentCount;
+    _status.discovery_held += heldCount;
+    if(!sentCount && !retryCount) {
+        _udp.discard();
+        _keepBacklog(message, taken);
+        return heldCount;
+    }
+    //-- Nothing went out, it can all be tried again (or it is all dropped)
+    res = _endPacket();
+    if(res != UDP_SEND_OK) {
+        if(!_sendFailed(res, sentCount + retryCount)) {
+            _status.discovery_held -= heldCount;
+            return 0;
+        }
+        _retry.consume(retryBytes);
+        _keepBacklog(message, taken);
+        return sentCount + heldCount;
+    }
+    _sendSucceeded();
+    _retry.consume(retryBytes);
+    _status.packets_sent += sentCount + retryCount;
+    _keepBacklog(message, taken);
+    return sentCount + heldCount;
+}
+
+//---------------------------------------------------------------------------------
+//-- Messages done with (sent, held or given up on) go in the backlog. Those the
+//   vehicle will offer again are left for then, so nothing is kept twice.
+void
+MavESP8266GCS::_keepBacklog(mavlink_message_t* message, int count)
+{
+    for(int i = 0; i < count; i++) {
+        _backlog.keep(&message[i]);
+    }
 }
 
 //---------------------------------------------------------------------------------
@@ -220,10 +351,24 @@ MavESP8266GCS::sendMessage(mavlink_message_t* message) {
 
 int
 MavESP8266GCS::sendMessagRaw(uint8_t *buffer, int len) {
-    _udp.beginPacket(_ip, _udp_port);
+    //-- A raw stream is never dropped. It waits in the vehicle's buffer.
+    if(_backingOff()) {
+        return 0;
+    }
+    int res = _udp.beginPacket(_ip, _udp_port);
+    if(res != UDP_SEND_OK) {
+        _sendFailed(res, 0);
+        return 0;
+    }
+    //-- Short writes are fine here, the rest goes in the next datagram
     size_t sent = _udp.write(buffer, len);
-    _udp.endPacket();
-    //_udp.flush();
+    res = _endPacket();
+    if(res != UDP_SEND_OK) {
+        _sendFailed(res, 0);
+        return 0;
+    }
+    _sendSucceeded();
+    _status.raw_bytes_sent += sent;
     return sent;
 }
 
@@ -247,8 +392,8 @@ MavESP8266GCS::_sendRadioStatus()
         0,                      // We don't have access to Remote RSSI
         st->queue_status,       // UDP queue status
         0,                      // We don't have access to noise data
-        (uint16_t)((st->packets_lost * 100) / st->packets_received),                // Percent of lost messages from Vehicle (UART)
-        (uint16_t)((_status.packets_lost * 100) / _status.packets_received),        // Percent of lost messages from GCS (UDP)
+        (uint16_t)(st->packets_received ? (st->packets_lost * 100) / st->packets_received : 0),                  // Percent of lost messages from Vehicle (UART)
+        (uint16_t)(_status.packets_received ? (_status.packets_lost * 100) / _status.packets_received : 0),      // Percent of lost messages from GCS (UDP)
         0                       // We don't fix anything
     );
     _sendSingleUdpMessage(&msg);
@@ -260,20 +405,260 @@ MavESP8266GCS::_sendRadioStatus()
 void
 MavESP8266GCS::_sendSingleUdpMessage(mavlink_message_t* msg)
 {
-    // Translate message to buffer
-    char buf[300];
-    unsigned len = mavlink_msg_to_send_buffer((uint8_t*)buf, msg);
-    // Send it
-    _udp.beginPacket(_ip, _udp_port);
-    size_t sent = _udp.write((uint8_t*)(void*)buf, len);
-    _udp.endPacket();
-    //-- Fibble attempt at not losing data until we get access to the socket TX buffer
-    //   status before we try to send.
-    if(sent != len) {
-        delay(1);
-        _udp.beginPacket(_ip, _udp_port);
-        _udp.write((uint8_t*)(void*)&buf[sent], len - sent);
-        _udp.endPacket();
-    }
-    _status.packets_sent++;
+    //-- Keep the order. Whatever is waiting goes out first.
+    if(_retry.available() || _backingOff()) {
+        _queueRetry(msg);
+        return;
+    }
+    int res = _udp.beginPacket(_ip, _udp_port);
+    if(res == UDP_SEND_OK) {
+        uint8_t* buf = _udp.reserve(MAVLINK_MAX_PACKET_LEN);
+        if(!buf) {
+            //-- It would never fit
+            _udp.discard();
+            _status.send_abandoned++;
+            return;
+        }
+        _udp.commit(mavlink_msg_to_send_buffer(buf, msg));
+        res = _endPacket();
+    }
+    if(res == UDP_SEND_OK) {
+        _sendSucceeded();
+        _status.packets_sent++;
+    } else if(!_sendFailed(res, 1)) {
+        _queueRetry(msg);
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- What the GCS missed, a few messages at a time so it doesn't crowd out live telemetry
+void
+MavESP8266GCS::_sendBacklog()
+{
+    if(!_backlog.releasing() || (millis() - _backlog_time) < BACKLOG_PACE || _retry.available() || _backingOff()) {
+        return;
+    }
+    _backlog_time = millis();
+    int res = _udp.beginPacket(_ip, _udp_port);
+    if(res != UDP_SEND_OK) {
+        _sendFailed(res, 0);
+        return;
+    }
+    int count = 0;
+    uint16_t len;
+    while(count < BACKLOG_BATCH && (len = _backlog.nextLength())) {
+        uint8_t* buf = _udp.reserve(len);
+        if(!buf) {
+            break;
+        }
+        _backlog.take(buf);
+        _udp.commit(len);
+        count++;
+    }
+    if(!count) {
+        _udp.discard();
+        return;
+    }
+    res = _endPacket();
+    if(res != UDP_SEND_OK) {
+        //-- Not worth keeping, these are old already
+        _sendFailed(res, 0);
+        _status.send_abandoned += count;
+        return;
+    }
+    _sendSucceeded();
+    _status.packets_sent += count;
+}
+
+//---------------------------------------------------------------------------------
+//-- Waiting out a failed send
+bool
+MavESP8266GCS::_backingOff()
+{
+    return _backoff && (micros() - _backoff_time) < _backoff;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266GCS::_sendSucceeded()
+{
+    _send_failures = 0;
+    _backoff       = 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- Back off a little longer each time. Returns count if the messages should be
+//   dropped (hard error or too many failures in a row), 0 to try them again later.
+int
+MavESP8266GCS::_sendFailed(int res, int count)
+{
+    _backoff      = _backoff ? min(_backoff * 2, (unsigned long)GCS_BACKOFF_MAX) : GCS_BACKOFF_MIN;
+    _backoff_time = micros();
+    if(res == UDP_WOULD_BLOCK && ++_send_failures < GCS_RETRY_LIMIT) {
+        _status.send_retries += count;
+        return 0;
+    }
+    _send_failures = 0;
+    _status.send_abandoned += count;
+    return count;
+}
+
+//---------------------------------------------------------------------------------
+//-- Keep a bridge message for the next send
+void
+MavESP8266GCS::_queueRetry(mavlink_message_t* msg)
+{
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buf, msg);
+    if(_retry.space() < sizeof(len) + len) {
+        _status.send_abandoned++;
+        return;
+    }
+    _retry.write((uint8_t*)&len, sizeof(len));
+    _retry.write(buf, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- Copy as many waiting messages as fit into the datagram. They stay in the
+//   queue until it is sent. Returns the bytes of queue used.
+size_t
+MavESP8266GCS::_addRetries(int* count)
+{
+    size_t used = 0;
+    *count = 0;
+    while(used < _retry.available()) {
+        uint16_t len;
+        _retry.peek(used, (uint8_t*)&len, sizeof(len));
+        uint8_t* buf = _udp.reserve(len);
+        if(!buf) {
+            break;
+        }
+        _retry.peek(used + sizeof(len), buf, len);
+        _udp.commit(len);
+        used += sizeof(len) + len;
+        (*count)++;
+    }
+    return used;
+}
+
+//---------------------------------------------------------------------------------
+//-- Send the datagram being built to the GCS or, while we don't know where the GCS
+//   is, to every station with a DHCP lease. Broadcast frames go out at the lowest
+//   rate with no retries, so in AP mode telemetry is never broadcast. In station
+//   mode there are no leases and broadcast is the only way to reach a GCS.
+int
+MavESP8266GCS::_endPacket()
+{
+    size_t len = _udp.length();
+    if(_ip[3] != 255) {
+        int res = _udp.endPacket();
+        if(res == UDP_SEND_OK) {
+            _status.bytes_sent += len;
+        }
+        return res;
+    }
+    if(getWorld()->getParameters()->getWifiMode() != WIFI_MODE_AP) {
+        int res = _udp.endPacket();
+        if(res == UDP_SEND_OK) {
+            _status.bytes_sent      += len;
+            _status.broadcast_bytes += len;
+        }
+        return res;
+    }
+    _updateClients();
+    int res = UDP_SEND_OK;
+    bool delivered = false;
+    for(uint8_t i = 0; i < _client_count; i++) {
+        int sent = _udp.sendTo(_clients[i], _udp_port);
+        if(sent == UDP_SEND_OK) {
+            _status.bytes_sent += len;
+            delivered = true;
+        } else {
+            res = sent;
+        }
+    }
+    _udp.discard();
+    //-- With nobody to send to the datagram is dropped, which counts as sent
+    return (delivered || !_client_count) ? UDP_SEND_OK : res;
+}
+
+//---------------------------------------------------------------------------------
+//-- While looking for a GCS only HEARTBEAT and GCS_DISC_MSGIDS go out, each about
+//   once per GCS_DISCOVERY_PERIOD (a little early is fine, so jitter doesn't halve
+//   a 1Hz heartbeat)
+bool
+MavESP8266GCS::_discoveryAllows(mavlink_message_t* msg)
+{
+    int slot = -1;
+    if(msg->msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+        slot = 0;
+    } else {
+        for(int i = 0; i < 4; i++) {
+            if(_discovery_ids[i] && _discovery_ids[i] == msg->msgid) {
+                slot = i + 1;
+                break;
+            }
+        }
+    }
+    if(slot < 0) {
+        return false;
+    }
+    if(_discovery_sent[slot] && (millis() - _discovery_sent[slot]) < GCS_DISCOVERY_PERIOD * 3 / 4) {
+        return false;
+    }
+    _discovery_sent[slot] = millis() | 1;
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Refresh the list of associated stations that got an address from us
+void
+MavESP8266GCS::_updateClients()
+{
+    if(_client_time && (millis() - _client_time) < GCS_CLIENT_SCAN) {
+        return;
+    }
+    _client_time  = millis() | 1;
+    _client_count = 0;
+    if(getWorld()->getParameters()->getWifiMode() != WIFI_MODE_AP) {
+        return;
+    }
+    struct station_info* station = wifi_softap_get_station_info();
+    while(station && _client_count < GCS_MAX_CLIENTS) {
+        //-- No address yet means no lease
+        if(station->ip.addr) {
+            _clients[_client_count++] = IPAddress(station->ip.addr);
+        }
+        station = STAILQ_NEXT(station, next);
+    }
+    wifi_softap_free_station_info();
+}
+
+//---------------------------------------------------------------------------------
+//-- Low rate heartbeat broadcast so a GCS can find us before we know its address
+void
+MavESP8266GCS::_sendDiscovery()
+{
+    if(_ip[3] != 255 || !_discovery_len || (millis() - _discovery_time) < GCS_DISCOVERY_PERIOD) {
+        return;
+    }
+    _discovery_time = millis();
+    //-- Stations with a lease get the vehicle heartbeat unicast already, and in
+    //   station mode it is broadcast along with the rest (see _endPacket()). A
+    //   second copy would only look like a duplicate.
+    if(getWorld()->getParameters()->getWifiMode() != WIFI_MODE_AP) {
+        return;
+    }
+    _updateClients();
+    if(_client_count) {
+        return;
+    }
+    if(_udp.beginPacket(_ip, _udp_port) != UDP_SEND_OK) {
+        return;
+    }
+    _udp.write(_discovery, _discovery_len);
+    if(_udp.endPacket() == UDP_SEND_OK) {
+        _status.bytes_sent      += _discovery_len;
+        _status.broadcast_bytes += _discovery_len;
+    }
 }
@@ -39,17 +39,37 @@
 #define MAVESP8266_GCS_H
 
 #include "mavesp8266.h"
+#include "mavesp8266_udp.h"
+#include "mavesp8266_backlog.h"
+
+//-- Until the GCS talks to us, telemetry is unicast to each station holding a DHCP lease
+#define GCS_MAX_CLIENTS         4
+#define GCS_CLIENT_SCAN         1000    // Station list refresh (ms)
+#define GCS_DISCOVERY_PERIOD    1000    // Vehicle heartbeat broadcast interval (ms) while no GCS is known
+#define GCS_DISCOVERY_SIZE      32      // Room for an encoded HEARTBEAT
+
+//-- Failed sends. Nothing waits on the network stack, the next pass tries again.
+#define GCS_RETRY_SIZE          512     // Bridge messages (parameters, radio status) waiting for another try
+#define GCS_BACKOFF_MIN         500     // First wait after a failed send (us), doubled on each failure
+#define GCS_BACKOFF_MAX         4000    // About what the UART buffer holds at full rate
+#define GCS_RETRY_LIMIT         6       // Failures in a row before the pending messages are dropped
 
 class MavESP8266GCS : public MavESP8266Bridge {
 public:
     MavESP8266GCS();
 
     void    begin                   (MavESP8266Bridge* forwardTo, IPAddress gcsIP);
-    void    readMessage             ();
+    void    readMessage             (uint32_t budget);
     void    readMessageRaw          ();
     int     sendMessage             (mavlink_message_t* message, int count);
     int     sendMessage             (mavlink_message_t* message);
     int     sendMessagRaw           (uint8_t *buffer, int len);
+    unsigned long idleTime          ();
+    uint32_t droppedDatagrams       () { return _udp.dropped(); }
+    uint32_t blockedDatagrams       () { return _udp.blocked(); }
+    udpSendFailures* sendFailures   () { return _udp.failures(); }
+    uint8_t clientCount             () { return _client_count; }
+    MavESP8266Backlog* backlog      () { return &_backlog; }
 protected:
     void    _sendRadioStatus        ();
 
@@ -57,13 +77,39 @@ private:
     bool    _readMessage            ();
     void    _sendSingleUdpMessage   (mavlink_message_t* msg);
     void    _checkUdpErrors         (mavlink_message_t* msg);
+    int     _endPacket              ();
+    void    _updateClients          ();
+    void    _sendDiscovery          ();
+    bool    _discoveryAllows        (mavlink_message_t* msg);
+    bool    _backingOff             ();
+    void    _sendSucceeded          ();
+    int     _sendFailed             (int res, int count);
+    void    _queueRetry             (mavlink_message_t* msg);
+    size_t  _addRetries             (int* count);
+    void    _sendBacklog            ();
+    void    _keepBacklog            (mavlink_message_t* message, int count);
 
 private:
-    WiFiUDP             _udp;
+    MavESP8266Udp       _udp;
     IPAddress           _ip;
     uint16_t            _udp_port;
     mavlink_message_t   _message;
-    unsigned long       _last_status_time;
+    IPAddress           _clients[GCS_MAX_CLIENTS];
+    uint8_t             _client_count;
+    unsigned long       _client_time;
+    uint8_t             _discovery[GCS_DISCOVERY_SIZE];
+    uint8_t             _discovery_len;
+    unsigned long       _discovery_time;
+    bool                _discovery_filter;
+    uint8_t             _discovery_ids[4];      // GCS_DISC_MSGIDS (0 is unused)
+    unsigned long       _discovery_sent[5];     // Last time HEARTBEAT and each of the above went out
+    MavESP8266Ring      _retry;                 // [uint16_t length][frame]
+    uint8_t             _send_failures;         // Failed sends in a row
+    unsigned long       _backoff;               // Wait (us) before the next send, 0 if none
+    unsigned long       _backoff_time;
+    MavESP8266Backlog   _backlog;               // Kept while the GCS is gone (GCS_BACKLOG)
+    unsigned long       _backlog_time;
+    bool                _gcs_late;              // Its heartbeat is overdue (BACKLOG_LATE)
 };
 
 #endif
@@ -40,6 +40,15 @@
 #include "mavesp8266_parameters.h"
 #include "mavesp8266_gcs.h"
 #include "mavesp8266_vehicle.h"
+#include "mavesp8266_component.h"
+#include "mavesp8266_recorder.h"
+#include "mavesp8266_events.h"
+#include "mavesp8266_scheduler.h"
+#include "mavesp8266_paramcache.h"
+#include "mavesp8266_mission.h"
+#include "mavesp8266_logdata.h"
+#include "mavesp8266_ftp.h"
+#include "mavesp8266_telemetry.h"
 #include "mavesp8266_htmlTemplate.h"
 
 #include <ESP8266WebServer.h>
@@ -50,6 +59,20 @@
 
 
 const char* kBAUD       = "baud";
+const char* kRXBUF      = "rxbuf";
+const char* kFLOWCTL    = "flowctl";
+const char* kAUTOBAUD   = "autobaud";
+const char* kUARTBUDGET = "uartbudget";
+const char* kUDPBUDGET  = "udpbudget";
+const char* kDISCOVERY  = "discovery";
+const char* kDISCMSGS   = "discmsgs";
+const char* kFASTLANE   = "fastlane";
+const char* kFCPARAMS   = "fcparams";
+const char* kMISSION    = "missionproxy";
+const char* kLOGAHEAD   = "logreadahead";
+const char* kFTPRESEND  = "ftpresend";
+const char* kBACKLOG    = "backlog";
+const char* kTELEMCACHE = "telemcache";
 const char* kPWD        = "pwd";
 const char* kSSID       = "ssid";
 const char* kPWDSTA     = "pwdsta";
@@ -67,6 +90,10 @@ const char* kMODE       = "mode";
 const char* kWEBACCOUNT   = "webaccount";
 const char* kWEBPASSWORD       = "webpassword";
 
+const char PROGMEM kLOGINREDIRECT[] = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
+const char PROGMEM kSESSIONCOOKIE[] = "ESPSESSIONID=";
+const char PROGMEM kEVENTHEADER[]   = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\n\r\n";
+
 const char* kFlashMaps[7] = {
   "512KB (256/256)",
   "256KB",
@@ -79,12 +106,40 @@ const char* kFlashMaps[7] = {
 
 static uint32_t flash = 0;
 static char paramCRC[12] = {""};
+//-- Session key cache. Recomputed only when the web credentials change.
+static char sessionKey[41] = {""};
+static uint32_t sessionSerial = 0;
 
 ESP8266WebServer    webServer(80);
 MavESP8266Update*   updateCB    = NULL;
 bool                started     = false;
 
-const char * headerkeys[] = {"User-Agent", "Cookie"} ;
+//-- Response body being trickled out by MavESP8266Httpd::checkUpdates()
+static WiFiClient   pendingClient;
+static String       pendingBody;
+static PGM_P        pendingPgm      = NULL;
+static size_t     (*pendingReader)(uint32_t offset, uint8_t* buffer, size_t len) = NULL;
+static uint32_t     pendingOffset   = 0;
+static size_t       pendingLen      = 0;
+static size_t       pendingSent     = 0;
+static unsigned long pendingTime    = 0;
+static uint32_t     httpSkipped     = 0;
+
+//-- Server-Sent Events subscribers (/events). Counters use the status.json keys.
+const char* kEventKeys[] = {"gpackets", "gsent", "glost", "vpackets", "vsent", "vlost", "radio", "buffer", "graw", "vraw", "vover", "verr", "gdrop", "idle", "gbudget", "vbudget", "gbcast", "gheld", "gblock", "uqueue", "upeak", "ustall", "udrop", "gnopbuf", "gstack", "garp", "gshort", "gserr", "gretry", "gabandon"};
+#define EVENT_KEY_COUNT (sizeof(kEventKeys) / sizeof(char*))
+
+struct stEventClient {
+  WiFiClient      client;
+  uint32_t        interval;
+  unsigned long   last;
+  uint32_t        logPosition;
+  bool            primed;
+  uint32_t        values[EVENT_KEY_COUNT];
+};
+static stEventClient eventClients[HTTPD_MAX_EVENT_CLIENTS];
+
+const char * headerkeys[] = {"User-Agent", "Cookie", "If-None-Match", "Range"} ;
 size_t headerkeyssize = sizeof(headerkeys) / sizeof(char*);
 
 
@@ -95,6 +150,126 @@ void setNoCacheHeaders() {
   webServer.sendHeader("Expires", "0");
 }
 
+//---------------------------------------------------------------------------------
+void endDeferred() {
+  pendingClient.stop();
+  pendingClient = WiFiClient();
+  pendingBody   = String();
+  pendingPgm    = NULL;
+  pendingReader = NULL;
+  pendingLen    = 0;
+  pendingSent   = 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- Send the headers now and queue the body. It goes out a slice at a time from
+//   checkUpdates() so a large page or a slow client can't stall the bridge.
+void _beginDeferred(int code, PGM_P type, size_t len) {
+  webServer.setContentLength(len);
+  webServer.send(code, String(FPSTR(type)), String());
+  //-- Holding a copy of the client keeps the connection open after the handler returns
+  pendingClient = webServer.client();
+  pendingLen    = len;
+  pendingSent   = 0;
+  pendingTime   = millis();
+  if (!len) {
+    endDeferred();
+  }
+}
+
+//---------------------------------------------------------------------------------
+void sendDeferred(int code, PGM_P type, const String& body) {
+  pendingBody   = body;
+  pendingPgm    = NULL;
+  pendingReader = NULL;
+  _beginDeferred(code, type, body.length());
+}
+
+//---------------------------------------------------------------------------------
+void sendDeferred_P(int code, PGM_P type, PGM_P body, size_t len) {
+  pendingBody   = String();
+  pendingPgm    = body;
+  pendingReader = NULL;
+  _beginDeferred(code, type, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- Body read on demand (a file, for instance) starting at offset
+void sendDeferredReader(int code, PGM_P type, size_t (*reader)(uint32_t, uint8_t*, size_t), uint32_t offset, size_t len) {
+  pendingBody   = String();
+  pendingPgm    = NULL;
+  pendingReader = reader;
+  pendingOffset = offset;
+  _beginDeferred(code, type, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- Send as much of the pending body as fits in the time budget. Returns true
+//   while there is still something left to send.
+bool sendPending(unsigned long start, unsigned long budget) {
+  if (!pendingLen) {
+    return false;
+  }
+  while (pendingSent < pendingLen && pendingClient.connected() && (micros() - start) < budget) {
+    size_t len = pendingClient.availableForWrite();
+    if (!len) {
+      break;
+    }
+    len = min(len, (size_t)HTTPD_CHUNK_SIZE);
+    len = min(len, pendingLen - pendingSent);
+    size_t sent;
+    if (pendingPgm) {
+      sent = pendingClient.write_P(pendingPgm + pendingSent, len);
+    } else if (pendingReader) {
+      uint8_t chunk[HTTPD_CHUNK_SIZE];
+      len = pendingReader(pendingOffset + pendingSent, chunk, len);
+      if (!len) {
+        //-- Source came up short. Give up on this response.
+        endDeferred();
+        return false;
+      }
+      sent = pendingClient.write(chunk, len);
+    } else {
+      sent = pendingClient.write((const uint8_t*)pendingBody.c_str() + pendingSent, len);
+    }
+    if (!sent) {
+      break;
+    }
+    pendingSent += sent;
+    pendingTime  = millis();
+  }
+  if (pendingSent >= pendingLen || !pendingClient.connected() || (millis() - pendingTime) > HTTPD_SEND_TIMEOUT) {
+    endDeferred();
+    return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Used before a reboot, when there is no next loop to finish the job
+void flushPending() {
+  unsigned long start = millis();
+  while (sendPending(micros(), HTTPD_TIME_BUDGET) && (millis() - start) < HTTPD_SEND_TIMEOUT) {
+    delay(1);
+  }
+}
+
+//---------------------------------------------------------------------------------
+//-- Static assets are precompressed at build time (see esp_extra.py). Pages
+//   reference them with the ETag in the URL so they can be cached for good.
+void sendStaticAsset(const uint8_t* data, size_t len, PGM_P type, const char* etag) {
+  char tag[12];
+  snprintf(tag, sizeof(tag), "\"%s\"", etag);
+  webServer.sendHeader("ETag", tag);
+  webServer.sendHeader("Cache-Control", "public, max-age=31536000");
+  if (webServer.hasHeader("If-None-Match") && webServer.header("If-None-Match").indexOf(etag) != -1) {
+    webServer.send(304);
+    return;
+  }
+  webServer.sendHeader("Content-Encoding", "gzip");
+  sendDeferred_P(200, type, (PGM_P)data, len);
+}
+
 //---------------------------------------------------------------------------------
 void returnFail(String msg) {
   webServer.send(500, FPSTR(kTEXTPLAIN), msg + "\r\n");
@@ -105,24 +280,50 @@ void respondOK() {
   webServer.send(200, FPSTR(kTEXTPLAIN), "OK");
 }
 //---------------------------------------------------------------------------------
-void response_HTML(uint32_t code, String mine, String body) {
+void response_HTML(uint32_t code, PGM_P type, String body) {
   setNoCacheHeaders();
   String message = FPSTR(kTEMPLATE);
   message.replace("{body}", body);
-  webServer.send(code, mine, message);
+  sendDeferred(code, type, message);
 }
 //---------------------------------------------------------------------------------
-String get_SessionKey() {
-  String key = FPSTR(getWorld()->getParameters()->getWebAccount());
-  key += FPSTR(getWorld()->getParameters()->getWebPassword());
-  return  sha1(key) ;
+const char* get_SessionKey() {
+  uint32_t serial = getWorld()->getParameters()->getWebAuthSerial();
+  if (!sessionKey[0] || serial != sessionSerial) {
+    //-- Account and password are not necessarily NULL terminated
+    const char* account  = getWorld()->getParameters()->getWebAccount();
+    const char* password = getWorld()->getParameters()->getWebPassword();
+    size_t alen = strnlen(account,  16);
+    size_t plen = strnlen(password, 16);
+    uint8_t key[32];
+    memcpy(key, account, alen);
+    memcpy(&key[alen], password, plen);
+    uint8_t hash[20];
+    sha1(key, alen + plen, hash);
+    for (int i = 0; i < 20; i++) {
+      snprintf(&sessionKey[i * 2], 3, "%02x", hash[i]);
+    }
+    sessionSerial = serial;
+  }
+  return sessionKey;
+}
+//---------------------------------------------------------------------------------
+void redirect_login() {
+  webServer.sendContent_P(kLOGINREDIRECT);
 }
 //---------------------------------------------------------------------------------
 bool is_authentified() {
   if (webServer.hasHeader("Cookie")) {
+    //-- The header copy is the only allocation left. Matching is done in place.
     String cookie = webServer.header("Cookie");
-    if (cookie.indexOf("ESPSESSIONID=" + get_SessionKey()) != -1) {
-      return true;
+    const char* key = get_SessionKey();
+    size_t prefix = strlen_P(kSESSIONCOOKIE);
+    const char* p = cookie.c_str();
+    while ((p = strstr_P(p, kSESSIONCOOKIE)) != NULL) {
+      p += prefix;
+      if (strncmp(p, key, 40) == 0 && (p[40] == '\0' || p[40] == ';' || p[40] == ' ')) {
+        return true;
+      }
     }
   }
   return false;
@@ -132,25 +333,24 @@ bool is_authentified() {
 //---------------------------------------------------------------------------------
 void handle_update() {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   webServer.sendHeader("Connection", "close");
   webServer.sendHeader(FPSTR(kACCESSCTL), "*");
-  response_HTML(200, FPSTR(kTEXTHTML), FPSTR(kUPLOADFORM));
+  response_HTML(200, kTEXTHTML, FPSTR(kUPLOADFORM));
 }
 
 //---------------------------------------------------------------------------------
 void handle_upload() {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   webServer.sendHeader("Connection", "close");
   webServer.sendHeader(FPSTR(kACCESSCTL), "*");
-  response_HTML(200, FPSTR(kTEXTPLAIN), (Update.hasError()) ? "FAIL" : "OK");
+  response_HTML(200, kTEXTPLAIN, (Update.hasError()) ? "FAIL" : "OK");
+  flushPending();
   if (updateCB) {
     updateCB->updateCompleted();
   }
@@ -161,8 +361,7 @@ void handle_upload() {
 void handle_upload_status() {
 
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   bool success  = true;
@@ -218,12 +417,33 @@ void handle_upload_status() {
   }
 }
 
+//---------------------------------------------------------------------------------
+//-- "count <= limit, ..." with the worst case last
+String latencySummary(latencyHistogram* histogram)
+{
+  String summary;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    if (i)
+      summary += ", ";
+    summary += histogram->count[i];
+    if (i < LATENCY_BUCKETS - 1) {
+      summary += " &le;";
+      summary += kLatencyLimits[i];
+    } else {
+      summary += " more";
+    }
+  }
+  summary += " (max ";
+  summary += histogram->max;
+  summary += ")";
+  return summary;
+}
+
 //---------------------------------------------------------------------------------
 void handle_getSystemConfig()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   String message = FPSTR(kSYSTEMCFG);
@@ -232,14 +452,13 @@ void handle_getSystemConfig()
   message.replace("{mode}", String(getWorld()->getParameters()->getWifiMode()));
   message.replace("{webaccount}", FPSTR(getWorld()->getParameters()->getWebAccount()));
   message.replace("{webpassword}", FPSTR(getWorld()->getParameters()->getWebPassword()));
-  response_HTML(200, FPSTR(kTEXTHTML), message);
+  response_HTML(200, kTEXTHTML, message);
 }
 //---------------------------------------------------------------------------------
 void handle_getAPConfig()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   String message = FPSTR(kAPMODECFG);
@@ -247,14 +466,13 @@ void handle_getAPConfig()
   message.replace("{ssid}", FPSTR(getWorld()->getParameters()->getWifiSsid()));
   message.replace("{pwd}", FPSTR(getWorld()->getParameters()->getWifiPassword()));
   message.replace("{hport}", String(getWorld()->getParameters()->getWifiUdpHport()));
-  response_HTML(200, FPSTR(kTEXTHTML), message);
+  response_HTML(200, kTEXTHTML, message);
 }
 //---------------------------------------------------------------------------------
 void handle_getSTAConfig()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   String message = FPSTR(kSTAMODECFG);
@@ -264,14 +482,13 @@ void handle_getSTAConfig()
   message.replace("{cport}", String(getWorld()->getParameters()->getWifiUdpCport()));
   message.replace("{gatewaysta}", String(getWorld()->getParameters()->getWifiStaGateway()));
   message.replace("{subnetsta}", String(getWorld()->getParameters()->getWifiStaSubnet()));
-  response_HTML(200, FPSTR(kTEXTHTML), message);
+  response_HTML(200, kTEXTHTML, message);
 }
 //---------------------------------------------------------------------------------
 void handle_getStatus()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   if (!flash)
@@ -287,6 +504,35 @@ void handle_getStatus()
   message += gcsStatus->packets_sent;
   message += "</td></tr><tr><td>GCS Packets Lost</td><td>";
   message += gcsStatus->packets_lost;
+  message += "</td></tr><tr><td>GCS Datagrams Dropped</td><td>";
+  message += getWorld()->getGCS()->droppedDatagrams();
+  udpSendFailures* failures = getWorld()->getGCS()->sendFailures();
+  message += "</td></tr><tr><td>GCS Sends Deferred (No Buffers)</td><td>";
+  message += getWorld()->getGCS()->blockedDatagrams();
+  message += "</td></tr><tr><td>GCS Send Failures (no pbuf, stack full, ARP pending, short write, other)</td><td>";
+  message += failures->no_pbuf;
+  message += ", ";
+  message += failures->stack_full;
+  message += ", ";
+  message += failures->arp_pending;
+  message += ", ";
+  message += failures->short_write;
+  message += ", ";
+  message += failures->errors;
+  message += "</td></tr><tr><td>GCS Send Retries (messages given up)</td><td>";
+  message += gcsStatus->send_retries;
+  message += " (";
+  message += gcsStatus->send_abandoned;
+  message += ")";
+  message += "</td></tr><tr><td>Bytes Broadcast to GCS</td><td>";
+  message += gcsStatus->broadcast_bytes;
+  if (gcsStatus->bytes_sent) {
+    message += " (";
+    message += (uint32_t)((uint64_t)gcsStatus->broadcast_bytes * 100 / gcsStatus->bytes_sent);
+    message += "%)";
+  }
+  message += "</td></tr><tr><td>Packets Held Back Until a GCS Is Known</td><td>";
+  message += gcsStatus->discovery_held;
   message += "</td></tr><tr><td>Packets Received from Vehicle</td><td>";
   message += vehicleStatus->packets_received;
   message += "</td></tr><tr><td>Packets Sent to Vehicle</td><td>";
@@ -295,24 +541,103 @@ void handle_getStatus()
   message += vehicleStatus->packets_lost;
   message += "</td></tr><tr><td>Radio Messages</td><td>";
   message += gcsStatus->radio_status_sent;
+  message += "</td></tr><tr><td>Raw Bytes from GCS</td><td>";
+  message += gcsStatus->raw_bytes_received;
+  message += "</td></tr><tr><td>Raw Bytes from Vehicle</td><td>";
+  message += vehicleStatus->raw_bytes_received;
+  message += "</td></tr><tr><td>UART Overruns</td><td>";
+  message += vehicleStatus->uart_overruns;
+  message += "</td></tr><tr><td>UART Framing Errors</td><td>";
+  message += vehicleStatus->uart_errors;
+  message += "</td></tr><tr><td>Uplink Queue (bytes, peak)</td><td>";
+  message += getWorld()->getVehicle()->uplinkDepth();
+  message += " (";
+  message += getWorld()->getVehicle()->uplinkPeak();
+  message += ")";
+  message += "</td></tr><tr><td>Uplink Waiting on UART (ms)</td><td>";
+  message += getWorld()->getVehicle()->uplinkStallTime();
+  message += "</td></tr><tr><td>Uplink Frames Dropped</td><td>";
+  message += getWorld()->getVehicle()->uplinkDropped();
+  message += "</td></tr><tr><td>Fast Lane to GCS (us)</td><td>";
+  message += latencySummary(&gcsStatus->fast_latency);
+  message += "</td></tr><tr><td>Fast Lane to Vehicle (us)</td><td>";
+  message += latencySummary(&vehicleStatus->fast_latency);
+  message += "</td></tr><tr><td>UDP Drain Budget Exhausted</td><td>";
+  message += gcsStatus->budget_exhausted;
+  message += "</td></tr><tr><td>UART Drain Budget Exhausted</td><td>";
+  message += vehicleStatus->budget_exhausted;
+  message += "</td></tr><tr><td>UART Baud Rate</td><td>";
+  message += getWorld()->getParameters()->getUartBaudRate();
+  if (getWorld()->getVehicle()->detectingBaud())
+    message += " (detecting)";
+  message += "</td></tr><tr><td>Parameter Cache (fresh/count, served)</td><td>";
+  MavESP8266ParamCache* paramCache = getWorld()->getParamCache();
+  static const char* kCacheStates[] = {"Off", "Empty", "Filling", "Ready"};
+  message += kCacheStates[paramCache->state()];
+  message += " (";
+  message += paramCache->freshCount();
+  message += "/";
+  message += paramCache->paramCount();
+  message += ", ";
+  message += paramCache->paramsServed();
+  message += ")";
+  message += "</td></tr><tr><td>Mission Proxy (read, written, failed, last ms)</td><td>";
+  MavESP8266Mission* mission = getWorld()->getMission();
+  if (getWorld()->getParameters()->getMissionProxy()) {
+    message += mission->downloads();
+    message += ", ";
+    message += mission->uploads();
+    message += ", ";
+    message += mission->failures();
+    message += ", ";
+    message += mission->lastTransfer();
+  } else {
+    message += "Off";
+  }
+  message += "</td></tr><tr><td>Log Read-Ahead (requests, from RAM, KB)</td><td>";
+  MavESP8266LogData* logData = getWorld()->getLogData();
+  if (getWorld()->getParameters()->getLogReadAhead()) {
+    message += logData->requests();
+    message += ", ";
+    message += logData->fromWindow();
+    message += ", ";
+    message += logData->bytesServed() / 1024;
+  } else {
+    message += "Off";
+  }
+  message += "</td></tr><tr><td>FTP Chunks Resent by the Bridge</td><td>";
+  message += getWorld()->getFtp()->resent();
+  message += "</td></tr><tr><td>GCS Backlog (kept, sent, dropped)</td><td>";
+  MavESP8266Backlog* backlog = getWorld()->getGCS()->backlog();
+  if (getWorld()->getParameters()->getGcsBacklog()) {
+    message += backlog->kept();
+    message += ", ";
+    message += backlog->sent();
+    message += ", ";
+    message += backlog->dropped();
+  } else {
+    message += "Off";
+  }
   message += "</td></tr></table>";
   message += "<p>System Status</p><table><tr><td width=\"240\">Flash Memory Left</td><td>";
   message += flash;
   message += "</td></tr><tr><td>RAM Left</td><td>";
   message += String(ESP.getFreeHeap());
+  message += "</td></tr><tr><td>CPU Idle</td><td>";
+  message += getWorld()->getEvents()->idlePercent();
+  message += "%";
   message += "</td></tr><tr><td>Parameters CRC</td><td>";
   message += paramCRC;
   message += "</td></tr></table>";
   setNoCacheHeaders();
-  response_HTML(200, FPSTR(kTEXTHTML), message);
+  response_HTML(200, kTEXTHTML, message);
 }
 
 //---------------------------------------------------------------------------------
 void handle_getJLog()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   uint32_t position = 0, len;
@@ -332,8 +657,7 @@ void handle_getJLog()
 void handle_getJSysInfo()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   if (!flash)
@@ -366,8 +690,7 @@ void handle_getJSysInfo()
 void handle_getJSysStatus()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   bool reset = false;
@@ -380,8 +703,9 @@ void handle_getJSysStatus()
     memset(gcsStatus,     0, sizeof(linkStatus));
     memset(vehicleStatus, 0, sizeof(linkStatus));
   }
-  char message[512];
-  snprintf(message, 512,
+  udpSendFailures* failures = getWorld()->getGCS()->sendFailures();
+  char message[1024];
+  snprintf(message, sizeof(message),
            "{ "
            "\"gpackets\": \"%u\", "
            "\"gsent\": \"%u\", "
@@ -390,7 +714,29 @@ void handle_getJSysStatus()
            "\"vsent\": \"%u\", "
            "\"vlost\": \"%u\", "
            "\"radio\": \"%u\", "
-           "\"buffer\": \"%u\""
+           "\"buffer\": \"%u\", "
+           "\"graw\": \"%u\", "
+           "\"vraw\": \"%u\", "
+           "\"vover\": \"%u\", "
+           "\"verr\": \"%u\", "
+           "\"gdrop\": \"%u\", "
+           "\"idle\": \"%u\", "
+           "\"gbudget\": \"%u\", "
+           "\"vbudget\": \"%u\", "
+           "\"gbcast\": \"%u\", "
+           "\"gheld\": \"%u\", "
+           "\"gblock\": \"%u\", "
+           "\"uqueue\": \"%u\", "
+           "\"upeak\": \"%u\", "
+           "\"ustall\": \"%u\", "
+           "\"udrop\": \"%u\", "
+           "\"gnopbuf\": \"%u\", "
+           "\"gstack\": \"%u\", "
+           "\"garp\": \"%u\", "
+           "\"gshort\": \"%u\", "
+           "\"gserr\": \"%u\", "
+           "\"gretry\": \"%u\", "
+           "\"gabandon\": \"%u\""
            " }",
            gcsStatus->packets_received,
            gcsStatus->packets_sent,
@@ -399,20 +745,882 @@ void handle_getJSysStatus()
            vehicleStatus->packets_sent,
            vehicleStatus->packets_lost,
            gcsStatus->radio_status_sent,
-           vehicleStatus->queue_status
+           vehicleStatus->queue_status,
+           gcsStatus->raw_bytes_received,
+           vehicleStatus->raw_bytes_received,
+           vehicleStatus->uart_overruns,
+           vehicleStatus->uart_errors,
+           getWorld()->getGCS()->droppedDatagrams(),
+           getWorld()->getEvents()->idlePercent(),
+           gcsStatus->budget_exhausted,
+           vehicleStatus->budget_exhausted,
+           gcsStatus->broadcast_bytes,
+           gcsStatus->discovery_held,
+           getWorld()->getGCS()->blockedDatagrams(),
+           getWorld()->getVehicle()->uplinkDepth(),
+           getWorld()->getVehicle()->uplinkPeak(),
+           getWorld()->getVehicle()->uplinkStallTime(),
+           getWorld()->getVehicle()->uplinkDropped(),
+           failures->no_pbuf,
+           failures->stack_full,
+           failures->arp_pending,
+           failures->short_write,
+           failures->errors,
+           gcsStatus->send_retries,
+           gcsStatus->send_abandoned
           );
   webServer.send(200, "application/json", message);
 }
 //---------------------------------------------------------------------------------
+void sampleEventValues(uint32_t* values) {
+  linkStatus* gcsStatus = getWorld()->getGCS()->getStatus();
+  linkStatus* vehicleStatus = getWorld()->getVehicle()->getStatus();
+  values[0] = gcsStatus->packets_received;
+  values[1] = gcsStatus->packets_sent;
+  values[2] = gcsStatus->packets_lost;
+  values[3] = vehicleStatus->packets_received;
+  values[4] = vehicleStatus->packets_sent;
+  values[5] = vehicleStatus->packets_lost;
+  values[6] = gcsStatus->radio_status_sent;
+  values[7] = vehicleStatus->queue_status;
+  values[8] = gcsStatus->raw_bytes_received;
+  values[9] = vehicleStatus->raw_bytes_received;
+  values[10] = vehicleStatus->uart_overruns;
+  values[11] = vehicleStatus->uart_errors;
+  values[12] = getWorld()->getGCS()->droppedDatagrams();
+  values[13] = getWorld()->getEvents()->idlePercent();
+  values[14] = gcsStatus->budget_exhausted;
+  values[15] = vehicleStatus->budget_exhausted;
+  values[16] = gcsStatus->broadcast_bytes;
+  values[17] = gcsStatus->discovery_held;
+  values[18] = getWorld()->getGCS()->blockedDatagrams();
+  values[19] = getWorld()->getVehicle()->uplinkDepth();
+  values[20] = getWorld()->getVehicle()->uplinkPeak();
+  values[21] = getWorld()->getVehicle()->uplinkStallTime();
+  values[22] = getWorld()->getVehicle()->uplinkDropped();
+  udpSendFailures* failures = getWorld()->getGCS()->sendFailures();
+  values[23] = failures->no_pbuf;
+  values[24] = failures->stack_full;
+  values[25] = failures->arp_pending;
+  values[26] = failures->short_write;
+  values[27] = failures->errors;
+  values[28] = gcsStatus->send_retries;
+  values[29] = gcsStatus->send_abandoned;
+}
+
+//---------------------------------------------------------------------------------
+//-- Open a push channel. Counters are sent as deltas (only the keys that changed)
+//   every "interval" ms, new log text as a separate "log" event.
+void handle_events()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  stEventClient* slot = NULL;
+  for (int i = 0; i < HTTPD_MAX_EVENT_CLIENTS; i++) {
+    if (!eventClients[i].client.connected()) {
+      slot = &eventClients[i];
+      break;
+    }
+  }
+  if (!slot) {
+    webServer.send(503, FPSTR(kTEXTPLAIN), "Too many subscribers");
+    return;
+  }
+  uint32_t interval = HTTPD_EVENT_INTERVAL;
+  if (webServer.hasArg("interval")) {
+    interval = max((uint32_t)webServer.arg("interval").toInt(), (uint32_t)HTTPD_EVENT_MIN_INTERVAL);
+  }
+  webServer.sendContent_P(kEVENTHEADER);
+  slot->client      = webServer.client();
+  slot->interval    = interval;
+  slot->last        = millis() - interval;
+  slot->logPosition = getWorld()->getLogger()->getPosition() - getWorld()->getLogger()->getLogSize();
+  slot->primed      = false;
+}
+
+//---------------------------------------------------------------------------------
+//-- Push pending updates to subscribers. A client that can't take a whole event
+//   right now is skipped until the next interval, never waited on.
+void serviceEvents()
+{
+  uint32_t values[EVENT_KEY_COUNT];
+  bool sampled = false;
+  for (int i = 0; i < HTTPD_MAX_EVENT_CLIENTS; i++) {
+    stEventClient* ec = &eventClients[i];
+    if (!ec->client.connected()) {
+      if (ec->client) {
+        ec->client = WiFiClient();
+      }
+      continue;
+    }
+    if ((millis() - ec->last) < ec->interval) {
+      continue;
+    }
+    ec->last = millis();
+    if (!sampled) {
+      sampleEventValues(values);
+      sampled = true;
+    }
+    //-- Counters
+    char buffer[1024];
+    int len = snprintf(buffer, sizeof(buffer), "data: {");
+    bool first = true;
+    for (uint32_t k = 0; k < EVENT_KEY_COUNT && len < (int)sizeof(buffer); k++) {
+      if (!ec->primed || values[k] != ec->values[k]) {
+        len += snprintf(&buffer[len], sizeof(buffer) - len, "%s\"%s\":%u", first ? "" : ",", kEventKeys[k], values[k]);
+        first = false;
+      }
+    }
+    if (len < (int)sizeof(buffer))
+      len += snprintf(&buffer[len], sizeof(buffer) - len, "}\n\n");
+    if (!first && len < (int)sizeof(buffer)) {
+      if (ec->client.availableForWrite() < (size_t)len) {
+        continue;
+      }
+      ec->client.write((const uint8_t*)buffer, len);
+      memcpy(ec->values, values, sizeof(values));
+      ec->primed = true;
+    }
+    //-- Log
+    uint32_t position = ec->logPosition, logLen = 0;
+    uint32_t head = getWorld()->getLogger()->getPosition();
+    if ((head - position) > HTTPD_EVENT_MAX_LOG) {
+      position = head - HTTPD_EVENT_MAX_LOG;
+    }
+    if (position != head) {
+      String logText = getWorld()->getLogger()->getLog(&position, &logLen);
+      len = snprintf(buffer, sizeof(buffer), "event: log\ndata: {\"start\":%u,\"text\":\"", position);
+      if (ec->client.availableForWrite() >= len + logText.length() + 4) {
+        ec->client.write((const uint8_t*)buffer, len);
+        ec->client.write((const uint8_t*)logText.c_str(), logText.length());
+        ec->client.write((const uint8_t*)"\"}\n\n", 4);
+        ec->logPosition = position + logLen;
+      }
+    }
+  }
+}
+
+//---------------------------------------------------------------------------------
+size_t readTlog(uint32_t offset, uint8_t* buffer, size_t len) {
+  return getWorld()->getRecorder()->read(offset, buffer, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- Download the telemetry log (supports a single "bytes=" range)
+void handle_getTlog()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  uint32_t total = getWorld()->getRecorder()->size();
+  uint32_t first = 0;
+  uint32_t last  = total ? total - 1 : 0;
+  int code = 200;
+  if (total && webServer.hasHeader("Range")) {
+    String range = webServer.header("Range");
+    const char* r = range.c_str();
+    if (strncmp(r, "bytes=", 6) == 0) {
+      r += 6;
+      char* end = NULL;
+      if (*r == '-') {
+        //-- Suffix range: the last n bytes
+        uint32_t n = strtoul(r + 1, &end, 10);
+        first = n < total ? total - n : 0;
+      } else {
+        first = strtoul(r, &end, 10);
+        if (end && *end == '-' && end[1] >= '0' && end[1] <= '9') {
+          last = min((uint32_t)strtoul(end + 1, NULL, 10), last);
+        }
+      }
+      if (first > last) {
+        char cr[32];
+        snprintf(cr, sizeof(cr), "bytes */%u", total);
+        webServer.sendHeader("Content-Range", cr);
+        webServer.send(416);
+        return;
+      }
+      char cr[48];
+      snprintf(cr, sizeof(cr), "bytes %u-%u/%u", first, last, total);
+      webServer.sendHeader("Content-Range", cr);
+      code = 206;
+    }
+  }
+  webServer.sendHeader("Accept-Ranges", "bytes");
+  webServer.sendHeader("Content-Disposition", "attachment; filename=\"mavesp8266.tlog\"");
+  sendDeferredReader(code, kOCTETSTREAM, readTlog, first, total ? last - first + 1 : 0);
+}
+
+//---------------------------------------------------------------------------------
+//-- Control and status of the telemetry log
+void handle_tlogControl()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  MavESP8266Recorder* recorder = getWorld()->getRecorder();
+  if (webServer.hasArg("filter")) {
+    //-- Comma separated msgid list. Empty records everything.
+    recorder->clearFilter();
+    String filter = webServer.arg("filter");
+    const char* f = filter.c_str();
+    while (*f) {
+      char* end = NULL;
+      uint32_t msgid = strtoul(f, &end, 10);
+      if (end == f) {
+        f++;
+        continue;
+      }
+      recorder->setFilter(msgid, true);
+      f = end;
+    }
+  }
+  if (webServer.hasArg("clear") && webServer.arg("clear").toInt()) {
+    recorder->clear();
+  }
+  if (webServer.hasArg("record")) {
+    if (webServer.arg("record").toInt()) {
+      recorder->start();
+    } else {
+      recorder->stop();
+    }
+  }
+  char message[256];
+  snprintf(message, sizeof(message),
+           "{ "
+           "\"state\": %u, "
+           "\"filtered\": %u, "
+           "\"frames\": %u, "
+           "\"dropped\": %u, "
+           "\"written\": %u, "
+           "\"size\": %u"
+           " }",
+           recorder->state(),
+           recorder->filtered(),
+           recorder->framesRecorded(),
+           recorder->framesDropped(),
+           recorder->bytesWritten(),
+           recorder->size()
+          );
+  webServer.send(200, FPSTR(kAPPJSON), message);
+}
+
+//---------------------------------------------------------------------------------
+//-- Enter or leave raw (transparent) mode and report its throughput
+void handle_rawMode()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  MavESP8266Component* component = getWorld()->getComponent();
+  if (webServer.hasArg("enable")) {
+    if (webServer.arg("enable").toInt()) {
+      if (!component->enterRawMode()) {
+        returnFail("Not enough memory");
+        return;
+      }
+      getWorld()->getLogger()->log("Raw mode enabled (HTTP)\n");
+    } else {
+      component->exitRawMode();
+    }
+  }
+  linkStatus* gcsStatus = getWorld()->getGCS()->getStatus();
+  linkStatus* vehicleStatus = getWorld()->getVehicle()->getStatus();
+  char message[256];
+  snprintf(message, sizeof(message),
+           "{ "
+           "\"raw\": %u, "
+           "\"time\": %lu, "
+           "\"gin\": %u, "
+           "\"gout\": %u, "
+           "\"vin\": %u, "
+           "\"vout\": %u"
+           " }",
+           component->inRawMode(),
+           component->rawModeTime(),
+           gcsStatus->raw_bytes_received,
+           gcsStatus->raw_bytes_sent,
+           vehicleStatus->raw_bytes_received,
+           vehicleStatus->raw_bytes_sent
+          );
+  webServer.send(200, FPSTR(kAPPJSON), message);
+}
+
+//---------------------------------------------------------------------------------
+//-- Fast lane latency histograms
+void latencyJSON(String& message, const char* name, latencyHistogram* histogram)
+{
+  char line[96];
+  snprintf(line, sizeof(line), "\"%s\": { \"max\": %u, \"count\": [", name, histogram->max);
+  message += line;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    snprintf(line, sizeof(line), "%s%u", i ? ", " : "", histogram->count[i]);
+    message += line;
+  }
+  message += "] }";
+}
+
+void handle_getFastLane()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "{ \"mask\": %u, \"limits\": [", getWorld()->getParameters()->getFastLane());
+  String message = line;
+  for (int i = 0; i < LATENCY_BUCKETS - 1; i++) {
+    snprintf(line, sizeof(line), "%s%u", i ? ", " : "", kLatencyLimits[i]);
+    message += line;
+  }
+  message += "], ";
+  latencyJSON(message, "downlink", &getWorld()->getGCS()->getStatus()->fast_latency);
+  message += ", ";
+  latencyJSON(message, "uplink", &getWorld()->getVehicle()->getStatus()->fast_latency);
+  message += " }";
+  setNoCacheHeaders();
+  webServer.send(200, FPSTR(kAPPJSON), message);
+}
+
+//---------------------------------------------------------------------------------
+//-- Status of the autopilot parameter cache
+void handle_paramCache()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  MavESP8266ParamCache* paramCache = getWorld()->getParamCache();
+  if (webServer.hasArg("clear") && webServer.arg("clear").toInt()) {
+    paramCache->clear();
+  }
+  char message[256];
+  snprintf(message, sizeof(message),
+           "{ "
+           "\"state\": %u, "
+           "\"count\": %u, "
+           "\"fresh\": %u, "
+           "\"records\": %u, "
+           "\"hashed\": %u, "
+           "\"hash\": \"%08X\", "
+           "\"lists\": %u, "
+           "\"served\": %u, "
+           "\"dropped\": %u"
+           " }",
+           paramCache->state(),
+           paramCache->paramCount(),
+           paramCache->freshCount(),
+           paramCache->logRecords(),
+           paramCache->hashKnown(),
+           paramCache->hash(),
+           paramCache->listsServed(),
+           paramCache->paramsServed(),
+           paramCache->recordsDropped()
+          );
+  setNoCacheHeaders();
+  webServer.send(200, FPSTR(kAPPJSON), message);
+}
+
+//---------------------------------------------------------------------------------
+//-- MAVLink FTP sessions, open or recently closed
+void handle_getFtp()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  MavESP8266Ftp* ftp = getWorld()->getFtp();
+  char line[320];
+  snprintf(line, sizeof(line), "{ \"resent\": %u, \"sessions\": [", ftp->resent());
+  String message = line;
+  bool first = true;
+  for (int i = 0; i < FTP_MAX_SESSIONS; i++) {
+    ftpSession* session = ftp->getSession(i);
+    if (!session) {
+      continue;
+    }
+    uint32_t ms = session->last - session->start;
+    snprintf(line, sizeof(line),
+             "%s{ \"session\": %u, \"open\": %u, \"write\": %u, \"path\": \"%s\", \"size\": %u, \"bytes\": %u, "
+             "\"messages\": %u, \"bursts\": %u, \"gaps\": %u, \"resent\": %u, \"ms\": %u, \"rate\": %u }",
+             first ? "" : ", ", session->session, session->open, session->write, session->path, session->size,
+             session->bytes, session->messages, session->bursts, session->gaps, session->resent, ms,
+             ms ? (uint32_t)((uint64_t)session->bytes * 1000 / ms) : 0);
+    message += line;
+    first = false;
+  }
+  message += "] }";
+  setNoCacheHeaders();
+  webServer.send(200, FPSTR(kAPPJSON), message);
+}
+
+//---------------------------------------------------------------------------------
+//-- Last values of the autopilot messages in TELEM_CACHE. The ETag only changes
+//   with them, so polling a vehicle sitting still costs a 304.
+void handle_getTelemetry()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  MavESP8266Telemetry* telemetry = getWorld()->getTelemetry();
+  MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+  uint32_t mask = getWorld()->getParameters()->getTelemCache();
+  char line[320];
+  snprintf(line, sizeof(line), "\"%x-%x-%u\"", telemetry->version(), mask, vehicle->heardFrom());
+  webServer.sendHeader("ETag", line);
+  webServer.sendHeader("Cache-Control", "no-cache");
+  if (webServer.hasHeader("If-None-Match") && webServer.header("If-None-Match").indexOf(line) != -1) {
+    webServer.send(304);
+    return;
+  }
+  snprintf(line, sizeof(line), "{ \"vehicle\": %s, \"system\": %u, \"component\": %u",
+           vehicle->heardFrom() ? "true" : "false", vehicle->systemID(), vehicle->componentID());
+  String message = line;
+  if ((mask & (1UL << TELEM_HEARTBEAT)) && telemetry->changed(TELEM_HEARTBEAT)) {
+    const mavlink_heartbeat_t* hb = telemetry->heartbeat();
+    snprintf(line, sizeof(line),
+             ", \"heartbeat\": { \"time\": %u, \"type\": %u, \"autopilot\": %u, \"base_mode\": %u, "
+             "\"custom_mode\": %u, \"system_status\": %u }",
+             telemetry->changed(TELEM_HEARTBEAT), hb->type, hb->autopilot, hb->base_mode, hb->custom_mode, hb->system_status);
+    message += line;
+  }
+  if ((mask & (1UL << TELEM_SYS_STATUS)) && telemetry->changed(TELEM_SYS_STATUS)) {
+    const mavlink_sys_status_t* st = telemetry->sysStatus();
+    snprintf(line, sizeof(line),
+             ", \"sys_status\": { \"time\": %u, \"sensors_present\": %u, \"sensors_enabled\": %u, \"sensors_health\": %u, "
+             "\"load\": %u, \"voltage_battery\": %u, \"current_battery\": %d, \"battery_remaining\": %d, "
+             "\"drop_rate_comm\": %u, \"errors_comm\": %u }",
+             telemetry->changed(TELEM_SYS_STATUS), st->onboard_control_sensors_present, st->onboard_control_sensors_enabled,
+             st->onboard_control_sensors_health, st->load, st->voltage_battery, st->current_battery, st->battery_remaining,
+             st->drop_rate_comm, st->errors_comm);
+    message += line;
+  }
+  if ((mask & (1UL << TELEM_GPS_RAW_INT)) && telemetry->changed(TELEM_GPS_RAW_INT)) {
+    const mavlink_gps_raw_int_t* gps = telemetry->gpsRawInt();
+    snprintf(line, sizeof(line),
+             ", \"gps_raw_int\": { \"time\": %u, \"fix_type\": %u, \"lat\": %d, \"lon\": %d, \"alt\": %d, "
+             "\"eph\": %u, \"epv\": %u, \"vel\": %u, \"cog\": %u, \"satellites_visible\": %u }",
+             telemetry->changed(TELEM_GPS_RAW_INT), gps->fix_type, gps->lat, gps->lon, gps->alt,
+             gps->eph, gps->epv, gps->vel, gps->cog, gps->satellites_visible);
+    message += line;
+  }
+  if ((mask & (1UL << TELEM_GLOBAL_POSITION_INT)) && telemetry->changed(TELEM_GLOBAL_POSITION_INT)) {
+    const mavlink_global_position_int_t* pos = telemetry->globalPositionInt();
+    snprintf(line, sizeof(line),
+             ", \"global_position_int\": { \"time\": %u, \"lat\": %d, \"lon\": %d, \"alt\": %d, \"relative_alt\": %d, "
+             "\"vx\": %d, \"vy\": %d, \"vz\": %d, \"hdg\": %u }",
+             telemetry->changed(TELEM_GLOBAL_POSITION_INT), pos->lat, pos->lon, pos->alt, pos->relative_alt,
+             pos->vx, pos->vy, pos->vz, pos->hdg);
+    message += line;
+  }
+  if ((mask & (1UL << TELEM_BATTERY_STATUS)) && telemetry->changed(TELEM_BATTERY_STATUS)) {
+    const mavlink_battery_status_t* bat = telemetry->batteryStatus();
+    snprintf(line, sizeof(line),
+             ", \"battery_status\": { \"time\": %u, \"id\": %u, \"temperature\": %d, \"current_battery\": %d, "
+             "\"current_consumed\": %d, \"energy_consumed\": %d, \"battery_remaining\": %d, \"voltages\": [",
+             telemetry->changed(TELEM_BATTERY_STATUS), bat->id, bat->temperature, bat->current_battery,
+             bat->current_consumed, bat->energy_consumed, bat->battery_remaining);
+    message += line;
+    for (int i = 0; i < MAVLINK_MSG_BATTERY_STATUS_FIELD_VOLTAGES_LEN; i++) {
+      snprintf(line, sizeof(line), "%s%u", i ? ", " : "", bat->voltages[i]);
+      message += line;
+    }
+    message += "] }";
+  }
+  message += " }";
+  webServer.send(200, FPSTR(kAPPJSON), message);
+}
+
+//---------------------------------------------------------------------------------
+//-- Prometheus text exposition (/metrics). Each METRIC_V in kMetrics is replaced
+//   by the next of metricValues, a snapshot taken when the request came in, so
+//   the text goes out a slice at a time without ever being built in RAM.
+#define METRIC_V "\x01"
+#define METRIC_LINKS(name) name "{link=\"gcs\"} " METRIC_V "\n" name "{link=\"vehicle\"} " METRIC_V "\n"
+#define METRIC_HISTOGRAM(name, link) \
+  name "_bucket{link=\"" link "\",le=\"" METRIC_V "\"} " METRIC_V "\n" \
+  name "_bucket{link=\"" link "\",le=\"" METRIC_V "\"} " METRIC_V "\n" \
+  name "_bucket{link=\"" link "\",le=\"" METRIC_V "\"} " METRIC_V "\n" \
+  name "_bucket{link=\"" link "\",le=\"" METRIC_V "\"} " METRIC_V "\n" \
+  name "_bucket{link=\"" link "\",le=\"" METRIC_V "\"} " METRIC_V "\n" \
+  name "_bucket{link=\"" link "\",le=\"+Inf\"} " METRIC_V "\n" \
+  name "_sum{link=\"" link "\"} " METRIC_V "\n" \
+  name "_count{link=\"" link "\"} " METRIC_V "\n"
+
+const char PROGMEM kPROMETHEUS[] = "text/plain; version=0.0.4";
+const char PROGMEM kMetrics[] =
+  "# HELP mavesp_uptime_seconds Time since boot\n"
+  "# TYPE mavesp_uptime_seconds gauge\n"
+  "mavesp_uptime_seconds " METRIC_V "\n"
+  "# HELP mavesp_heap_free_bytes Free RAM\n"
+  "# TYPE mavesp_heap_free_bytes gauge\n"
+  "mavesp_heap_free_bytes " METRIC_V "\n"
+  "# HELP mavesp_heap_max_block_bytes Largest block of RAM that can be allocated\n"
+  "# TYPE mavesp_heap_max_block_bytes gauge\n"
+  "mavesp_heap_max_block_bytes " METRIC_V "\n"
+  "# HELP mavesp_heap_fragmentation_percent Heap fragmentation\n"
+  "# TYPE mavesp_heap_fragmentation_percent gauge\n"
+  "mavesp_heap_fragmentation_percent " METRIC_V "\n"
+  "# HELP mavesp_cpu_idle_percent Time the main loop spent asleep\n"
+  "# TYPE mavesp_cpu_idle_percent gauge\n"
+  "mavesp_cpu_idle_percent " METRIC_V "\n"
+  "# HELP mavesp_loop_wakeups_total Sleeps ended by an event\n"
+  "# TYPE mavesp_loop_wakeups_total counter\n"
+  "mavesp_loop_wakeups_total " METRIC_V "\n"
+  "# HELP mavesp_loop_timeouts_total Sleeps that ran their course\n"
+  "# TYPE mavesp_loop_timeouts_total counter\n"
+  "mavesp_loop_timeouts_total " METRIC_V "\n"
+  "# HELP mavesp_loop_passes_total Scheduler passes\n"
+  "# TYPE mavesp_loop_passes_total counter\n"
+  "mavesp_loop_passes_total " METRIC_V "\n"
+  "# HELP mavesp_loop_max_pass_microseconds Longest scheduler pass\n"
+  "# TYPE mavesp_loop_max_pass_microseconds gauge\n"
+  "mavesp_loop_max_pass_microseconds " METRIC_V "\n"
+  "# HELP mavesp_link_up 1 while the other end is heard from\n"
+  "# TYPE mavesp_link_up gauge\n"
+  METRIC_LINKS("mavesp_link_up")
+  "# HELP mavesp_messages_received_total MAVLink messages received\n"
+  "# TYPE mavesp_messages_received_total counter\n"
+  METRIC_LINKS("mavesp_messages_received_total")
+  "# HELP mavesp_messages_lost_total MAVLink messages missing from the sequence\n"
+  "# TYPE mavesp_messages_lost_total counter\n"
+  METRIC_LINKS("mavesp_messages_lost_total")
+  "# HELP mavesp_messages_sent_total MAVLink messages sent\n"
+  "# TYPE mavesp_messages_sent_total counter\n"
+  METRIC_LINKS("mavesp_messages_sent_total")
+  "# HELP mavesp_raw_bytes_received_total Bytes received in raw mode\n"
+  "# TYPE mavesp_raw_bytes_received_total counter\n"
+  METRIC_LINKS("mavesp_raw_bytes_received_total")
+  "# HELP mavesp_raw_bytes_sent_total Bytes sent in raw mode\n"
+  "# TYPE mavesp_raw_bytes_sent_total counter\n"
+  METRIC_LINKS("mavesp_raw_bytes_sent_total")
+  "# HELP mavesp_drain_budget_exhausted_total Reads cut short by the drain budget with data still waiting\n"
+  "# TYPE mavesp_drain_budget_exhausted_total counter\n"
+  METRIC_LINKS("mavesp_drain_budget_exhausted_total")
+  "# HELP mavesp_gcs_bytes_sent_total Bytes sent to the GCS\n"
+  "# TYPE mavesp_gcs_bytes_sent_total counter\n"
+  "mavesp_gcs_bytes_sent_total " METRIC_V "\n"
+  "# HELP mavesp_gcs_broadcast_bytes_total Bytes broadcast while no GCS was known\n"
+  "# TYPE mavesp_gcs_broadcast_bytes_total counter\n"
+  "mavesp_gcs_broadcast_bytes_total " METRIC_V "\n"
+  "# HELP mavesp_gcs_discovery_held_total Messages not forwarded while no GCS was known\n"
+  "# TYPE mavesp_gcs_discovery_held_total counter\n"
+  "mavesp_gcs_discovery_held_total " METRIC_V "\n"
+  "# HELP mavesp_gcs_radio_status_sent_total RADIO_STATUS sent to the GCS\n"
+  "# TYPE mavesp_gcs_radio_status_sent_total counter\n"
+  "mavesp_gcs_radio_status_sent_total " METRIC_V "\n"
+  "# HELP mavesp_gcs_clients Stations telemetry is unicast to while no GCS is known\n"
+  "# TYPE mavesp_gcs_clients gauge\n"
+  "mavesp_gcs_clients " METRIC_V "\n"
+  "# HELP mavesp_gcs_send_retries_total Messages kept for another try after a failed send\n"
+  "# TYPE mavesp_gcs_send_retries_total counter\n"
+  "mavesp_gcs_send_retries_total " METRIC_V "\n"
+  "# HELP mavesp_gcs_send_abandoned_total Messages given up on after failed sends\n"
+  "# TYPE mavesp_gcs_send_abandoned_total counter\n"
+  "mavesp_gcs_send_abandoned_total " METRIC_V "\n"
+  "# HELP mavesp_udp_datagrams_dropped_total GCS datagrams dropped by the network stack\n"
+  "# TYPE mavesp_udp_datagrams_dropped_total counter\n"
+  "mavesp_udp_datagrams_dropped_total " METRIC_V "\n"
+  "# HELP mavesp_udp_send_failures_total Sends refused by the network stack\n"
+  "# TYPE mavesp_udp_send_failures_total counter\n"
+  "mavesp_udp_send_failures_total{reason=\"no_pbuf\"} " METRIC_V "\n"
+  "mavesp_udp_send_failures_total{reason=\"stack_full\"} " METRIC_V "\n"
+  "mavesp_udp_send_failures_total{reason=\"arp_pending\"} " METRIC_V "\n"
+  "mavesp_udp_send_failures_total{reason=\"short_write\"} " METRIC_V "\n"
+  "mavesp_udp_send_failures_total{reason=\"other\"} " METRIC_V "\n"
+  "# HELP mavesp_uart_overruns_total UART receive overruns\n"
+  "# TYPE mavesp_uart_overruns_total counter\n"
+  "mavesp_uart_overruns_total " METRIC_V "\n"
+  "# HELP mavesp_uart_errors_total UART framing errors\n"
+  "# TYPE mavesp_uart_errors_total counter\n"
+  "mavesp_uart_errors_total " METRIC_V "\n"
+  "# HELP mavesp_vehicle_queue_status Vehicle link queue status (as sent in RADIO_STATUS)\n"
+  "# TYPE mavesp_vehicle_queue_status gauge\n"
+  "mavesp_vehicle_queue_status " METRIC_V "\n"
+  "# HELP mavesp_uplink_queue_bytes Bytes waiting to go out the UART\n"
+  "# TYPE mavesp_uplink_queue_bytes gauge\n"
+  "mavesp_uplink_queue_bytes " METRIC_V "\n"
+  "# HELP mavesp_uplink_queue_peak_bytes Most bytes ever waiting to go out the UART\n"
+  "# TYPE mavesp_uplink_queue_peak_bytes gauge\n"
+  "mavesp_uplink_queue_peak_bytes " METRIC_V "\n"
+  "# HELP mavesp_uplink_stall_milliseconds_total Time the uplink waited on the UART\n"
+  "# TYPE mavesp_uplink_stall_milliseconds_total counter\n"
+  "mavesp_uplink_stall_milliseconds_total " METRIC_V "\n"
+  "# HELP mavesp_uplink_dropped_total Frames to the vehicle dropped\n"
+  "# TYPE mavesp_uplink_dropped_total counter\n"
+  "mavesp_uplink_dropped_total " METRIC_V "\n"
+  "# HELP mavesp_fast_lane_latency Time (microseconds) fast lane messages spent in the bridge, by the link they went out\n"
+  "# TYPE mavesp_fast_lane_latency histogram\n"
+  METRIC_HISTOGRAM("mavesp_fast_lane_latency", "gcs")
+  METRIC_HISTOGRAM("mavesp_fast_lane_latency", "vehicle")
+  "# HELP mavesp_fast_lane_max_microseconds Slowest fast lane message\n"
+  "# TYPE mavesp_fast_lane_max_microseconds gauge\n"
+  METRIC_LINKS("mavesp_fast_lane_max_microseconds")
+  "# HELP mavesp_tlog_frames_total Frames recorded to the telemetry log\n"
+  "# TYPE mavesp_tlog_frames_total counter\n"
+  "mavesp_tlog_frames_total " METRIC_V "\n"
+  "# HELP mavesp_tlog_frames_dropped_total Frames the telemetry log had no room for\n"
+  "# TYPE mavesp_tlog_frames_dropped_total counter\n"
+  "mavesp_tlog_frames_dropped_total " METRIC_V "\n"
+  "# HELP mavesp_tlog_bytes_written_total Bytes written to the telemetry log\n"
+  "# TYPE mavesp_tlog_bytes_written_total counter\n"
+  "mavesp_tlog_bytes_written_total " METRIC_V "\n"
+  "# HELP mavesp_param_cache_params Autopilot parameters in the cache\n"
+  "# TYPE mavesp_param_cache_params gauge\n"
+  "mavesp_param_cache_params " METRIC_V "\n"
+  "# HELP mavesp_param_cache_fresh_params Of those, known to be current\n"
+  "# TYPE mavesp_param_cache_fresh_params gauge\n"
+  "mavesp_param_cache_fresh_params " METRIC_V "\n"
+  "# HELP mavesp_param_cache_lists_total PARAM_REQUEST_LIST answered from the cache\n"
+  "# TYPE mavesp_param_cache_lists_total counter\n"
+  "mavesp_param_cache_lists_total " METRIC_V "\n"
+  "# HELP mavesp_param_cache_served_total Parameters sent from the cache\n"
+  "# TYPE mavesp_param_cache_served_total counter\n"
+  "mavesp_param_cache_served_total " METRIC_V "\n"
+  "# HELP mavesp_param_cache_dropped_total Values that came in faster than they could be written to flash\n"
+  "# TYPE mavesp_param_cache_dropped_total counter\n"
+  "mavesp_param_cache_dropped_total " METRIC_V "\n"
+  "# HELP mavesp_mission_transfers_total Missions carried out by the mission proxy\n"
+  "# TYPE mavesp_mission_transfers_total counter\n"
+  "mavesp_mission_transfers_total{direction=\"download\"} " METRIC_V "\n"
+  "mavesp_mission_transfers_total{direction=\"upload\"} " METRIC_V "\n"
+  "# HELP mavesp_mission_failures_total Mission transfers that failed\n"
+  "# TYPE mavesp_mission_failures_total counter\n"
+  "mavesp_mission_failures_total " METRIC_V "\n"
+  "# HELP mavesp_log_requests_total LOG_REQUEST_DATA from the GCS handled by log read-ahead\n"
+  "# TYPE mavesp_log_requests_total counter\n"
+  "mavesp_log_requests_total " METRIC_V "\n"
+  "# HELP mavesp_log_requests_from_ram_total Of those, found in RAM already\n"
+  "# TYPE mavesp_log_requests_from_ram_total counter\n"
+  "mavesp_log_requests_from_ram_total " METRIC_V "\n"
+  "# HELP mavesp_log_vehicle_requests_total LOG_REQUEST_DATA sent to the autopilot by log read-ahead\n"
+  "# TYPE mavesp_log_vehicle_requests_total counter\n"
+  "mavesp_log_vehicle_requests_total " METRIC_V "\n"
+  "# HELP mavesp_log_bytes_served_total Log bytes sent to the GCS by log read-ahead\n"
+  "# TYPE mavesp_log_bytes_served_total counter\n"
+  "mavesp_log_bytes_served_total " METRIC_V "\n"
+  "# HELP mavesp_ftp_resent_total FTP chunks the bridge sent again itself\n"
+  "# TYPE mavesp_ftp_resent_total counter\n"
+  "mavesp_ftp_resent_total " METRIC_V "\n"
+  "# HELP mavesp_backlog_messages_total Messages kept while the GCS was gone, by what became of them\n"
+  "# TYPE mavesp_backlog_messages_total counter\n"
+  "mavesp_backlog_messages_total{state=\"kept\"} " METRIC_V "\n"
+  "mavesp_backlog_messages_total{state=\"sent\"} " METRIC_V "\n"
+  "mavesp_backlog_messages_total{state=\"dropped\"} " METRIC_V "\n"
+  "# HELP mavesp_telemetry_changes_total Changes to the values served in /telemetry.json\n"
+  "# TYPE mavesp_telemetry_changes_total counter\n"
+  "mavesp_telemetry_changes_total " METRIC_V "\n"
+  "# HELP mavesp_http_skipped_total HTTP passes skipped while the UART was backed up\n"
+  "# TYPE mavesp_http_skipped_total counter\n"
+  "mavesp_http_skipped_total " METRIC_V "\n";
+
+#define METRIC_COUNT 92
+static uint32_t metricValues[METRIC_COUNT];
+//-- Where the text left off. Slices are asked for in order, so it is only walked once.
+static uint32_t metricOut       = 0;
+static uint16_t metricPos       = 0;
+static uint8_t  metricIndex     = 0;
+static uint8_t  metricDigit     = 0;
+static char     metricNumber[12] = {""};
+
+//---------------------------------------------------------------------------------
+//-- In the order of kMetrics
+void sampleMetrics(uint32_t* values) {
+  linkStatus* gcsStatus = getWorld()->getGCS()->getStatus();
+  linkStatus* vehicleStatus = getWorld()->getVehicle()->getStatus();
+  linkStatus* links[2] = {gcsStatus, vehicleStatus};
+  udpSendFailures* failures = getWorld()->getGCS()->sendFailures();
+  MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+  MavESP8266ParamCache* paramCache = getWorld()->getParamCache();
+  MavESP8266LogData* logData = getWorld()->getLogData();
+  MavESP8266Backlog* backlog = getWorld()->getGCS()->backlog();
+  int n = 0;
+  values[n++] = millis() / 1000;
+  values[n++] = ESP.getFreeHeap();
+  values[n++] = ESP.getMaxFreeBlockSize();
+  values[n++] = ESP.getHeapFragmentation();
+  values[n++] = getWorld()->getEvents()->idlePercent();
+  values[n++] = getWorld()->getEvents()->wakeups();
+  values[n++] = getWorld()->getEvents()->timeouts();
+  values[n++] = getWorld()->getScheduler()->passes();
+  values[n++] = getWorld()->getScheduler()->maxPassTime();
+  values[n++] = getWorld()->getGCS()->heardFrom();
+  values[n++] = vehicle->heardFrom();
+  for (int i = 0; i < 2; i++) values[n++] = links[i]->packets_received;
+  for (int i = 0; i < 2; i++) values[n++] = links[i]->packets_lost;
+  for (int i = 0; i < 2; i++) values[n++] = links[i]->packets_sent;
+  for (int i = 0; i < 2; i++) values[n++] = links[i]->raw_bytes_received;
+  for (int i = 0; i < 2; i++) values[n++] = links[i]->raw_bytes_sent;
+  for (int i = 0; i < 2; i++) values[n++] = links[i]->budget_exhausted;
+  values[n++] = gcsStatus->bytes_sent;
+  values[n++] = gcsStatus->broadcast_bytes;
+  values[n++] = gcsStatus->discovery_held;
+  values[n++] = gcsStatus->radio_status_sent;
+  values[n++] = getWorld()->getGCS()->clientCount();
+  values[n++] = gcsStatus->send_retries;
+  values[n++] = gcsStatus->send_abandoned;
+  values[n++] = getWorld()->getGCS()->droppedDatagrams();
+  values[n++] = failures->no_pbuf;
+  values[n++] = failures->stack_full;
+  values[n++] = failures->arp_pending;
+  values[n++] = failures->short_write;
+  values[n++] = failures->errors;
+  values[n++] = vehicleStatus->uart_overruns;
+  values[n++] = vehicleStatus->uart_errors;
+  values[n++] = vehicleStatus->queue_status;
+  values[n++] = vehicle->uplinkDepth();
+  values[n++] = vehicle->uplinkPeak();
+  values[n++] = vehicle->uplinkStallTime();
+  values[n++] = vehicle->uplinkDropped();
+  //-- Each bucket is labeled with its upper bound, the last one with +Inf, and
+  //   (as Prometheus expects) counts everything up to that bound
+  for (int i = 0; i < 2; i++) {
+    uint32_t below = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+      if (b < LATENCY_BUCKETS - 1) {
+        values[n++] = kLatencyLimits[b];
+      }
+      below += links[i]->fast_latency.count[b];
+      values[n++] = below;
+    }
+    values[n++] = links[i]->fast_latency.sum;
+    values[n++] = below;
+  }
+  for (int i = 0; i < 2; i++) values[n++] = links[i]->fast_latency.max;
+  values[n++] = getWorld()->getRecorder()->framesRecorded();
+  values[n++] = getWorld()->getRecorder()->framesDropped();
+  values[n++] = getWorld()->getRecorder()->bytesWritten();
+  values[n++] = paramCache->paramCount();
+  values[n++] = paramCache->freshCount();
+  values[n++] = paramCache->listsServed();
+  values[n++] = paramCache->paramsServed();
+  values[n++] = paramCache->recordsDropped();
+  values[n++] = getWorld()->getMission()->downloads();
+  values[n++] = getWorld()->getMission()->uploads();
+  values[n++] = getWorld()->getMission()->failures();
+  values[n++] = logData->requests();
+  values[n++] = logData->fromWindow();
+  values[n++] = logData->vehicleRequests();
+  values[n++] = logData->bytesServed();
+  values[n++] = getWorld()->getFtp()->resent();
+  values[n++] = backlog->kept();
+  values[n++] = backlog->sent();
+  values[n++] = backlog->dropped();
+  values[n++] = getWorld()->getTelemetry()->version();
+  values[n++] = httpSkipped;
+}
+
+//---------------------------------------------------------------------------------
+void rewindMetrics() {
+  metricOut       = 0;
+  metricPos       = 0;
+  metricIndex     = 0;
+  metricDigit     = 0;
+  metricNumber[0] = 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- Next character of the metrics text, 0 at the end
+char nextMetricChar() {
+  if (metricNumber[metricDigit]) {
+    return metricNumber[metricDigit++];
+  }
+  char c = pgm_read_byte(kMetrics + metricPos);
+  if (!c) {
+    return 0;
+  }
+  metricPos++;
+  if (c == METRIC_V[0]) {
+    snprintf(metricNumber, sizeof(metricNumber), "%u", metricIndex < METRIC_COUNT ? metricValues[metricIndex] : 0);
+    metricIndex++;
+    metricDigit = 1;
+    return metricNumber[0];
+  }
+  return c;
+}
+
+//---------------------------------------------------------------------------------
+size_t readMetrics(uint32_t offset, uint8_t* buffer, size_t len) {
+  if (offset < metricOut) {
+    rewindMetrics();
+  }
+  while (metricOut < offset && nextMetricChar()) {
+    metricOut++;
+  }
+  size_t n = 0;
+  char c;
+  while (n < len && (c = nextMetricChar()) != 0) {
+    buffer[n++] = c;
+  }
+  metricOut += n;
+  return n;
+}
+
+//---------------------------------------------------------------------------------
+//-- Every counter the bridge keeps, for Prometheus to scrape. No login: a
+//   scraper can't fill in the form, and there is nothing here to change.
+void handle_getMetrics()
+{
+  sampleMetrics(metricValues);
+  //-- The length of the text goes in the headers, so it is walked once up front
+  rewindMetrics();
+  size_t len = 0;
+  while (nextMetricChar()) {
+    len++;
+  }
+  rewindMetrics();
+  setNoCacheHeaders();
+  sendDeferredReader(200, kPROMETHEUS, readMetrics, 0, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- Scheduler task statistics
+void handle_getTasks()
+{
+  if (!is_authentified()) {
+    redirect_login();
+    return;
+  }
+  MavESP8266Scheduler* scheduler = getWorld()->getScheduler();
+  char line[192];
+  snprintf(line, sizeof(line), "{ \"passes\": %u, \"maxpass\": %u, \"tasks\": [", scheduler->passes(), scheduler->maxPassTime());
+  String message = line;
+  for (int i = 0; i < scheduler->taskCount(); i++) {
+    taskStatus* task = scheduler->getTask(i);
+    snprintf(line, sizeof(line),
+             "%s{ \"name\": \"%s\", \"priority\": %u, \"period\": %u, \"budget\": %u, \"runs\": %u, "
+             "\"overruns\": %u, \"deferred\": %u, \"max\": %u, \"load\": %u }",
+             i ? ", " : "", task->name, task->priority, task->period, task->budget, task->runs,
+             task->overruns, task->deferred, task->max_time, task->load);
+    message += line;
+  }
+  message += "] }";
+  setNoCacheHeaders();
+  webServer.send(200, FPSTR(kAPPJSON), message);
+}
+
+//---------------------------------------------------------------------------------
+void handle_css() {
+  sendStaticAsset(kCSS_GZ, kCSS_GZ_LEN, kTEXTCSS, kCSS_ETAG);
+}
+//---------------------------------------------------------------------------------
+void handle_js() {
+  sendStaticAsset(kJS_GZ, kJS_GZ_LEN, kAPPJS, kJS_ETAG);
+}
+//---------------------------------------------------------------------------------
 void handle_help() {
-  response_HTML(200, FPSTR(kTEXTHTML), FPSTR(kHELPHTML));
+  response_HTML(200, kTEXTHTML, FPSTR(kHELPHTML));
 }
 //---------------------------------------------------------------------------------
 void handle_setParameters()
 {
   if (!is_authentified()) {
-    String header = "HTTP/1.1 301 OK\r\nLocation: /login\r\nCache-Control: no-cache\r\n\r\n";
-    webServer.sendContent(header);
+    redirect_login();
     return;
   }
   if (webServer.args() == 0) {
@@ -427,6 +1635,88 @@ void handle_setParameters()
 	cfgType=1;
     getWorld()->getParameters()->setUartBaudRate(webServer.arg(kBAUD).toInt());
   }
+  if (webServer.hasArg(kRXBUF)) {
+    ok = true;
+    cfgType=1;
+    //-- Clamped before it is narrowed to 16 bits
+    getWorld()->getParameters()->setUartRxBuffer(MavESP8266Parameters::uartRxBufferSize(webServer.arg(kRXBUF).toInt()));
+  }
+  if (webServer.hasArg(kFLOWCTL)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setUartFlowControl(webServer.arg(kFLOWCTL).toInt());
+  }
+  if (webServer.hasArg(kAUTOBAUD)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setUartAutobaud(webServer.arg(kAUTOBAUD).toInt());
+  }
+  if (webServer.hasArg(kUARTBUDGET)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setUartBudget(webServer.arg(kUARTBUDGET).toInt());
+  }
+  if (webServer.hasArg(kUDPBUDGET)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setUdpBudget(webServer.arg(kUDPBUDGET).toInt());
+  }
+  if (webServer.hasArg(kDISCOVERY)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setGcsDiscovery(webServer.arg(kDISCOVERY).toInt());
+  }
+  if (webServer.hasArg(kDISCMSGS)) {
+    //-- Comma separated msgids, four at most
+    String ids = webServer.arg(kDISCMSGS);
+    uint32_t packed = 0;
+    int start = 0;
+    for (int i = 0; i < 4 && start < (int)ids.length(); i++) {
+      int end = ids.indexOf(',', start);
+      if (end < 0)
+        end = ids.length();
+      packed |= (uint32_t)(ids.substring(start, end).toInt() & 0xFF) << (i * 8);
+      start = end + 1;
+    }
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setGcsDiscoveryMsgs(packed);
+  }
+  if (webServer.hasArg(kFASTLANE)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setFastLane(strtoul(webServer.arg(kFASTLANE).c_str(), NULL, 0));
+  }
+  if (webServer.hasArg(kFCPARAMS)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setFcParamCache(webServer.arg(kFCPARAMS).toInt());
+  }
+  if (webServer.hasArg(kMISSION)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setMissionProxy(webServer.arg(kMISSION).toInt());
+  }
+  if (webServer.hasArg(kLOGAHEAD)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setLogReadAhead(webServer.arg(kLOGAHEAD).toInt());
+  }
+  if (webServer.hasArg(kFTPRESEND)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setFtpResend(webServer.arg(kFTPRESEND).toInt());
+  }
+  if (webServer.hasArg(kBACKLOG)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setGcsBacklog(webServer.arg(kBACKLOG).toInt());
+  }
+  if (webServer.hasArg(kTELEMCACHE)) {
+    ok = true;
+    cfgType=1;
+    getWorld()->getParameters()->setTelemCache(strtoul(webServer.arg(kTELEMCACHE).c_str(), NULL, 0));
+  }
   if (webServer.hasArg(kPWD)) {
     if (strlen(webServer.arg(kPWD).c_str()) >= 8) {
 	  cfgType=2;
@@ -527,6 +1817,7 @@ void handle_setParameters()
 	else
     returnFail("unknow error");
     if (reboot) {
+      flushPending();
       delay(100);
       ESP.restart();
     }
@@ -548,7 +1839,7 @@ void handle_notFound() {
     message += " " + webServer.argName(i) + ": " + webServer.arg(i) + "\n";
   }
   message +=	FPSTR(kERRORPage);
-  response_HTML(404, FPSTR(kTEXTHTML), message);
+  response_HTML(404, kTEXTHTML, message);
 }
 //---------------------------------------------------------------------------------
 void handle_Login() {
@@ -580,7 +1871,7 @@ void handle_Login() {
   }
   String message = FPSTR(kLOGINFORM);
   message.replace("{msg}", info);
-  response_HTML(200, "text/html", message);
+  response_HTML(200, kTEXTHTML, message);
 }
 
 
@@ -599,6 +1890,8 @@ MavESP8266Httpd::begin(MavESP8266Update* updateCB_)
 
   webServer.on("/login", handle_Login);
   webServer.on("/help", handle_help);
+  webServer.on("/mavesp.css",     handle_css);
+  webServer.on("/mavesp.js",      handle_js);
   webServer.on("/getsysconfig",  handle_getSystemConfig);
   webServer.on("/getapconfig",  handle_getAPConfig);
   webServer.on("/getstaconfig",  handle_getSTAConfig);
@@ -607,6 +1900,16 @@ MavESP8266Httpd::begin(MavESP8266Update* updateCB_)
   webServer.on("/info.json",      handle_getJSysInfo);
   webServer.on("/status.json",    handle_getJSysStatus);
   webServer.on("/log.json",       handle_getJLog);
+  webServer.on("/events",         handle_events);
+  webServer.on("/tlog",           handle_getTlog);
+  webServer.on("/tlog.json",      handle_tlogControl);
+  webServer.on("/rawmode",        handle_rawMode);
+  webServer.on("/tasks.json",     handle_getTasks);
+  webServer.on("/fastlane.json",  handle_getFastLane);
+  webServer.on("/fcparams.json",  handle_paramCache);
+  webServer.on("/ftp.json",       handle_getFtp);
+  webServer.on("/telemetry.json", handle_getTelemetry);
+  webServer.on("/metrics",        handle_getMetrics);
   webServer.on("/update",         handle_update);
   webServer.on("/upload",         HTTP_POST, handle_upload, handle_upload_status);
   webServer.onNotFound(handle_notFound);
@@ -617,7 +1920,26 @@ MavESP8266Httpd::begin(MavESP8266Update* updateCB_)
 //---------------------------------------------------------------------------------
 //-- Initialize
 void
-MavESP8266Httpd::checkUpdates()
+MavESP8266Httpd::checkUpdates(uint32_t budget)
 {
+  //-- Leave the loop to the bridge while the UART is backing up (unless we are
+  //   in the middle of a firmware upload, in which case the bridge is idle).
+  if (!started && Serial.available() > HTTPD_UART_BACKLOG) {
+    httpSkipped++;
+    return;
+  }
+  unsigned long start = micros();
+  serviceEvents();
+  //-- Finish the response in progress before taking a new request
+  if (sendPending(start, budget)) {
+    return;
+  }
   webServer.handleClient();
 }
+
+//---------------------------------------------------------------------------------
+uint32_t
+MavESP8266Httpd::getSkippedCount()
+{
+  return httpSkipped;
+}
@@ -40,11 +40,24 @@
 
 #include "mavesp8266.h"
 
+//-- HTTP servicing limits (per loop() iteration)
+#define HTTPD_TIME_BUDGET       1500    // 1.5ms spent sending a pending response
+#define HTTPD_CHUNK_SIZE        536     // One TCP segment at a time
+#define HTTPD_SEND_TIMEOUT      5000    // Drop a response that made no progress in 5s
+#define HTTPD_UART_BACKLOG      128     // Skip HTTP while more than this is waiting on the UART
+
+//-- Push channel (/events)
+#define HTTPD_MAX_EVENT_CLIENTS 2
+#define HTTPD_EVENT_INTERVAL    1000    // Default update interval (ms)
+#define HTTPD_EVENT_MIN_INTERVAL 100
+#define HTTPD_EVENT_MAX_LOG     512     // Log text sent per event at most
+
 class MavESP8266Httpd {
 public:
     MavESP8266Httpd();
-    void    begin           (MavESP8266Update* updateCB);
-    void    checkUpdates    ();
+    void        begin           (MavESP8266Update* updateCB);
+    void        checkUpdates    (uint32_t budget = HTTPD_TIME_BUDGET);
+    uint32_t    getSkippedCount ();
 };
 
 #endif
@@ -0,0 +1,355 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_logdata.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_logdata.h"
+#include "mavesp8266_parameters.h"
+#include "mavesp8266_vehicle.h"
+
+#define LOGDATA_MISSING 0xFF
+#define LOGDATA_NONE    0xFFFFFFFF
+
+//---------------------------------------------------------------------------------
+MavESP8266LogData::MavESP8266LogData()
+    : _chunks(NULL)
+    , _lengths(NULL)
+    , _id(0)
+    , _base(0)
+    , _first(0)
+    , _eof(LOGDATA_NONE)
+    , _fc_end(0)
+    , _fc_stalled(false)
+    , _retries(0)
+    , _fc_time(0)
+    , _gcs(NULL)
+    , _gcs_system(0)
+    , _gcs_component(0)
+    , _gcs_next(0)
+    , _gcs_end(0)
+    , _gcs_time(0)
+    , _sysid(0)
+    , _compid(0)
+    , _requests(0)
+    , _from_window(0)
+    , _fc_requests(0)
+    , _bytes(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------
+//-- Addressed to the autopilot
+bool
+MavESP8266LogData::_forVehicle(uint8_t system, uint8_t component)
+{
+    MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+    return vehicle->heardFrom() && system == vehicle->systemID() &&
+        (component == vehicle->componentID() || component == MAV_COMP_ID_ALL);
+}
+
+//---------------------------------------------------------------------------------
+//-- An empty window starting at ofs
+bool
+MavESP8266LogData::_start(uint16_t id, uint32_t ofs)
+{
+    if(!_chunks) {
+        if(ESP.getFreeHeap() < LOGDATA_WINDOW * (LOGDATA_CHUNK + 1) + LOGDATA_HEAP_RESERVE) {
+            getWorld()->getLogger()->log("Log read-ahead: no room for the window, passing through\n");
+            return false;
+        }
+        _chunks  = (uint8_t*)malloc(LOGDATA_WINDOW * LOGDATA_CHUNK);
+        _lengths = (uint8_t*)malloc(LOGDATA_WINDOW);
+        if(!_chunks || !_lengths) {
+            _finish();
+            return false;
+        }
+    }
+    memset(_lengths, LOGDATA_MISSING, LOGDATA_WINDOW);
+    _id         = id;
+    _base       = ofs;
+    _first      = 0;
+    _eof        = LOGDATA_NONE;
+    _fc_end     = 0;
+    _fc_stalled = false;
+    _retries    = 0;
+    _sysid      = getWorld()->getVehicle()->systemID();
+    _compid     = getWorld()->getVehicle()->componentID();
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266LogData::_finish()
+{
+    free(_chunks);
+    free(_lengths);
+    _chunks  = NULL;
+    _lengths = NULL;
+    _gcs     = NULL;
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266LogData::_have(uint32_t chunk)
+{
+    return chunk >= _first && chunk < _first + LOGDATA_WINDOW && _lengths[chunk % LOGDATA_WINDOW] != LOGDATA_MISSING;
+}
+
+//---------------------------------------------------------------------------------
+//-- One past the last chunk the window can hold
+uint32_t
+MavESP8266LogData::_windowEnd()
+{
+    uint32_t end = _first + LOGDATA_WINDOW;
+    if(_eof != LOGDATA_NONE && _eof < end) {
+        end = _eof + 1;
+    }
+    return end;
+}
+
+//---------------------------------------------------------------------------------
+uint32_t
+MavESP8266LogData::_firstMissing()
+{
+    uint32_t end = _windowEnd();
+    uint32_t chunk = _first;
+    while(chunk < end && _lengths[chunk % LOGDATA_WINDOW] != LOGDATA_MISSING) {
+        chunk++;
+    }
+    return chunk;
+}
+
+//---------------------------------------------------------------------------------
+//-- Keep LOGDATA_KEEP chunks behind the GCS and make room ahead of it
+void
+MavESP8266LogData::_slide()
+{
+    if(_gcs_next <= _first + LOGDATA_KEEP) {
+        return;
+    }
+    uint32_t first = _gcs_next - LOGDATA_KEEP;
+    for(uint32_t chunk = _first; chunk < first && chunk < _first + LOGDATA_WINDOW; chunk++) {
+        _lengths[chunk % LOGDATA_WINDOW] = LOGDATA_MISSING;
+    }
+    _first = first;
+    if(_fc_end < _first) {
+        _fc_end = _first;
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Ask the autopilot for whatever the window is missing, once it is done
+//   with the last request (or it timed out)
+void
+MavESP8266LogData::_fetch(bool retry)
+{
+    uint32_t missing = _firstMissing();
+    uint32_t end     = _windowEnd();
+    if(missing >= end || (!retry && (_fc_stalled || missing < _fc_end))) {
+        return;
+    }
+    mavlink_message_t msg;
+    mavlink_msg_log_request_data_pack(_sysid, MAV_COMP_ID_UDP_BRIDGE, &msg, _sysid, _compid,
+                                      _id, _base + missing * LOGDATA_CHUNK, (end - missing) * LOGDATA_CHUNK);
+    getWorld()->getVehicle()->sendMessage(&msg);
+    _fc_end  = end;
+    _fc_time = millis();
+    _fc_requests++;
+}
+
+//---------------------------------------------------------------------------------
+//-- Toward the GCS the bridge speaks for the autopilot
+void
+MavESP8266LogData::_pack(uint32_t chunk, mavlink_message_t* msg)
+{
+    uint8_t slot = chunk % LOGDATA_WINDOW;
+    mavlink_msg_log_data_pack(_sysid, _compid, msg, _id, _base + chunk * LOGDATA_CHUNK, _lengths[slot], &_chunks[slot * LOGDATA_CHUNK]);
+}
+
+//---------------------------------------------------------------------------------
+//-- Log messages from the GCS. Downloads are only taken over while
+//   LOG_READAHEAD is on. Anything else is passed on to the vehicle.
+bool
+MavESP8266LogData::gcsMessage(MavESP8266Bridge* sender, mavlink_message_t* message)
+{
+    switch(message->msgid) {
+        case MAVLINK_MSG_ID_LOG_REQUEST_DATA: {
+            if(!getWorld()->getParameters()->getLogReadAhead()) {
+                return false;
+            }
+            mavlink_log_request_data_t req;
+            mavlink_msg_log_request_data_decode(message, &req);
+            if(!req.count || !_forVehicle(req.target_system, req.target_component)) {
+                return false;
+            }
+            //-- Anything still in the window (or ahead of it) is served from there.
+            //   Otherwise the window starts over at the offset asked for.
+            uint32_t chunk = 0;
+            bool inWindow = _chunks && req.id == _id && req.ofs >= _base && !((req.ofs - _base) % LOGDATA_CHUNK);
+            if(inWindow) {
+                chunk = (req.ofs - _base) / LOGDATA_CHUNK;
+            }
+            if(!inWindow || chunk < _first) {
+                if(!_start(req.id, req.ofs)) {
+                    return false;
+                }
+                chunk = 0;
+            }
+            _requests++;
+            if(_have(chunk)) {
+                _from_window++;
+            }
+            //-- Like the autopilot, a new request replaces the one before
+            _gcs           = sender;
+            _gcs_system    = message->sysid;
+            _gcs_component = message->compid;
+            _gcs_next      = chunk;
+            _gcs_end       = req.ofs + min(req.count, LOGDATA_NONE - req.ofs);
+            _gcs_time      = millis();
+            _fc_stalled    = false;
+            _retries       = 0;
+            _slide();
+            _fetch(false);
+            return true;
+        }
+        case MAVLINK_MSG_ID_LOG_REQUEST_END:
+        case MAVLINK_MSG_ID_LOG_REQUEST_LIST:
+        case MAVLINK_MSG_ID_LOG_ERASE:
+            if(_chunks) {
+                _finish();
+            }
+            return false;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- LOG_DATA from the autopilot goes into the window while a download is on
+bool
+MavESP8266LogData::vehicleMessage(mavlink_message_t* message)
+{
+    if(!_chunks || message->msgid != MAVLINK_MSG_ID_LOG_DATA || message->sysid != _sysid || message->compid != _compid) {
+        return false;
+    }
+    mavlink_log_data_t data;
+    mavlink_msg_log_data_decode(message, &data);
+    if(data.id != _id) {
+        return false;
+    }
+    _fc_time = millis();
+    _retries = 0;
+    if(data.ofs >= _base && !((data.ofs - _base) % LOGDATA_CHUNK)) {
+        uint32_t chunk = (data.ofs - _base) / LOGDATA_CHUNK;
+        if(chunk >= _first && chunk < _first + LOGDATA_WINDOW && !_have(chunk)) {
+            uint8_t slot  = chunk % LOGDATA_WINDOW;
+            uint8_t count = min(data.count, (uint8_t)LOGDATA_CHUNK);
+            memcpy(&_chunks[slot * LOGDATA_CHUNK], data.data, count);
+            _lengths[slot] = count;
+            //-- A short chunk is the end of the log
+            if(count < LOGDATA_CHUNK) {
+                _eof = chunk;
+            }
+        }
+    }
+    _fetch(false);
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Send the GCS what it asked for, as far as the window has it
+bool
+MavESP8266LogData::stream(uint32_t budget)
+{
+    if(!_gcs) {
+        return false;
+    }
+    unsigned long start = micros();
+    mavlink_message_t batch[LOGDATA_BATCH];
+    bool more = false;
+    do {
+        int count = 0;
+        while(count < LOGDATA_BATCH && _have(_gcs_next + count) && _base + (_gcs_next + count) * LOGDATA_CHUNK < _gcs_end) {
+            _pack(_gcs_next + count, &batch[count]);
+            count++;
+        }
+        if(!count) {
+            more = false;
+            break;
+        }
+        int sent = _gcs->sendMessage(batch, count);
+        for(int i = 0; i < sent; i++) {
+            _bytes += _lengths[(_gcs_next + i) % LOGDATA_WINDOW];
+        }
+        _gcs_next += sent;
+        if(sent) {
+            _gcs_time = millis();
+        }
+        //-- Backed up. Try again on the next pass.
+        more = true;
+        if(sent < count) {
+            break;
+        }
+    } while(micros() - start < budget);
+    _slide();
+    _fetch(false);
+    return more;
+}
+
+//---------------------------------------------------------------------------------
+//-- Retries and timeouts
+void
+MavESP8266LogData::service()
+{
+    if(!_chunks) {
+        return;
+    }
+    unsigned long now = millis();
+    if(!getWorld()->getVehicle()->heardFrom() || now - _gcs_time > LOGDATA_IDLE_TIMEOUT) {
+        _finish();
+        return;
+    }
+    uint32_t missing = _firstMissing();
+    if(!_fc_stalled && missing < _fc_end && now - _fc_time > LOGDATA_FC_TIMEOUT) {
+        if(++_retries > LOGDATA_RETRIES) {
+            //-- Most likely past the end of the log. Wait for the GCS to ask.
+            _fc_stalled = true;
+            _fc_end     = missing;
+        } else {
+            _fetch(true);
+        }
+    }
+}
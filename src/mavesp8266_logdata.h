@@ -0,0 +1,106 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_logdata.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_LOGDATA_H
+#define MAVESP8266_LOGDATA_H
+
+#include "mavesp8266.h"
+
+//-- Onboard log downloads: the bridge asks the autopilot for LOG_DATA ahead of
+//   the GCS and answers its requests (and re-requests) from a window in RAM
+#define LOGDATA_CHUNK           MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN
+#define LOGDATA_WINDOW          48              // Chunks held (about 4KB)
+#define LOGDATA_KEEP            12              // Of those, chunks already sent kept for re-requests
+#define LOGDATA_HEAP_RESERVE    (8 * 1024)      // RAM left free after allocating the window
+#define LOGDATA_BATCH           4               // LOG_DATA per datagram
+#define LOGDATA_FC_TIMEOUT      200             // Ask the autopilot again after this long without data (ms)
+#define LOGDATA_IDLE_TIMEOUT    10000           // Let go of a GCS that stopped asking (ms)
+#define LOGDATA_RETRIES         5
+
+class MavESP8266LogData {
+public:
+    MavESP8266LogData();
+
+    //-- True if the message was handled here (and goes no further)
+    bool        vehicleMessage  (mavlink_message_t* message);
+    bool        gcsMessage      (MavESP8266Bridge* sender, mavlink_message_t* message);
+    bool        stream          (uint32_t budget);
+    void        service         ();
+    //-- Status
+    bool        active          () { return _chunks != NULL; }
+    uint32_t    requests        () { return _requests; }    // LOG_REQUEST_DATA from the GCS
+    uint32_t    fromWindow      () { return _from_window; } // Of those, found in RAM already
+    uint32_t    vehicleRequests () { return _fc_requests; }
+    uint32_t    bytesServed     () { return _bytes; }
+
+private:
+    bool        _forVehicle     (uint8_t system, uint8_t component);
+    bool        _start          (uint16_t id, uint32_t ofs);
+    void        _finish         ();
+    void        _slide          ();
+    void        _fetch          (bool retry);
+    uint32_t    _firstMissing   ();
+    uint32_t    _windowEnd      ();
+    bool        _have           (uint32_t chunk);
+    void        _pack           (uint32_t chunk, mavlink_message_t* msg);
+
+private:
+    uint8_t*            _chunks;        // LOGDATA_WINDOW chunks of log data
+    uint8_t*            _lengths;       // Bytes in each (LOGDATA_MISSING if not there)
+    uint16_t            _id;            // Log being downloaded
+    uint32_t            _base;          // Offset of chunk 0. Chunks are counted from there.
+    uint32_t            _first;         // First chunk in the window
+    uint32_t            _eof;           // Last chunk of the log (LOGDATA_NONE until seen)
+    uint32_t            _fc_end;        // End of what the autopilot was asked for
+    bool                _fc_stalled;    // It stopped answering (past the end of the log?)
+    uint8_t             _retries;
+    unsigned long       _fc_time;
+    MavESP8266Bridge*   _gcs;
+    uint8_t             _gcs_system;
+    uint8_t             _gcs_component;
+    uint32_t            _gcs_next;      // Next chunk to send to the GCS
+    uint32_t            _gcs_end;       // End (offset) of what the GCS asked for
+    unsigned long       _gcs_time;
+    uint8_t             _sysid;
+    uint8_t             _compid;
+    uint32_t            _requests;
+    uint32_t            _from_window;
+    uint32_t            _fc_requests;
+    uint32_t            _bytes;
+};
+
+#endif
@@ -0,0 +1,569 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_mission.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_mission.h"
+#include "mavesp8266_parameters.h"
+#include "mavesp8266_vehicle.h"
+
+#define MISSION_NONE    0xFFFF
+
+//---------------------------------------------------------------------------------
+MavESP8266Mission::MavESP8266Mission()
+    : _state(MISSION_IDLE)
+    , _items(NULL)
+    , _received(NULL)
+    , _count(0)
+    , _have_count(0)
+    , _gcs(NULL)
+    , _gcs_system(0)
+    , _gcs_component(0)
+    , _sysid(0)
+    , _compid(0)
+    , _fc_seq(MISSION_NONE)
+    , _gcs_base(0)
+    , _gcs_next(0)
+    , _retries(0)
+    , _fc_time(0)
+    , _gcs_time(0)
+    , _start_time(0)
+    , _downloads(0)
+    , _uploads(0)
+    , _failures(0)
+    , _last_time(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------
+//-- Addressed to the autopilot
+bool
+MavESP8266Mission::_forVehicle(uint8_t system, uint8_t component)
+{
+    MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+    return vehicle->heardFrom() && system == vehicle->systemID() &&
+        (component == vehicle->componentID() || component == MAV_COMP_ID_ALL || component == MAV_COMP_ID_MISSIONPLANNER);
+}
+
+//---------------------------------------------------------------------------------
+//-- Room for a mission of count items, none of them received
+bool
+MavESP8266Mission::_allocate(uint16_t count)
+{
+    free(_items);
+    free(_received);
+    _items      = NULL;
+    _received   = NULL;
+    _count      = 0;
+    _have_count = 0;
+    if(!count) {
+        return true;
+    }
+    size_t bitmap = (count + 7) >> 3;
+    if(count > MISSION_MAX_ITEMS || ESP.getFreeHeap() < count * sizeof(mavlink_mission_item_int_t) + bitmap + MISSION_HEAP_RESERVE) {
+        getWorld()->getLogger()->log("Mission proxy: no room for %u items, passing through\n", count);
+        return false;
+    }
+    _items    = (mavlink_mission_item_int_t*)malloc(count * sizeof(mavlink_mission_item_int_t));
+    _received = (uint8_t*)malloc(bitmap);
+    if(!_items || !_received) {
+        free(_items);
+        free(_received);
+        _items    = NULL;
+        _received = NULL;
+        return false;
+    }
+    memset(_received, 0, bitmap);
+    _count = count;
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Transfer over (one way or another)
+void
+MavESP8266Mission::_finish(bool success)
+{
+    if(success) {
+        _last_time = millis() - _start_time;
+        if(_state == MISSION_UPLOADING) {
+            _uploads++;
+        } else {
+            _downloads++;
+        }
+        getWorld()->getLogger()->log("Mission proxy: %u items %s in %u ms\n", _count, _state == MISSION_UPLOADING ? "written" : "read", _last_time);
+    } else {
+        _failures++;
+    }
+    _allocate(0);
+    _state = MISSION_IDLE;
+    _gcs   = NULL;
+}
+
+//---------------------------------------------------------------------------------
+//-- Give up on both sides (the autopilot only has a transfer open with us while
+//   fetching or uploading; once we are serving it is long done)
+void
+MavESP8266Mission::_abort(uint8_t result)
+{
+    getWorld()->getLogger()->log("Mission proxy: transfer aborted (%u)\n", result);
+    _ackGCS(result);
+    if(_state == MISSION_FETCHING || _state == MISSION_UPLOADING) {
+        _ackVehicle(MAV_MISSION_ERROR);
+    }
+    _finish(false);
+}
+
+//---------------------------------------------------------------------------------
+//-- Could not read the mission from the autopilot. End that and let the GCS
+//   ask the autopilot itself.
+void
+MavESP8266Mission::_passThrough()
+{
+    _ackVehicle(MAV_MISSION_ERROR);
+    mavlink_message_t msg;
+    mavlink_msg_mission_request_list_pack(_gcs_system, _gcs_component, &msg, _sysid, _compid);
+    _sendToVehicle(&msg);
+    _finish(false);
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Mission::_sendToVehicle(mavlink_message_t* msg)
+{
+    getWorld()->getVehicle()->sendMessage(msg);
+    _fc_time = millis();
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Mission::_sendToGCS(mavlink_message_t* msg)
+{
+    _gcs->sendMessage(msg);
+}
+
+//---------------------------------------------------------------------------------
+//-- MISSION_COUNT for the mission read from the autopilot
+void
+MavESP8266Mission::_countToGCS()
+{
+    mavlink_message_t msg;
+    mavlink_msg_mission_count_pack(_sysid, _compid, &msg, _gcs_system, _gcs_component, _count);
+    _sendToGCS(&msg);
+}
+
+//---------------------------------------------------------------------------------
+//-- Toward the autopilot the bridge speaks for itself
+void
+MavESP8266Mission::_requestFromVehicle()
+{
+    mavlink_message_t msg;
+    if(_fc_seq == MISSION_NONE) {
+        mavlink_msg_mission_request_list_pack(_sysid, MAV_COMP_ID_UDP_BRIDGE, &msg, _sysid, _compid);
+    } else {
+        mavlink_msg_mission_request_int_pack(_sysid, MAV_COMP_ID_UDP_BRIDGE, &msg, _sysid, _compid, _fc_seq);
+    }
+    _sendToVehicle(&msg);
+}
+
+//---------------------------------------------------------------------------------
+//-- Keep up to MISSION_WINDOW items coming from the GCS
+void
+MavESP8266Mission::_requestFromGCS()
+{
+    while(_gcs_base < _count && _have(_gcs_base)) {
+        _gcs_base++;
+    }
+    while(_gcs_next < _count && _gcs_next < _gcs_base + MISSION_WINDOW) {
+        if(!_have(_gcs_next)) {
+            mavlink_message_t msg;
+            mavlink_msg_mission_request_int_pack(_sysid, _compid, &msg, _gcs_system, _gcs_component, _gcs_next);
+            _sendToGCS(&msg);
+        }
+        _gcs_next++;
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Mission::_itemToVehicle(uint16_t seq)
+{
+    mavlink_mission_item_int_t item = _items[seq];
+    item.target_system    = _sysid;
+    item.target_component = _compid;
+    mavlink_message_t msg;
+    mavlink_msg_mission_item_int_encode(_sysid, MAV_COMP_ID_UDP_BRIDGE, &msg, &item);
+    _sendToVehicle(&msg);
+}
+
+//---------------------------------------------------------------------------------
+//-- Toward the GCS the bridge speaks for the autopilot
+void
+MavESP8266Mission::_itemToGCS(uint16_t seq)
+{
+    mavlink_mission_item_int_t item = _items[seq];
+    item.target_system    = _gcs_system;
+    item.target_component = _gcs_component;
+    mavlink_message_t msg;
+    mavlink_msg_mission_item_int_encode(_sysid, _compid, &msg, &item);
+    _sendToGCS(&msg);
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Mission::_ackGCS(uint8_t result)
+{
+    mavlink_message_t msg;
+    mavlink_msg_mission_ack_pack(_sysid, _compid, &msg, _gcs_system, _gcs_component, result);
+    _sendToGCS(&msg);
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Mission::_ackVehicle(uint8_t result)
+{
+    mavlink_message_t msg;
+    mavlink_msg_mission_ack_pack(_sysid, MAV_COMP_ID_UDP_BRIDGE, &msg, _sysid, _compid, result);
+    _sendToVehicle(&msg);
+}
+
+//---------------------------------------------------------------------------------
+//-- MISSION_REQUEST or MISSION_REQUEST_INT
+void
+MavESP8266Mission::_decodeRequest(mavlink_message_t* message, uint16_t* seq, uint8_t* component)
+{
+    if(message->msgid == MAVLINK_MSG_ID_MISSION_REQUEST_INT) {
+        mavlink_mission_request_int_t req;
+        mavlink_msg_mission_request_int_decode(message, &req);
+        *seq       = req.seq;
+        *component = req.target_component;
+    } else {
+        mavlink_mission_request_t req;
+        mavlink_msg_mission_request_decode(message, &req);
+        *seq       = req.seq;
+        *component = req.target_component;
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Mission messages from the GCS. Transfers are only taken over while
+//   MISSION_PROXY is on. Anything else is passed on to the vehicle.
+bool
+MavESP8266Mission::gcsMessage(MavESP8266Bridge* sender, mavlink_message_t* message)
+{
+    bool sameGCS = _state != MISSION_IDLE && message->sysid == _gcs_system && message->compid == _gcs_component;
+    switch(message->msgid) {
+        case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+        case MAVLINK_MSG_ID_MISSION_COUNT: {
+            if(!getWorld()->getParameters()->getMissionProxy() || (_state != MISSION_IDLE && !sameGCS)) {
+                return false;
+            }
+            uint8_t  system, component;
+            uint16_t count = 0;
+            if(message->msgid == MAVLINK_MSG_ID_MISSION_REQUEST_LIST) {
+                mavlink_mission_request_list_t req;
+                mavlink_msg_mission_request_list_decode(message, &req);
+                system    = req.target_system;
+                component = req.target_component;
+            } else {
+                mavlink_mission_count_t cnt;
+                mavlink_msg_mission_count_decode(message, &cnt);
+                system    = cnt.target_system;
+                component = cnt.target_component;
+                count     = cnt.count;
+            }
+            if(!_forVehicle(system, component)) {
+                return false;
+            }
+            //-- The GCS asking again because the answer is slow to come. The fetch
+            //   goes on, and once the mission is here the count is sent again.
+            if(sameGCS && message->msgid == MAVLINK_MSG_ID_MISSION_REQUEST_LIST) {
+                if(_state == MISSION_SERVING) {
+                    _gcs      = sender;
+                    _gcs_time = millis();
+                    _countToGCS();
+                    return true;
+                }
+                if(_state == MISSION_FETCHING) {
+                    return true;
+                }
+            }
+            //-- The GCS started over
+            if(_state != MISSION_IDLE) {
+                if(_state != MISSION_SERVING) {
+                    _ackVehicle(MAV_MISSION_ERROR);
+                }
+                _finish(false);
+            }
+            //-- Clearing the mission is a single message anyway
+            if(message->msgid == MAVLINK_MSG_ID_MISSION_COUNT && (!count || !_allocate(count))) {
+                return false;
+            }
+            _gcs           = sender;
+            _gcs_system    = message->sysid;
+            _gcs_component = message->compid;
+            _sysid         = getWorld()->getVehicle()->systemID();
+            _compid        = getWorld()->getVehicle()->componentID();
+            _fc_seq        = MISSION_NONE;
+            _retries       = 0;
+            _start_time    = millis();
+            _gcs_time      = _start_time;
+            if(message->msgid == MAVLINK_MSG_ID_MISSION_REQUEST_LIST) {
+                //-- Read it from the autopilot first
+                _state = MISSION_FETCHING;
+                _requestFromVehicle();
+            } else {
+                //-- Written to the autopilot as the items come in
+                _state    = MISSION_UPLOADING;
+                _gcs_base = 0;
+                _gcs_next = 0;
+                mavlink_message_t msg;
+                mavlink_msg_mission_count_pack(_sysid, MAV_COMP_ID_UDP_BRIDGE, &msg, _sysid, _compid, _count);
+                _sendToVehicle(&msg);
+                _requestFromGCS();
+            }
+            return true;
+        }
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST: {
+            if(!sameGCS) {
+                return false;
+            }
+            //-- Answered with MISSION_ITEM_INT either way
+            uint16_t seq;
+            uint8_t  component;
+            _decodeRequest(message, &seq, &component);
+            if(_state == MISSION_SERVING && seq < _count) {
+                _itemToGCS(seq);
+                _gcs_time = millis();
+            }
+            return true;
+        }
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT: {
+            if(!sameGCS || _state != MISSION_UPLOADING) {
+                return false;
+            }
+            mavlink_mission_item_int_t item;
+            mavlink_msg_mission_item_int_decode(message, &item);
+            if(item.seq < _count && !_have(item.seq)) {
+                _items[item.seq] = item;
+                _received[item.seq >> 3] |= 1 << (item.seq & 7);
+                _have_count++;
+                if(_fc_seq == item.seq) {
+                    _itemToVehicle(item.seq);
+                    _fc_seq = MISSION_NONE;
+                }
+            }
+            _gcs_time = millis();
+            _retries  = 0;
+            _requestFromGCS();
+            return true;
+        }
+        case MAVLINK_MSG_ID_MISSION_ITEM: {
+            if(!sameGCS || _state != MISSION_UPLOADING) {
+                return false;
+            }
+            //-- Only the MISSION_ITEM_INT protocol is proxied
+            _abort(MAV_MISSION_UNSUPPORTED);
+            return true;
+        }
+        case MAVLINK_MSG_ID_MISSION_ACK: {
+            if(!sameGCS) {
+                return false;
+            }
+            if(_state == MISSION_SERVING) {
+                _finish(true);
+            } else {
+                //-- Cancelled by the GCS
+                mavlink_mission_ack_t ack;
+                mavlink_msg_mission_ack_decode(message, &ack);
+                _ackVehicle(ack.type);
+                _finish(false);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- Mission messages from the autopilot to the bridge during a transfer
+bool
+MavESP8266Mission::vehicleMessage(mavlink_message_t* message)
+{
+    if(_state == MISSION_IDLE || message->sysid != _sysid || message->compid != _compid) {
+        return false;
+    }
+    switch(message->msgid) {
+        case MAVLINK_MSG_ID_MISSION_COUNT: {
+            mavlink_mission_count_t cnt;
+            mavlink_msg_mission_count_decode(message, &cnt);
+            if(cnt.target_component != MAV_COMP_ID_UDP_BRIDGE) {
+                return false;
+            }
+            if(_state != MISSION_FETCHING || _fc_seq != MISSION_NONE) {
+                return true;
+            }
+            if(!_allocate(cnt.count)) {
+                _passThrough();
+                return true;
+            }
+            _retries = 0;
+            if(_count) {
+                _fc_seq = 0;
+                _requestFromVehicle();
+            } else {
+                //-- Nothing to read
+                _ackVehicle(MAV_MISSION_ACCEPTED);
+                _state    = MISSION_SERVING;
+                _gcs_time = millis();
+                _countToGCS();
+            }
+            return true;
+        }
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT: {
+            mavlink_mission_item_int_t item;
+            mavlink_msg_mission_item_int_decode(message, &item);
+            if(item.target_component != MAV_COMP_ID_UDP_BRIDGE) {
+                return false;
+            }
+            if(_state != MISSION_FETCHING || item.seq != _fc_seq) {
+                return true;
+            }
+            _items[item.seq] = item;
+            _received[item.seq >> 3] |= 1 << (item.seq & 7);
+            _have_count++;
+            _retries = 0;
+            if(++_fc_seq < _count) {
+                _requestFromVehicle();
+            } else {
+                //-- All in. Now the GCS gets it.
+                _ackVehicle(MAV_MISSION_ACCEPTED);
+                _fc_seq   = MISSION_NONE;
+                _state    = MISSION_SERVING;
+                _gcs_time = millis();
+                _countToGCS();
+            }
+            return true;
+        }
+        case MAVLINK_MSG_ID_MISSION_ITEM: {
+            //-- An autopilot that only speaks MISSION_ITEM. Let the GCS deal with it.
+            if(_state == MISSION_FETCHING && _fc_seq != MISSION_NONE) {
+                _passThrough();
+                return true;
+            }
+            return false;
+        }
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST: {
+            uint16_t seq;
+            uint8_t  component;
+            _decodeRequest(message, &seq, &component);
+            if(component != MAV_COMP_ID_UDP_BRIDGE) {
+                return false;
+            }
+            if(_state != MISSION_UPLOADING || seq >= _count) {
+                return true;
+            }
+            _fc_time = millis();
+            if(_have(seq)) {
+                _itemToVehicle(seq);
+            } else {
+                //-- Sent as soon as the GCS delivers it
+                _fc_seq = seq;
+            }
+            return true;
+        }
+        case MAVLINK_MSG_ID_MISSION_ACK: {
+            mavlink_mission_ack_t ack;
+            mavlink_msg_mission_ack_decode(message, &ack);
+            if(ack.target_component != MAV_COMP_ID_UDP_BRIDGE) {
+                return false;
+            }
+            //-- The autopilot has the last word on an upload
+            _ackGCS(ack.type);
+            _finish(_state == MISSION_UPLOADING && ack.type == MAV_MISSION_ACCEPTED);
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- Retries and timeouts
+void
+MavESP8266Mission::service()
+{
+    if(_state == MISSION_IDLE) {
+        return;
+    }
+    unsigned long now = millis();
+    if(!getWorld()->getVehicle()->heardFrom()) {
+        _abort(MAV_MISSION_ERROR);
+        return;
+    }
+    switch(_state) {
+        case MISSION_FETCHING:
+            if(now - _fc_time > MISSION_FC_TIMEOUT) {
+                if(++_retries > MISSION_RETRIES) {
+                    _abort(MAV_MISSION_ERROR);
+                } else {
+                    _requestFromVehicle();
+                }
+            }
+            break;
+        case MISSION_SERVING:
+            if(now - _gcs_time > MISSION_IDLE_TIMEOUT) {
+                getWorld()->getLogger()->log("Mission proxy: GCS stopped reading the mission\n");
+                _finish(false);
+            }
+            break;
+        case MISSION_UPLOADING:
+            if(_have_count < _count && now - _gcs_time > MISSION_GCS_TIMEOUT) {
+                if(++_retries > MISSION_RETRIES) {
+                    _abort(MAV_MISSION_ERROR);
+                } else {
+                    //-- Ask again for whatever went missing
+                    _gcs_time = now;
+                    _gcs_next = _gcs_base;
+                    _requestFromGCS();
+                }
+            } else if(_have_count == _count && now - _fc_time > MISSION_IDLE_TIMEOUT) {
+                _abort(MAV_MISSION_ERROR);
+            }
+            break;
+    }
+}
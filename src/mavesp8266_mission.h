@@ -0,0 +1,117 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_mission.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_MISSION_H
+#define MAVESP8266_MISSION_H
+
+#include "mavesp8266.h"
+
+//-- Mission transfers are split in two: the bridge talks to the autopilot at UART
+//   speed and to the GCS from its own copy of the mission
+#define MISSION_MAX_ITEMS       500             // Larger missions are passed through
+#define MISSION_HEAP_RESERVE    (8 * 1024)      // RAM left free after allocating a mission
+#define MISSION_WINDOW          8               // Items requested ahead from the GCS during an upload
+#define MISSION_FC_TIMEOUT      250             // Resend a request to the autopilot after this long (ms)
+#define MISSION_GCS_TIMEOUT     1000            // Request missing items from the GCS again after this long (ms)
+#define MISSION_IDLE_TIMEOUT    5000            // Give up on a GCS that stopped talking (ms)
+#define MISSION_RETRIES         5
+
+class MavESP8266Mission {
+public:
+    MavESP8266Mission();
+
+    enum {
+        MISSION_IDLE = 0,
+        MISSION_FETCHING,   // Reading the mission from the autopilot
+        MISSION_SERVING,    // GCS reading the mission from the bridge
+        MISSION_UPLOADING,  // GCS writing the mission (relayed to the autopilot as it comes in)
+    };
+
+    //-- True if the message was handled here (and goes no further)
+    bool        vehicleMessage  (mavlink_message_t* message);
+    bool        gcsMessage      (MavESP8266Bridge* sender, mavlink_message_t* message);
+    void        service         ();
+    //-- Status
+    uint8_t     state           () { return _state; }
+    uint32_t    downloads       () { return _downloads; }
+    uint32_t    uploads         () { return _uploads; }
+    uint32_t    failures        () { return _failures; }
+    uint32_t    lastTransfer    () { return _last_time; }   // ms, GCS request to final ack
+
+private:
+    bool        _forVehicle     (uint8_t system, uint8_t component);
+    bool        _allocate       (uint16_t count);
+    void        _finish         (bool success);
+    void        _abort          (uint8_t result);
+    void        _passThrough    ();
+    void        _sendToVehicle  (mavlink_message_t* msg);
+    void        _sendToGCS      (mavlink_message_t* msg);
+    void        _countToGCS     ();
+    void        _requestFromVehicle();
+    void        _requestFromGCS ();
+    void        _itemToVehicle  (uint16_t seq);
+    void        _itemToGCS      (uint16_t seq);
+    void        _ackGCS         (uint8_t result);
+    void        _ackVehicle     (uint8_t result);
+    void        _decodeRequest  (mavlink_message_t* message, uint16_t* seq, uint8_t* component);
+    bool        _have           (uint16_t seq) { return _received[seq >> 3] & (1 << (seq & 7)); }
+
+private:
+    uint8_t                         _state;
+    mavlink_mission_item_int_t*     _items;
+    uint8_t*                        _received;      // Bitmap of the items in _items
+    uint16_t                        _count;
+    uint16_t                        _have_count;
+    MavESP8266Bridge*               _gcs;
+    uint8_t                         _gcs_system;    // Who to address replies to
+    uint8_t                         _gcs_component;
+    uint8_t                         _sysid;         // The autopilot
+    uint8_t                         _compid;
+    uint16_t                        _fc_seq;        // Item being read from the autopilot / it asked for (0xFFFF none)
+    uint16_t                        _gcs_base;      // First item still missing from the GCS
+    uint16_t                        _gcs_next;      // Next item to request from the GCS
+    uint8_t                         _retries;
+    unsigned long                   _fc_time;
+    unsigned long                   _gcs_time;
+    unsigned long                   _start_time;
+    uint32_t                        _downloads;
+    uint32_t                        _uploads;
+    uint32_t                        _failures;
+    uint32_t                        _last_time;
+};
+
+#endif
@@ -0,0 +1,638 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_paramcache.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_paramcache.h"
+#include "mavesp8266_parameters.h"
+#include "mavesp8266_vehicle.h"
+
+//-- The log holds one record per parameter value seen, the latest one wins. The
+//   header names the vehicle and parameter set it belongs to.
+const char* kPCACHE_LOG     = "/fcparams.log";
+const char* kPCACHE_HEADER  = "/fcparams.hdr";
+const char* kPCACHE_COMPACT = "/fcparams.tmp";
+const char* kPCACHE_HASH    = "_HASH_CHECK";
+
+#define PCACHE_MAGIC            0x31484350  // "PCH1"
+
+struct pcacheHeader {
+    uint32_t    magic;
+    uint8_t     sysid;
+    uint8_t     compid;
+    uint16_t    count;
+    uint32_t    hash;
+    uint32_t    hash_known;
+};
+
+//---------------------------------------------------------------------------------
+//-- Narrows down lookups by name to a record or two
+static uint8_t
+hashId(const char* id)
+{
+    uint8_t h = 0;
+    for(int i = 0; i < MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN && id[i]; i++) {
+        h = (h * 31) + (uint8_t)id[i];
+    }
+    return h;
+}
+
+//---------------------------------------------------------------------------------
+MavESP8266ParamCache::MavESP8266ParamCache()
+    : _enabled(false)
+    , _sysid(0)
+    , _compid(0)
+    , _count(0)
+    , _missing(0)
+    , _records(NULL)
+    , _id_hash(NULL)
+    , _log_records(0)
+    , _flushed(0)
+    , _buffered(0)
+    , _buffer_time(0)
+    , _compact_pending(false)
+    , _vehicle_up(false)
+    , _others(false)
+    , _hash_known(false)
+    , _hash_pending(false)
+    , _hash(0)
+    , _stream_to(NULL)
+    , _stream_index(0)
+    , _lists(0)
+    , _served(0)
+    , _dropped(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------
+//-- Initialize
+void
+MavESP8266ParamCache::begin()
+{
+    if(!getWorld()->getParameters()->getFcParamCache()) {
+        return;
+    }
+    if(!SPIFFS.begin()) {
+        getWorld()->getLogger()->log("Parameter cache: no file system\n");
+        return;
+    }
+    FSInfo info;
+    SPIFFS.info(info);
+    if(info.totalBytes < PCACHE_FLASH_SIZE * 2) {
+        getWorld()->getLogger()->log("Parameter cache: file system too small\n");
+        return;
+    }
+    _enabled = true;
+    _load();
+}
+
+//---------------------------------------------------------------------------------
+//-- Pick up what was cached before. None of it is trusted until the vehicle
+//   confirms its parameter hash or sends the parameters again.
+void
+MavESP8266ParamCache::_load()
+{
+    //-- Left over from a compaction cut short
+    SPIFFS.remove(kPCACHE_COMPACT);
+    pcacheHeader header;
+    File f = SPIFFS.open(kPCACHE_HEADER, "r");
+    bool valid = f && f.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+        header.magic == PCACHE_MAGIC && header.count && header.count <= PCACHE_MAX_PARAMS;
+    f.close();
+    File log = SPIFFS.open(kPCACHE_LOG, "r");
+    if(!valid || !log || (log.size() % PCACHE_RECORD_SIZE) || log.size() > PCACHE_FLASH_SIZE) {
+        log.close();
+        _reset(0, 0, 0);
+        return;
+    }
+    _allocate(header.sysid, header.compid, header.count);
+    _hash       = header.hash;
+    _hash_known = header.hash_known != 0;
+    pcacheRecord rec;
+    while(log.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec)) {
+        if(rec.index < _count) {
+            _records[rec.index] = _log_records | PCACHE_STALE;
+            _id_hash[rec.index] = hashId(rec.id);
+        }
+        _log_records++;
+    }
+    log.close();
+    _flushed = _log_records;
+    _file = SPIFFS.open(kPCACHE_LOG, "a");
+    getWorld()->getLogger()->log("Parameter cache: %u records for %u parameters (system %u)\n", _log_records, _count, _sysid);
+}
+
+//---------------------------------------------------------------------------------
+//-- Tables for a parameter set of count parameters, all missing
+void
+MavESP8266ParamCache::_allocate(uint8_t sysid, uint8_t compid, uint16_t count)
+{
+    free(_records);
+    free(_id_hash);
+    _records      = NULL;
+    _id_hash      = NULL;
+    _count        = 0;
+    _missing      = 0;
+    _sysid        = sysid;
+    _compid       = compid;
+    _log_records  = 0;
+    _flushed      = 0;
+    _buffered     = 0;
+    _compact_pending = false;
+    _stream_to    = NULL;
+    if(!count || count > PCACHE_MAX_PARAMS) {
+        return;
+    }
+    _records = (uint16_t*)malloc(count * sizeof(uint16_t));
+    _id_hash = (uint8_t*)malloc(count);
+    if(!_records || !_id_hash) {
+        free(_records);
+        free(_id_hash);
+        _records = NULL;
+        _id_hash = NULL;
+        getWorld()->getLogger()->log("Parameter cache: not enough memory for %u parameters\n", count);
+        return;
+    }
+    memset(_records, 0xFF, count * sizeof(uint16_t));
+    memset(_id_hash, 0, count);
+    _count   = count;
+    _missing = count;
+}
+
+//---------------------------------------------------------------------------------
+//-- Start over for a (new) parameter set
+void
+MavESP8266ParamCache::_reset(uint8_t sysid, uint8_t compid, uint16_t count)
+{
+    _allocate(sysid, compid, count);
+    _file.close();
+    _read_file.close();
+    SPIFFS.remove(kPCACHE_LOG);
+    _hash       = 0;
+    _hash_known = false;
+    _writeHeader();
+    _file = SPIFFS.open(kPCACHE_LOG, "w");
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266ParamCache::clear()
+{
+    if(_enabled) {
+        _reset(0, 0, 0);
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266ParamCache::_writeHeader()
+{
+    pcacheHeader header;
+    header.magic      = PCACHE_MAGIC;
+    header.sysid      = _sysid;
+    header.compid     = _compid;
+    header.count      = _count;
+    header.hash       = _hash;
+    header.hash_known = _hash_known;
+    File f = SPIFFS.open(kPCACHE_HEADER, "w");
+    if(f) {
+        f.write((uint8_t*)&header, sizeof(header));
+        f.close();
+    }
+}
+
+//---------------------------------------------------------------------------------
+uint8_t
+MavESP8266ParamCache::state()
+{
+    if(!_enabled) {
+        return PCACHE_OFF;
+    }
+    if(!_count || !_log_records) {
+        return PCACHE_EMPTY;
+    }
+    return _missing ? PCACHE_FILLING : PCACHE_READY;
+}
+
+//---------------------------------------------------------------------------------
+//-- Write buffered records and keep an eye on the vehicle
+void
+MavESP8266ParamCache::service()
+{
+    if(!_enabled) {
+        return;
+    }
+    bool up = getWorld()->getVehicle()->heardFrom();
+    if(up != _vehicle_up) {
+        _vehicle_up = up;
+        if(!up) {
+            //-- It may come back with other parameters (or be another vehicle)
+            _markAllStale();
+            _stream_to = NULL;
+        } else {
+            _requestHash();
+        }
+    }
+    if(_compact_pending) {
+        _compact();
+    } else if(_buffered && (_buffered >= PCACHE_BUFFER_RECORDS / 2 || (millis() - _buffer_time) > PCACHE_FLUSH_TIME)) {
+        _flush();
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266ParamCache::_flush()
+{
+    if(_file) {
+        _file.write(_buffer, _buffered * PCACHE_RECORD_SIZE);
+        _file.flush();
+    }
+    _flushed += _buffered;
+    _buffered = 0;
+    //-- Reopened on the next read so it sees what was just written
+    _read_file.close();
+}
+
+//---------------------------------------------------------------------------------
+//-- A parameter value from the vehicle
+void
+MavESP8266ParamCache::_append(uint16_t index, mavlink_param_value_t* param)
+{
+    //-- Out of room. Only the latest record of each parameter is worth keeping,
+    //   but rewriting the log takes far too long to do while parsing the UART.
+    //   service() does it.
+    if(_log_records >= PCACHE_MAX_RECORDS) {
+        _compact_pending = true;
+    }
+    //-- Flash can't keep up (or is about to be rewritten). The vehicle gets asked
+    //   next time.
+    if(_compact_pending || _buffered >= PCACHE_BUFFER_RECORDS) {
+        _dropped++;
+        _markStale(index);
+        return;
+    }
+    pcacheRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.index = index;
+    rec.type  = param->param_type;
+    rec.value = param->param_value;
+    strncpy(rec.id, param->param_id, MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN);
+    memcpy(&_buffer[_buffered * PCACHE_RECORD_SIZE], &rec, sizeof(rec));
+    if(!_buffered) {
+        _buffer_time = millis();
+    }
+    _buffered++;
+    if(_records[index] & PCACHE_STALE) {
+        _missing--;
+    }
+    _records[index] = _log_records++;
+    _id_hash[index] = hashId(rec.id);
+}
+
+//---------------------------------------------------------------------------------
+//-- Rewrite the log with the latest record of each parameter (stale ones
+//   too, the vehicle may still confirm them). Start over if that fails.
+void
+MavESP8266ParamCache::_compact()
+{
+    _compact_pending = false;
+    _flush();
+    File out = SPIFFS.open(kPCACHE_COMPACT, "w");
+    uint16_t written = 0;
+    pcacheRecord rec;
+    for(uint16_t i = 0; out && i < _count; i++) {
+        if(_records[i] == PCACHE_MISSING) {
+            continue;
+        }
+        if(!_readRecord(_records[i] & ~PCACHE_STALE, &rec) || out.write((uint8_t*)&rec, sizeof(rec)) != sizeof(rec)) {
+            out.close();
+            break;
+        }
+        _records[i] = written++ | (_records[i] & PCACHE_STALE);
+    }
+    bool ok = out;
+    out.close();
+    _file.close();
+    _read_file.close();
+    SPIFFS.remove(kPCACHE_LOG);
+    if(!ok || !SPIFFS.rename(kPCACHE_COMPACT, kPCACHE_LOG)) {
+        SPIFFS.remove(kPCACHE_COMPACT);
+        _reset(_sysid, _compid, _count);
+        return;
+    }
+    _log_records = written;
+    _flushed     = written;
+    _file = SPIFFS.open(kPCACHE_LOG, "a");
+    getWorld()->getLogger()->log("Parameter cache: log compacted to %u records\n", written);
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266ParamCache::_readRecord(uint16_t record, pcacheRecord* rec)
+{
+    if(record >= _log_records) {
+        return false;
+    }
+    if(record >= _flushed) {
+        memcpy(rec, &_buffer[(record - _flushed) * PCACHE_RECORD_SIZE], sizeof(*rec));
+        return true;
+    }
+    if(!_read_file) {
+        _read_file = SPIFFS.open(kPCACHE_LOG, "r");
+        if(!_read_file) {
+            return false;
+        }
+    }
+    return _read_file.seek((uint32_t)record * PCACHE_RECORD_SIZE, SeekSet) &&
+        _read_file.read((uint8_t*)rec, sizeof(*rec)) == sizeof(*rec);
+}
+
+//---------------------------------------------------------------------------------
+//-- Index of a parameter by name (stale ones too), -1 if not cached
+int
+MavESP8266ParamCache::_lookup(const char* id)
+{
+    uint8_t h = hashId(id);
+    pcacheRecord rec;
+    for(uint16_t i = 0; i < _count; i++) {
+        if(_records[i] == PCACHE_MISSING || _id_hash[i] != h) {
+            continue;
+        }
+        if(_readRecord(_records[i] & ~PCACHE_STALE, &rec) && strncmp(rec.id, id, MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266ParamCache::_markStale(uint16_t index)
+{
+    if(index < _count && !(_records[index] & PCACHE_STALE)) {
+        _records[index] |= PCACHE_STALE;
+        _missing++;
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266ParamCache::_markAllStale()
+{
+    for(uint16_t i = 0; i < _count; i++) {
+        _markStale(i);
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- The vehicle has the parameter set that was cached
+void
+MavESP8266ParamCache::_confirmAll()
+{
+    for(uint16_t i = 0; i < _count; i++) {
+        if(_records[i] != PCACHE_MISSING && (_records[i] & PCACHE_STALE)) {
+            _records[i] &= ~PCACHE_STALE;
+            _missing--;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Ask the autopilot for its parameter hash (PX4 has one, others ignore it)
+void
+MavESP8266ParamCache::_requestHash()
+{
+    MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+    if(!_hash_known || vehicle->systemID() != _sysid || vehicle->componentID() != _compid) {
+        return;
+    }
+    mavlink_message_t msg;
+    mavlink_msg_param_request_read_pack(
+        vehicle->systemID(),
+        MAV_COMP_ID_UDP_BRIDGE,
+        &msg,
+        _sysid,
+        _compid,
+        kPCACHE_HASH,
+        -1
+    );
+    vehicle->sendMessage(&msg);
+    _hash_pending = true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Addressed to the autopilot whose parameters are cached. Requests to all
+//   components only if no other component of the vehicle has parameters.
+bool
+MavESP8266ParamCache::_forVehicle(uint8_t system, uint8_t component)
+{
+    return _count && system == _sysid && (component == _compid || (component == MAV_COMP_ID_ALL && !_others));
+}
+
+//---------------------------------------------------------------------------------
+//-- PARAM_VALUE as the autopilot would send it
+bool
+MavESP8266ParamCache::_pack(uint16_t index, mavlink_message_t* msg)
+{
+    pcacheRecord rec;
+    if(_records[index] == PCACHE_MISSING || !_readRecord(_records[index] & ~PCACHE_STALE, &rec)) {
+        return false;
+    }
+    mavlink_param_value_t param;
+    param.param_value = rec.value;
+    param.param_count = _count;
+    param.param_index = index;
+    param.param_type  = rec.type;
+    strncpy(param.param_id, rec.id, MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN);
+    mavlink_msg_param_value_encode(_sysid, _compid, msg, &param);
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Parameter values on their way from the vehicle to the GCS
+bool
+MavESP8266ParamCache::vehicleMessage(mavlink_message_t* message)
+{
+    if(!_enabled || message->msgid != MAVLINK_MSG_ID_PARAM_VALUE) {
+        return false;
+    }
+    MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+    if(message->sysid != vehicle->systemID()) {
+        return false;
+    }
+    if(message->compid != vehicle->componentID()) {
+        _others = true;
+        return false;
+    }
+    mavlink_param_value_t param;
+    mavlink_msg_param_value_decode(message, &param);
+    //-- PX4 identifies its parameter set by a hash
+    if(strncmp(param.param_id, kPCACHE_HASH, MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN) == 0) {
+        uint32_t hash;
+        memcpy(&hash, &param.param_value, sizeof(hash));
+        if(_hash_known && hash == _hash) {
+            _confirmAll();
+        } else {
+            _hash       = hash;
+            _hash_known = true;
+            _writeHeader();
+        }
+        //-- Only ours if the bridge asked
+        bool ours = _hash_pending;
+        _hash_pending = false;
+        return ours;
+    }
+    if(param.param_count > PCACHE_MAX_PARAMS) {
+        if(_count) {
+            _reset(message->sysid, message->compid, 0);
+        }
+        return false;
+    }
+    //-- Another vehicle or parameter set
+    if(param.param_count != _count || message->sysid != _sysid || message->compid != _compid) {
+        _reset(message->sysid, message->compid, param.param_count);
+        if(!_count) {
+            return false;
+        }
+    }
+    //-- Values sent after a PARAM_SET may not have an index
+    int index = param.param_index;
+    if(index >= _count) {
+        index = _lookup(param.param_id);
+        if(index < 0) {
+            return false;
+        }
+    }
+    _append(index, &param);
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- Parameter requests from the GCS. Returns true if answered from the cache.
+bool
+MavESP8266ParamCache::gcsMessage(MavESP8266Bridge* sender, mavlink_message_t* message)
+{
+    if(!_enabled) {
+        return false;
+    }
+    if(message->msgid == MAVLINK_MSG_ID_PARAM_REQUEST_LIST) {
+        mavlink_param_request_list_t param;
+        mavlink_msg_param_request_list_decode(message, &param);
+        if(!_forVehicle(param.target_system, param.target_component)) {
+            return false;
+        }
+        if(_missing) {
+            //-- The vehicle answers this one and what it sends refreshes the cache.
+            //   The whole set must fit in the log, or it would have to be compacted
+            //   over and over during the download. Nothing in it is current anyway.
+            if(_log_records + _count > PCACHE_MAX_RECORDS) {
+                _reset(_sysid, _compid, _count);
+            } else {
+                _markAllStale();
+            }
+            return false;
+        }
+        _stream_to    = sender;
+        _stream_index = 0;
+        _lists++;
+        getWorld()->getLogger()->log("Parameter cache: sending %u parameters\n", _count);
+        return true;
+    } else if(message->msgid == MAVLINK_MSG_ID_PARAM_REQUEST_READ) {
+        mavlink_param_request_read_t param;
+        mavlink_msg_param_request_read_decode(message, &param);
+        if(!_forVehicle(param.target_system, param.target_component)) {
+            return false;
+        }
+        int index = param.param_index >= 0 ? param.param_index : _lookup(param.param_id);
+        if(index < 0 || index >= _count || (_records[index] & PCACHE_STALE)) {
+            return false;
+        }
+        mavlink_message_t msg;
+        if(!_pack(index, &msg)) {
+            return false;
+        }
+        sender->sendMessage(&msg);
+        _served++;
+        return true;
+    } else if(message->msgid == MAVLINK_MSG_ID_PARAM_SET) {
+        mavlink_param_set_t param;
+        mavlink_msg_param_set_decode(message, &param);
+        if(_forVehicle(param.target_system, param.target_component)) {
+            //-- Fresh again once the vehicle sends the new value
+            int index = _lookup(param.param_id);
+            if(index >= 0) {
+                _markStale(index);
+            }
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- Send the cached list for up to budget us. Returns true while there is more.
+bool
+MavESP8266ParamCache::stream(uint32_t budget)
+{
+    if(!_stream_to) {
+        return false;
+    }
+    unsigned long start = micros();
+    mavlink_message_t batch[PCACHE_BATCH];
+    do {
+        int count = 0;
+        while(count < PCACHE_BATCH && _stream_index + count < _count && _pack(_stream_index + count, &batch[count])) {
+            count++;
+        }
+        if(!count) {
+            _stream_to = NULL;
+            return false;
+        }
+        int sent = _stream_to->sendMessage(batch, count);
+        _stream_index += sent;
+        _served       += sent;
+        if(_stream_index >= _count) {
+            _stream_to = NULL;
+            return false;
+        }
+        //-- Backed up. Try again on the next pass.
+        if(sent < count) {
+            break;
+        }
+    } while(micros() - start < budget);
+    return true;
+}
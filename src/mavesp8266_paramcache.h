@@ -0,0 +1,139 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_paramcache.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_PARAMCACHE_H
+#define MAVESP8266_PARAMCACHE_H
+
+#include "mavesp8266.h"
+#include <FS.h>
+
+//-- Autopilot parameters seen going to the GCS, kept in SPIFFS so a GCS that
+//   reconnects gets them from the bridge instead of the vehicle
+#define PCACHE_FLASH_SIZE       (32 * 1024)     // Flash set aside for the cache (taken from the telemetry log)
+#define PCACHE_RECORD_SIZE      24
+#define PCACHE_MAX_RECORDS      (PCACHE_FLASH_SIZE / PCACHE_RECORD_SIZE)
+#define PCACHE_MAX_PARAMS       1200            // Larger parameter sets are not cached
+#define PCACHE_BUFFER_RECORDS   16              // Records waiting to be written to flash
+#define PCACHE_FLUSH_TIME       500             // Write them after this long (ms) even if there are few
+#define PCACHE_BATCH            4               // Parameters per datagram when answering a list request
+#define PCACHE_MISSING          0xFFFF          // No record for this parameter
+#define PCACHE_STALE            0x8000          // The record may be out of date
+
+class MavESP8266ParamCache {
+public:
+    MavESP8266ParamCache();
+
+    enum {
+        PCACHE_OFF = 0,
+        PCACHE_EMPTY,       // Nothing cached for this vehicle
+        PCACHE_FILLING,     // Some parameters are missing or may be out of date
+        PCACHE_READY,       // Requests are answered from the cache
+    };
+
+    void        begin           ();
+    uint32_t    flashSize       () { return _enabled ? PCACHE_FLASH_SIZE : 0; }
+    //-- Messages from the vehicle (snooped) and from the GCS. True if the message ends here.
+    bool        vehicleMessage  (mavlink_message_t* message);
+    bool        gcsMessage      (MavESP8266Bridge* sender, mavlink_message_t* message);
+    void        service         ();
+    bool        stream          (uint32_t budget);
+    void        clear           ();
+    //-- Status
+    uint8_t     state           ();
+    uint16_t    paramCount      () { return _count; }
+    uint16_t    freshCount      () { return _count - _missing; }
+    uint16_t    logRecords      () { return _log_records; }
+    uint32_t    listsServed     () { return _lists; }
+    uint32_t    paramsServed    () { return _served; }
+    uint32_t    recordsDropped  () { return _dropped; }
+    bool        hashKnown       () { return _hash_known; }
+    uint32_t    hash            () { return _hash; }
+
+private:
+    struct pcacheRecord {
+        uint16_t    index;
+        uint8_t     type;
+        uint8_t     reserved;
+        float       value;
+        char        id[MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN];
+    };
+
+    void        _allocate       (uint8_t sysid, uint8_t compid, uint16_t count);
+    void        _reset          (uint8_t sysid, uint8_t compid, uint16_t count);
+    void        _load           ();
+    void        _writeHeader    ();
+    void        _flush          ();
+    void        _append         (uint16_t index, mavlink_param_value_t* param);
+    void        _compact        ();
+    bool        _readRecord     (uint16_t record, pcacheRecord* rec);
+    int         _lookup         (const char* id);
+    void        _markStale      (uint16_t index);
+    void        _markAllStale   ();
+    void        _confirmAll     ();
+    void        _requestHash    ();
+    bool        _forVehicle     (uint8_t system, uint8_t component);
+    bool        _pack           (uint16_t index, mavlink_message_t* msg);
+
+private:
+    bool                _enabled;
+    uint8_t             _sysid;
+    uint8_t             _compid;
+    uint16_t            _count;
+    uint16_t            _missing;       // Parameters missing or stale
+    uint16_t*           _records;       // Log record of each parameter (with PCACHE_STALE)
+    uint8_t*            _id_hash;       // Hash of each parameter name, for lookups by name
+    uint16_t            _log_records;   // Records in the log (including the buffered ones)
+    uint16_t            _flushed;       // Records in flash
+    uint8_t             _buffer[PCACHE_BUFFER_RECORDS * PCACHE_RECORD_SIZE];
+    uint8_t             _buffered;
+    unsigned long       _buffer_time;
+    bool                _compact_pending; // Log is full, service() compacts it
+    File                _file;
+    File                _read_file;
+    bool                _vehicle_up;
+    bool                _others;        // Other components of the vehicle have parameters too
+    bool                _hash_known;
+    bool                _hash_pending;  // Asked the vehicle for _HASH_CHECK (the answer is not forwarded)
+    uint32_t            _hash;          // _HASH_CHECK reported by the vehicle (PX4)
+    MavESP8266Bridge*   _stream_to;     // Who asked for the list (while sending it)
+    uint16_t            _stream_index;
+    uint32_t            _lists;
+    uint32_t            _served;
+    uint32_t            _dropped;
+};
+
+#endif
@@ -47,7 +47,7 @@ const char* kDEFAULT_WEBACCOUNT = "PixRacer";
 const char* kDEFAULT_WEBPASSWORD = "pixracer";
 
 //-- Reserved space for EEPROM persistence. A change in this will cause all values to reset to defaults.
-#define EEPROM_SPACE            40 * sizeof(uint32_t)
+#define EEPROM_SPACE            48 * sizeof(uint32_t)
 #define EEPROM_CRC_ADD          EEPROM_SPACE - (sizeof(uint32_t) << 1)
 
 uint32_t    _sw_version;
@@ -68,6 +68,22 @@ uint32_t    _uart_baud_rate;
 uint32_t    _flash_left;
 char        _web_account[16];
 char        _web_password[16];
+int8_t      _tlog_enabled;
+uint16_t    _uart_rx_buffer;
+int8_t      _uart_flow_control;
+int8_t      _uart_autobaud;
+uint16_t    _uart_budget;
+uint16_t    _udp_budget;
+int8_t      _gcs_discovery;
+uint32_t    _gcs_disc_msgids;
+uint32_t    _fast_lane;
+int8_t      _fc_param_cache;
+int8_t      _mission_proxy;
+int8_t      _log_readahead;
+int8_t      _ftp_resend;
+uint16_t    _gcs_backlog;
+uint32_t    _telem_cache;
+uint32_t    _web_auth_serial = 0; //-- Bumped whenever the web account or password may have changed
 
 //-- Parameters
 //   No string support in parameters so we stash a char[16] into 4 uint32_t
@@ -106,7 +122,22 @@ struct stMavEspParameters mavParameters[] = {
   {"WEB_PASSWORD1",     &_web_password[0],     MavESP8266Parameters::ID_WEBPWD1,     sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false},
   {"WEB_PASSWORD2",     &_web_password[4],     MavESP8266Parameters::ID_WEBPWD2,     sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false},
   {"WEB_PASSWORD3",     &_web_password[8],     MavESP8266Parameters::ID_WEBPWD3,     sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false},
-  {"WEB_PASSWORD4",     &_web_password[12],    MavESP8266Parameters::ID_WEBPWD4,     sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false}
+  {"WEB_PASSWORD4",     &_web_password[12],    MavESP8266Parameters::ID_WEBPWD4,     sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false},
+  {"TLOG_ENABLED",      &_tlog_enabled,        MavESP8266Parameters::ID_TLOG,        sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"UART_RXBUF",        &_uart_rx_buffer,      MavESP8266Parameters::ID_UART_RXBUF,  sizeof(uint16_t),   MAV_PARAM_TYPE_UINT16,  false},
+  {"UART_FLOWCTL",      &_uart_flow_control,   MavESP8266Parameters::ID_UART_FLOWCTL, sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"UART_AUTOBAUD",     &_uart_autobaud,       MavESP8266Parameters::ID_UART_AUTOBAUD, sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"UART_BUDGET",       &_uart_budget,         MavESP8266Parameters::ID_UART_BUDGET, sizeof(uint16_t),   MAV_PARAM_TYPE_UINT16,  false},
+  {"UDP_BUDGET",        &_udp_budget,          MavESP8266Parameters::ID_UDP_BUDGET,  sizeof(uint16_t),   MAV_PARAM_TYPE_UINT16,  false},
+  {"GCS_DISCOVERY",     &_gcs_discovery,       MavESP8266Parameters::ID_GCS_DISCOVERY, sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"GCS_DISC_MSGIDS",   &_gcs_disc_msgids,     MavESP8266Parameters::ID_GCS_DISC_MSGS, sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false},
+  {"FAST_LANE",         &_fast_lane,           MavESP8266Parameters::ID_FAST_LANE,   sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false},
+  {"FC_PARAM_CACHE",    &_fc_param_cache,      MavESP8266Parameters::ID_FC_PARAM_CACHE, sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"MISSION_PROXY",     &_mission_proxy,       MavESP8266Parameters::ID_MISSION_PROXY, sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"LOG_READAHEAD",     &_log_readahead,       MavESP8266Parameters::ID_LOG_READAHEAD, sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"FTP_RESEND",        &_ftp_resend,          MavESP8266Parameters::ID_FTP_RESEND,  sizeof(int8_t),     MAV_PARAM_TYPE_INT8,    false},
+  {"GCS_BACKLOG",       &_gcs_backlog,         MavESP8266Parameters::ID_GCS_BACKLOG, sizeof(uint16_t),   MAV_PARAM_TYPE_UINT16,  false},
+  {"TELEM_CACHE",       &_telem_cache,         MavESP8266Parameters::ID_TELEM_CACHE, sizeof(uint32_t),   MAV_PARAM_TYPE_UINT32,  false}
 };
 
 //---------------------------------------------------------------------------------
@@ -197,6 +228,55 @@ char*       MavESP8266Parameters::getWebAccount    () {
 char*       MavESP8266Parameters::getWebPassword() {
   return _web_password;
 }
+uint32_t    MavESP8266Parameters::getWebAuthSerial  () {
+  return _web_auth_serial;
+}
+int8_t      MavESP8266Parameters::getTlogEnabled    () {
+  return _tlog_enabled;
+}
+uint16_t    MavESP8266Parameters::getUartRxBuffer   () {
+  //-- It may also have been set over MAVLink
+  return uartRxBufferSize(_uart_rx_buffer);
+}
+int8_t      MavESP8266Parameters::getUartFlowControl() {
+  return _uart_flow_control;
+}
+int8_t      MavESP8266Parameters::getUartAutobaud   () {
+  return _uart_autobaud;
+}
+uint16_t    MavESP8266Parameters::getUartBudget     () {
+  return _uart_budget;
+}
+uint16_t    MavESP8266Parameters::getUdpBudget      () {
+  return _udp_budget;
+}
+int8_t      MavESP8266Parameters::getGcsDiscovery   () {
+  return _gcs_discovery;
+}
+uint32_t    MavESP8266Parameters::getGcsDiscoveryMsgs() {
+  return _gcs_disc_msgids;
+}
+uint32_t    MavESP8266Parameters::getFastLane       () {
+  return _fast_lane;
+}
+int8_t      MavESP8266Parameters::getFcParamCache   () {
+  return _fc_param_cache;
+}
+int8_t      MavESP8266Parameters::getMissionProxy   () {
+  return _mission_proxy;
+}
+int8_t      MavESP8266Parameters::getLogReadAhead   () {
+  return _log_readahead;
+}
+int8_t      MavESP8266Parameters::getFtpResend      () {
+  return _ftp_resend;
+}
+uint16_t    MavESP8266Parameters::getGcsBacklog     () {
+  return _gcs_backlog;
+}
+uint32_t    MavESP8266Parameters::getTelemCache     () {
+  return _telem_cache;
+}
 //---------------------------------------------------------------------------------
 //-- Reset all to defaults
 void
@@ -212,12 +292,28 @@ MavESP8266Parameters::resetToDefaults()
   _wifi_ipsta        = 0;
   _wifi_gatewaysta   = 0;
   _wifi_subnetsta    = 0;
+  _tlog_enabled      = 0;
+  _uart_rx_buffer    = DEFAULT_UART_RXBUF;
+  _uart_flow_control = 0;
+  _uart_autobaud     = DEFAULT_UART_AUTOBAUD;
+  _uart_budget       = DEFAULT_UART_BUDGET;
+  _udp_budget        = DEFAULT_UDP_BUDGET;
+  _gcs_discovery     = DEFAULT_GCS_DISCOVERY;
+  _gcs_disc_msgids   = DEFAULT_GCS_DISC_MSGIDS;
+  _fast_lane         = DEFAULT_FAST_LANE;
+  _fc_param_cache    = DEFAULT_FC_PARAM_CACHE;
+  _mission_proxy     = DEFAULT_MISSION_PROXY;
+  _log_readahead     = DEFAULT_LOG_READAHEAD;
+  _ftp_resend        = DEFAULT_FTP_RESEND;
+  _gcs_backlog       = DEFAULT_GCS_BACKLOG;
+  _telem_cache       = DEFAULT_TELEM_CACHE;
   strncpy(_wifi_ssid,         kDEFAULT_SSID,      sizeof(_wifi_ssid));
   strncpy(_wifi_password,     kDEFAULT_PASSWORD,  sizeof(_wifi_password));
   strncpy(_wifi_ssidsta,      kDEFAULT_SSID,      sizeof(_wifi_ssidsta));
   strncpy(_wifi_passwordsta,  kDEFAULT_PASSWORD,  sizeof(_wifi_passwordsta));
   strncpy(_web_account,  kDEFAULT_WEBACCOUNT,  sizeof(_web_account));
   strncpy(_web_password,  kDEFAULT_WEBPASSWORD,  sizeof(_web_password));
+  invalidateWebAuth();
   _flash_left = ESP.getFreeSketchSpace();
 }
 
@@ -249,6 +345,7 @@ MavESP8266Parameters::loadAllFromEeprom()
 #endif
   //-- Version if hardwired
   _sw_version = MAVESP8266_VERSION;
+  invalidateWebAuth();
   _flash_left = ESP.getFreeSketchSpace();
 }
 
@@ -461,10 +558,119 @@ void
 MavESP8266Parameters::setWebAccount(const char* acc)
 {
   strncpy(_web_account, acc, sizeof(_web_account));
+  invalidateWebAuth();
 }
 //---------------------------------------------------------------------------------
 void
 MavESP8266Parameters::setWebPassword (const char* pwd)
 {
   strncpy(_web_password, pwd, sizeof(_web_password));
+  invalidateWebAuth();
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setTlogEnabled(int8_t enabled)
+{
+  _tlog_enabled = enabled;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setUartRxBuffer(uint16_t size)
+{
+  _uart_rx_buffer = uartRxBufferSize(size);
+}
+//---------------------------------------------------------------------------------
+//-- A UART buffer size that can be used (see UART_RXBUF_MIN/MAX)
+uint16_t
+MavESP8266Parameters::uartRxBufferSize(int32_t size)
+{
+  uint16_t valid = UART_RXBUF_MIN;
+  while (valid < UART_RXBUF_MAX && valid * 2 <= size) {
+    valid *= 2;
+  }
+  return valid;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setUartFlowControl(int8_t enabled)
+{
+  _uart_flow_control = enabled;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setUartAutobaud(int8_t mode)
+{
+  _uart_autobaud = mode;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setUartBudget(uint16_t budget)
+{
+  _uart_budget = budget;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setUdpBudget(uint16_t budget)
+{
+  _udp_budget = budget;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setGcsDiscovery(int8_t mode)
+{
+  _gcs_discovery = mode;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setGcsDiscoveryMsgs(uint32_t ids)
+{
+  _gcs_disc_msgids = ids;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setFastLane(uint32_t mask)
+{
+  _fast_lane = mask;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setFcParamCache(int8_t enabled)
+{
+  _fc_param_cache = enabled;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setMissionProxy(int8_t enabled)
+{
+  _mission_proxy = enabled;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setLogReadAhead(int8_t enabled)
+{
+  _log_readahead = enabled;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setFtpResend(int8_t enabled)
+{
+  _ftp_resend = enabled;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setGcsBacklog(uint16_t seconds)
+{
+  _gcs_backlog = seconds;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::setTelemCache(uint32_t mask)
+{
+  _telem_cache = mask;
+}
+//---------------------------------------------------------------------------------
+void
+MavESP8266Parameters::invalidateWebAuth()
+{
+  _web_auth_serial++;
 }
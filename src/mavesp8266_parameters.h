@@ -44,10 +44,36 @@
 //-- Constants
 #define DEFAULT_WIFI_MODE       WIFI_MODE_AP
 #define DEFAULT_UART_SPEED      921600
+#define DEFAULT_UART_RXBUF      1024
+#define DEFAULT_UART_AUTOBAUD   UART_AUTOBAUD_DETECT
+#define DEFAULT_UART_BUDGET     2000    // us per pass spent draining the UART
+#define DEFAULT_UDP_BUDGET      1000    // us per pass spent draining UDP
+#define DEFAULT_GCS_DISCOVERY   GCS_DISCOVERY_ON
+#define DEFAULT_GCS_DISC_MSGIDS 0       // Up to four more msgids, one per byte (0 for none)
+#define DEFAULT_FAST_LANE       0x7FF   // All of kFastLane (see mavesp8266.cpp)
+#define DEFAULT_FC_PARAM_CACHE  1
+#define DEFAULT_MISSION_PROXY   0
+#define DEFAULT_LOG_READAHEAD   0
+#define DEFAULT_FTP_RESEND      1
+#define DEFAULT_GCS_BACKLOG     30      // Seconds of messages kept for a GCS that drops out (0 for none)
+#define DEFAULT_TELEM_CACHE     0x1F    // All of the messages in mavesp8266_telemetry.h
 #define DEFAULT_WIFI_CHANNEL    11
 #define DEFAULT_UDP_HPORT       14550
 #define DEFAULT_UDP_CPORT       14555
 
+//-- UART_RXBUF (rounded down to a power of two within these)
+#define UART_RXBUF_MIN          256     // The Arduino default
+#define UART_RXBUF_MAX          8192
+
+//-- UART_AUTOBAUD
+#define UART_AUTOBAUD_OFF       0
+#define UART_AUTOBAUD_DETECT    1   // Detect the vehicle's baud rate at boot and after a heartbeat timeout
+#define UART_AUTOBAUD_PERSIST   2   // Same and save it to EEPROM
+
+//-- GCS_DISCOVERY
+#define GCS_DISCOVERY_OFF       0   // Stream everything to DHCP clients (broadcast in station mode) until a GCS is heard
+#define GCS_DISCOVERY_ON        1   // Only forward HEARTBEAT (and GCS_DISC_MSGIDS), once a second each
+
 struct stMavEspParameters {
     char        id[MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN];
     void*       value;
@@ -97,6 +123,21 @@ public:
         ID_WEBPWD2,
         ID_WEBPWD3,
 		ID_WEBPWD4,
+        ID_TLOG,
+        ID_UART_RXBUF,
+        ID_UART_FLOWCTL,
+        ID_UART_AUTOBAUD,
+        ID_UART_BUDGET,
+        ID_UDP_BUDGET,
+        ID_GCS_DISCOVERY,
+        ID_GCS_DISC_MSGS,
+        ID_FAST_LANE,
+        ID_FC_PARAM_CACHE,
+        ID_MISSION_PROXY,
+        ID_LOG_READAHEAD,
+        ID_FTP_RESEND,
+        ID_GCS_BACKLOG,
+        ID_TELEM_CACHE,
         ID_COUNT
     };
 
@@ -122,6 +163,22 @@ public:
     uint32_t    getUartBaudRate             ();
     char*       getWebAccount               ();
     char*       getWebPassword               ();
+    uint32_t    getWebAuthSerial            ();
+    int8_t      getTlogEnabled              ();
+    uint16_t    getUartRxBuffer             ();
+    int8_t      getUartFlowControl          ();
+    int8_t      getUartAutobaud             ();
+    uint16_t    getUartBudget               ();
+    uint16_t    getUdpBudget                ();
+    int8_t      getGcsDiscovery             ();
+    uint32_t    getGcsDiscoveryMsgs         ();
+    uint32_t    getFastLane                 ();
+    int8_t      getFcParamCache             ();
+    int8_t      getMissionProxy             ();
+    int8_t      getLogReadAhead             ();
+    int8_t      getFtpResend                ();
+    uint16_t    getGcsBacklog               ();
+    uint32_t    getTelemCache               ();
 
     void        setDebugEnabled             (int8_t enabled);
     void        setWifiMode                 (int8_t mode);
@@ -139,6 +196,23 @@ public:
     void        setLocalIPAddress           (uint32_t ipAddress);
     void        setWebAccount               (const char* pwd);
     void        setWebPassword               (const char* pwd);
+    void        invalidateWebAuth           ();
+    void        setTlogEnabled              (int8_t enabled);
+    void        setUartRxBuffer             (uint16_t size);
+    static uint16_t uartRxBufferSize        (int32_t size);
+    void        setUartFlowControl          (int8_t enabled);
+    void        setUartAutobaud             (int8_t mode);
+    void        setUartBudget               (uint16_t budget);
+    void        setUdpBudget                (uint16_t budget);
+    void        setGcsDiscovery             (int8_t mode);
+    void        setGcsDiscoveryMsgs         (uint32_t ids);
+    void        setFastLane                 (uint32_t mask);
+    void        setFcParamCache             (int8_t enabled);
+    void        setMissionProxy             (int8_t enabled);
+    void        setLogReadAhead             (int8_t enabled);
+    void        setFtpResend                (int8_t enabled);
+    void        setGcsBacklog               (uint16_t seconds);
+    void        setTelemCache               (uint32_t mask);
 
     stMavEspParameters* getAt               (int index);
 
@@ -0,0 +1,406 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_recorder.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_recorder.h"
+#include "mavesp8266_parameters.h"
+#include "mavesp8266_paramcache.h"
+
+const char* kTLOG_SEGMENT[2]    = {"/tlog.0", "/tlog.1"};
+const char* kTLOG_INDEX         = "/tlog.idx";
+
+//---------------------------------------------------------------------------------
+MavESP8266Recorder::MavESP8266Recorder()
+    : _ready(false)
+    , _filtered(false)
+    , _state(TLOG_STOPPED)
+    , _segment(0)
+    , _segment_size(0)
+    , _head(0)
+    , _tail(0)
+    , _seg_bytes(0)
+    , _switch_at(0)
+    , _switch_pending(false)
+    , _read_segment(-1)
+    , _frames(0)
+    , _dropped(0)
+    , _written(0)
+    , _budget_used(0)
+    , _budget_time(0)
+    , _space_time(0)
+    , _micros_high(0)
+    , _micros_last(0)
+    , _time_offset(0)
+{
+    memset(_filter, 0, sizeof(_filter));
+}
+
+//---------------------------------------------------------------------------------
+//-- Initialize
+void
+MavESP8266Recorder::begin()
+{
+    _ready = SPIFFS.begin();
+    if(!_ready) {
+        getWorld()->getLogger()->log("Telemetry log: no file system\n");
+        return;
+    }
+    FSInfo info;
+    SPIFFS.info(info);
+    _segment_size = 0;
+    //-- The parameter cache has its share set aside first
+    uint32_t reserve = TLOG_FLASH_RESERVE + getWorld()->getParamCache()->flashSize();
+    if(info.totalBytes > reserve) {
+        _segment_size = min((uint32_t)((info.totalBytes - reserve) / 2), (uint32_t)TLOG_MAX_SEGMENT);
+        _segment_size &= ~(TLOG_PAGE_SIZE - 1);
+    }
+    if(_segment_size < TLOG_BUFFER_SIZE) {
+        getWorld()->getLogger()->log("Telemetry log: file system too small\n");
+        _ready = false;
+        return;
+    }
+    //-- Which segment was written last?
+    File idx = SPIFFS.open(kTLOG_INDEX, "r");
+    if(idx) {
+        _segment = idx.read() == 1 ? 1 : 0;
+        idx.close();
+    }
+    if(getWorld()->getParameters()->getTlogEnabled()) {
+        start();
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Start recording. The most recent segment (the previous session) is kept and
+//   the older one is reused.
+void
+MavESP8266Recorder::start()
+{
+    if(!_ready || _state != TLOG_STOPPED) {
+        return;
+    }
+    _head = _tail = 0;
+    _switch_pending = false;
+    _openSegment(_segment ^ 1);
+    _seg_bytes   = 0;
+    _budget_used = 0;
+    _budget_time = millis();
+    _state = TLOG_RECORDING;
+    _checkSpace();
+    getWorld()->getLogger()->log("Telemetry log started (%u bytes per segment)\n", _segment_size);
+}
+
+//---------------------------------------------------------------------------------
+//-- Stop recording and write whatever is still buffered
+void
+MavESP8266Recorder::stop()
+{
+    if(_state == TLOG_STOPPED) {
+        return;
+    }
+    while(_head != _tail) {
+        _writePage(TLOG_PAGE_SIZE);
+    }
+    _file.close();
+    _state = TLOG_STOPPED;
+    getWorld()->getLogger()->log("Telemetry log stopped\n");
+}
+
+//---------------------------------------------------------------------------------
+//-- Delete the log
+void
+MavESP8266Recorder::clear()
+{
+    if(!_ready) {
+        return;
+    }
+    bool recording = _state != TLOG_STOPPED;
+    stop();
+    _read_file.close();
+    _read_segment = -1;
+    SPIFFS.remove(kTLOG_SEGMENT[0]);
+    SPIFFS.remove(kTLOG_SEGMENT[1]);
+    if(recording) {
+        start();
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Recorder::setFilter(uint32_t msgid, bool record)
+{
+    if(msgid < 256) {
+        if(record) {
+            _filter[msgid >> 5] |=  (1UL << (msgid & 31));
+        } else {
+            _filter[msgid >> 5] &= ~(1UL << (msgid & 31));
+        }
+        _filtered = false;
+        for(int i = 0; i < 8; i++) {
+            if(_filter[i]) {
+                _filtered = true;
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Recorder::clearFilter()
+{
+    memset(_filter, 0, sizeof(_filter));
+    _filtered = false;
+}
+
+//---------------------------------------------------------------------------------
+//-- Queue a message from the vehicle. Never touches the flash, only the buffer.
+void
+MavESP8266Recorder::record(mavlink_message_t* message)
+{
+    uint32_t msgid = message->msgid;
+    //-- Use the vehicle's clock for the time stamps once we know it
+    if(msgid == MAVLINK_MSG_ID_SYSTEM_TIME) {
+        uint64_t unix_usec = mavlink_msg_system_time_get_time_unix_usec(message);
+        if(unix_usec && !_time_offset) {
+            _time_offset = (int64_t)unix_usec - (int64_t)_timestamp();
+        }
+    }
+    if(_state == TLOG_STOPPED) {
+        return;
+    }
+    if(_filtered && (msgid >= 256 || !(_filter[msgid >> 5] & (1UL << (msgid & 31))))) {
+        return;
+    }
+    if(_state != TLOG_RECORDING) {
+        _dropped++;
+        return;
+    }
+    //-- .tlog record: big endian time stamp (us) followed by the raw frame
+    uint8_t frame[8 + MAVLINK_MAX_PACKET_LEN];
+    uint64_t ts = _timestamp();
+    for(int i = 0; i < 8; i++) {
+        frame[i] = (uint8_t)(ts >> (56 - (i * 8)));
+    }
+    uint32_t len = 8 + mavlink_msg_to_send_buffer(&frame[8], message);
+    if((TLOG_BUFFER_SIZE - (_head - _tail)) < len) {
+        _dropped++;
+        return;
+    }
+    //-- Segments only change on a frame boundary so each one stays readable
+    if(_seg_bytes + len > _segment_size) {
+        if(_switch_pending) {
+            _dropped++;
+            return;
+        }
+        _switch_pending = true;
+        _switch_at      = _head;
+        _seg_bytes      = 0;
+    }
+    for(uint32_t i = 0; i < len; i++) {
+        _buffer[(_head + i) % TLOG_BUFFER_SIZE] = frame[i];
+    }
+    _head      += len;
+    _seg_bytes += len;
+    _frames++;
+}
+
+//---------------------------------------------------------------------------------
+//-- Called once per loop. Writes at most one page, and only full pages unless a
+//   segment switch is pending.
+void
+MavESP8266Recorder::service()
+{
+    if(!_ready || _state == TLOG_STOPPED) {
+        return;
+    }
+    //-- Keep the 64-bit time base going even when nothing is recorded
+    _timestamp();
+    unsigned long now = millis();
+    if(now - _budget_time >= 1000) {
+        _budget_time = now;
+        _budget_used = 0;
+        if(_state == TLOG_PAUSED_BUDGET) {
+            _state = TLOG_RECORDING;
+        }
+    }
+    if(now - _space_time >= TLOG_SPACE_CHECK) {
+        _checkSpace();
+    }
+    uint32_t pending = _head - _tail;
+    if(pending < TLOG_PAGE_SIZE && !_switch_pending) {
+        return;
+    }
+    if(_budget_used + TLOG_PAGE_SIZE > TLOG_WRITE_BUDGET) {
+        if(_state == TLOG_RECORDING) {
+            _state = TLOG_PAUSED_BUDGET;
+        }
+        return;
+    }
+    _writePage(TLOG_PAGE_SIZE);
+}
+
+//---------------------------------------------------------------------------------
+//-- Size of the whole log
+uint32_t
+MavESP8266Recorder::size()
+{
+    if(!_ready) {
+        return 0;
+    }
+    uint32_t total = 0;
+    for(int i = 0; i < 2; i++) {
+        if(_state != TLOG_STOPPED && i == _segment) {
+            total += _file.size();
+        } else {
+            File f = SPIFFS.open(kTLOG_SEGMENT[i], "r");
+            if(f) {
+                total += f.size();
+                f.close();
+            }
+        }
+    }
+    return total;
+}
+
+//---------------------------------------------------------------------------------
+//-- Read from the log as if it was a single file, oldest segment first
+size_t
+MavESP8266Recorder::read(uint32_t offset, uint8_t* buffer, size_t len)
+{
+    if(!_ready) {
+        return 0;
+    }
+    uint8_t segment = _segment ^ 1;
+    uint32_t first  = 0;
+    File f = SPIFFS.open(kTLOG_SEGMENT[segment], "r");
+    if(f) {
+        first = f.size();
+        f.close();
+    }
+    if(offset >= first) {
+        offset -= first;
+        segment = _segment;
+    } else {
+        len = min(len, (size_t)(first - offset));
+    }
+    if(_read_segment != segment) {
+        _read_file.close();
+        _read_file = SPIFFS.open(kTLOG_SEGMENT[segment], "r");
+        _read_segment = _read_file ? segment : -1;
+    }
+    if(_read_segment < 0 || !_read_file.seek(offset, SeekSet)) {
+        return 0;
+    }
+    return _read_file.read(buffer, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- 64-bit time stamp (us). Unix time once the vehicle sent SYSTEM_TIME.
+uint64_t
+MavESP8266Recorder::_timestamp()
+{
+    uint32_t now = micros();
+    if(now < _micros_last) {
+        _micros_high++;
+    }
+    _micros_last = now;
+    return (uint64_t)((((uint64_t)_micros_high << 32) | now) + _time_offset);
+}
+
+//---------------------------------------------------------------------------------
+//-- Move up to len buffered bytes to the flash
+void
+MavESP8266Recorder::_writePage(size_t len)
+{
+    if(_switch_pending) {
+        if(_tail == _switch_at) {
+            _switch_pending = false;
+            _openSegment(_segment ^ 1);
+        } else {
+            len = min(len, (size_t)(_switch_at - _tail));
+        }
+    }
+    len = min(len, (size_t)(_head - _tail));
+    if(!len) {
+        return;
+    }
+    uint8_t page[TLOG_PAGE_SIZE];
+    for(size_t i = 0; i < len; i++) {
+        page[i] = _buffer[(_tail + i) % TLOG_BUFFER_SIZE];
+    }
+    _file.write(page, len);
+    _file.flush();
+    _tail        += len;
+    _written     += len;
+    _budget_used += len;
+}
+
+//---------------------------------------------------------------------------------
+//-- Truncate and open a segment for writing
+void
+MavESP8266Recorder::_openSegment(uint8_t segment)
+{
+    _file.close();
+    if(_read_segment == segment) {
+        _read_file.close();
+        _read_segment = -1;
+    }
+    _segment = segment;
+    _file = SPIFFS.open(kTLOG_SEGMENT[_segment], "w");
+    File idx = SPIFFS.open(kTLOG_INDEX, "w");
+    if(idx) {
+        idx.write(_segment);
+        idx.close();
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Pause while the file system is (nearly) full
+void
+MavESP8266Recorder::_checkSpace()
+{
+    _space_time = millis();
+    FSInfo info;
+    SPIFFS.info(info);
+    bool low = (info.totalBytes - info.usedBytes) < TLOG_FLASH_RESERVE;
+    if(low && _state == TLOG_RECORDING) {
+        _state = TLOG_PAUSED_FLASH;
+        getWorld()->getLogger()->log("Telemetry log paused (flash full)\n");
+    } else if(!low && _state == TLOG_PAUSED_FLASH) {
+        _state = TLOG_RECORDING;
+    }
+}
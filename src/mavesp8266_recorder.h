@@ -0,0 +1,114 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_recorder.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_RECORDER_H
+#define MAVESP8266_RECORDER_H
+
+#include "mavesp8266.h"
+#include <FS.h>
+
+//-- On-board telemetry log (.tlog) written to SPIFFS as two alternating segments
+#define TLOG_PAGE_SIZE          256             // SPIFFS page size. Writes are done one page at a time.
+#define TLOG_BUFFER_SIZE        (TLOG_PAGE_SIZE * 4)
+#define TLOG_MAX_SEGMENT        (512 * 1024)    // Largest segment (the log holds two)
+#define TLOG_FLASH_RESERVE      (16 * 1024)     // Pause recording when less than this is free
+#define TLOG_WRITE_BUDGET       (24 * 1024)     // Bytes written to flash per second at most
+#define TLOG_SPACE_CHECK        5000            // Free space check interval (ms)
+
+class MavESP8266Recorder {
+public:
+    MavESP8266Recorder();
+
+    enum {
+        TLOG_STOPPED = 0,
+        TLOG_RECORDING,
+        TLOG_PAUSED_FLASH,
+        TLOG_PAUSED_BUDGET,
+    };
+
+    void        begin           ();
+    void        start           ();
+    void        stop            ();
+    void        clear           ();
+    void        record          (mavlink_message_t* message);
+    void        service         ();
+    void        setFilter       (uint32_t msgid, bool record);
+    void        clearFilter     ();
+    bool        filtered        () { return _filtered; }
+    //-- Log as a single stream (oldest segment first)
+    uint32_t    size            ();
+    size_t      read            (uint32_t offset, uint8_t* buffer, size_t len);
+    //-- Status
+    uint8_t     state           () { return _state; }
+    uint32_t    framesRecorded  () { return _frames; }
+    uint32_t    framesDropped   () { return _dropped; }
+    uint32_t    bytesWritten    () { return _written; }
+
+private:
+    uint64_t    _timestamp      ();
+    void        _writePage      (size_t len);
+    void        _openSegment    (uint8_t segment);
+    void        _checkSpace     ();
+
+private:
+    bool            _ready;
+    bool            _filtered;
+    uint8_t         _state;
+    uint8_t         _segment;
+    uint32_t        _segment_size;
+    uint32_t        _filter[8];     // msgid < 256 bitmap
+    uint8_t         _buffer[TLOG_BUFFER_SIZE];
+    uint32_t        _head;
+    uint32_t        _tail;
+    uint32_t        _seg_bytes;     // Bytes assigned to the current segment (written or buffered)
+    uint32_t        _switch_at;     // Buffer position where the next segment starts
+    bool            _switch_pending;
+    File            _file;
+    File            _read_file;
+    int8_t          _read_segment;
+    uint32_t        _frames;
+    uint32_t        _dropped;
+    uint32_t        _written;
+    uint32_t        _budget_used;
+    unsigned long   _budget_time;
+    unsigned long   _space_time;
+    uint32_t        _micros_high;
+    uint32_t        _micros_last;
+    int64_t         _time_offset;   // Unix time (us) - time since boot (us), once known
+};
+
+#endif
@@ -0,0 +1,182 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_ring.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266_ring.h"
+
+//---------------------------------------------------------------------------------
+MavESP8266Ring::MavESP8266Ring()
+    : _buffer(NULL)
+    , _size(0)
+    , _head(0)
+    , _tail(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------
+MavESP8266Ring::~MavESP8266Ring()
+{
+    end();
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266Ring::begin(size_t size)
+{
+    end();
+    if(!size || (size & (size - 1))) {
+        return false;
+    }
+    _buffer = (uint8_t*)malloc(size);
+    if(!_buffer) {
+        return false;
+    }
+    _size = size;
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Ring::end()
+{
+    if(_buffer) {
+        free(_buffer);
+    }
+    _buffer = NULL;
+    _size   = 0;
+    clear();
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Ring::clear()
+{
+    _head = _tail = 0;
+}
+
+//---------------------------------------------------------------------------------
+size_t
+MavESP8266Ring::write(const uint8_t* data, size_t len)
+{
+    size_t done = 0;
+    while(done < len) {
+        size_t block;
+        uint8_t* ptr = writePtr(&block);
+        if(!block) {
+            break;
+        }
+        block = min(block, len - done);
+        memcpy(ptr, &data[done], block);
+        commit(block);
+        done += block;
+    }
+    return done;
+}
+
+//---------------------------------------------------------------------------------
+size_t
+MavESP8266Ring::read(uint8_t* data, size_t len)
+{
+    size_t done = 0;
+    while(done < len) {
+        size_t block;
+        const uint8_t* ptr = readPtr(&block);
+        if(!block) {
+            break;
+        }
+        block = min(block, len - done);
+        memcpy(&data[done], ptr, block);
+        consume(block);
+        done += block;
+    }
+    return done;
+}
+
+//---------------------------------------------------------------------------------
+size_t
+MavESP8266Ring::peek(size_t offset, uint8_t* data, size_t len)
+{
+    if(!_buffer || offset >= available()) {
+        return 0;
+    }
+    len = min(len, available() - offset);
+    size_t start = (_tail + offset) & (_size - 1);
+    size_t first = min(len, _size - start);
+    memcpy(data, &_buffer[start], first);
+    memcpy(&data[first], _buffer, len - first);
+    return len;
+}
+
+//---------------------------------------------------------------------------------
+uint8_t*
+MavESP8266Ring::writePtr(size_t* len)
+{
+    if(!_buffer) {
+        *len = 0;
+        return NULL;
+    }
+    size_t offset = _head & (_size - 1);
+    *len = min(space(), _size - offset);
+    return &_buffer[offset];
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Ring::commit(size_t len)
+{
+    _head += len;
+}
+
+//---------------------------------------------------------------------------------
+const uint8_t*
+MavESP8266Ring::readPtr(size_t* len)
+{
+    if(!_buffer) {
+        *len = 0;
+        return NULL;
+    }
+    size_t offset = _tail & (_size - 1);
+    *len = min(available(), _size - offset);
+    return &_buffer[offset];
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Ring::consume(size_t len)
+{
+    _tail += len;
+}
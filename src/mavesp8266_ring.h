@@ -0,0 +1,71 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_ring.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_RING_H
+#define MAVESP8266_RING_H
+
+#include <Arduino.h>
+
+//---------------------------------------------------------------------------------
+//-- Byte ring buffer. Safe for one producer and one consumer without locking
+//   as each index is only ever written by one side.
+class MavESP8266Ring {
+public:
+    MavESP8266Ring  ();
+    ~MavESP8266Ring ();
+    bool            begin       (size_t size); // Allocate (size must be a power of two)
+    void            end         (); // Release the memory
+    void            clear       ();
+    size_t          size        () { return _size; }
+    size_t          available   () { return _head - _tail; }
+    size_t          space       () { return _size - (_head - _tail); }
+    size_t          write       (const uint8_t* data, size_t len);
+    size_t          read        (uint8_t* data, size_t len);
+    size_t          peek        (size_t offset, uint8_t* data, size_t len); // Copy without consuming
+    //-- Zero copy access. Each returns the largest contiguous block.
+    uint8_t*        writePtr    (size_t* len);
+    void            commit      (size_t len);
+    const uint8_t*  readPtr     (size_t* len);
+    void            consume     (size_t len);
+private:
+    uint8_t*            _buffer;
+    size_t              _size;
+    volatile uint32_t   _head; // Free running. Only the producer moves it.
+    volatile uint32_t   _tail; // Free running. Only the consumer moves it.
+};
+
+#endif
@@ -0,0 +1,186 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_scheduler.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_scheduler.h"
+
+//---------------------------------------------------------------------------------
+MavESP8266Scheduler::MavESP8266Scheduler()
+    : _count(0)
+    , _passes(0)
+    , _max_pass(0)
+    , _stats_time(0)
+{
+    memset(_tasks, 0, sizeof(_tasks));
+}
+
+//---------------------------------------------------------------------------------
+//-- Tasks are kept in priority order (in order added within a priority)
+bool
+MavESP8266Scheduler::add(const char* name, uint8_t priority, uint32_t period, uint32_t budget, taskFunction function)
+{
+    if(_count >= SCHEDULER_MAX_TASKS) {
+        getWorld()->getLogger()->log("Scheduler: no room for task %s\n", name);
+        return false;
+    }
+    int i = _count;
+    while(i > 0 && _tasks[i - 1].priority > priority) {
+        _tasks[i] = _tasks[i - 1];
+        i--;
+    }
+    memset(&_tasks[i], 0, sizeof(taskStatus));
+    _tasks[i].name      = name;
+    _tasks[i].function  = function;
+    _tasks[i].priority  = priority;
+    _tasks[i].period    = period;
+    _tasks[i].budget    = budget;
+    _tasks[i].last_run  = micros() - period;
+    _count++;
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Scheduler::run()
+{
+    unsigned long start = micros();
+    //-- Data path
+    int i = 0;
+    for(; i < _count && _tasks[i].priority == TASK_PRIORITY_DATA; i++) {
+        if(_due(&_tasks[i], micros())) {
+            _run(&_tasks[i]);
+        }
+    }
+    //-- Anything kept waiting too long goes first
+    unsigned long passStart = micros();
+    taskStatus* starved = NULL;
+    for(int j = i; j < _count; j++) {
+        taskStatus* task = &_tasks[j];
+        if(_due(task, passStart) && (passStart - task->last_run) > task->period + SCHEDULER_MAX_WAIT) {
+            _run(task);
+            starved = task;
+            break;
+        }
+    }
+    bool ran = starved != NULL;
+    //-- Background tasks while the pass budget lasts
+    for(; i < _count; i++) {
+        taskStatus* task = &_tasks[i];
+        //-- Once per pass (tasks run every pass are always due)
+        if(task == starved || !_due(task, micros())) {
+            continue;
+        }
+        if(ran && (micros() - passStart) > SCHEDULER_PASS_BUDGET) {
+            task->deferred++;
+            continue;
+        }
+        _run(task);
+        ran = true;
+    }
+    uint32_t passTime = micros() - start;
+    if(passTime > _max_pass) {
+        _max_pass = passTime;
+    }
+    _passes++;
+    _updateLoad();
+}
+
+//---------------------------------------------------------------------------------
+unsigned long
+MavESP8266Scheduler::idleTime()
+{
+    unsigned long idle = ~0UL;
+    unsigned long now  = micros();
+    for(int i = 0; i < _count; i++) {
+        taskStatus* task = &_tasks[i];
+        if(task->pending) {
+            return 0;
+        }
+        if(task->period) {
+            unsigned long elapsed = now - task->last_run;
+            idle = min(idle, elapsed < task->period ? task->period - elapsed : 0);
+        }
+    }
+    return idle;
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266Scheduler::_due(taskStatus* task, unsigned long now)
+{
+    return task->pending || !task->period || (now - task->last_run) >= task->period;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Scheduler::_run(taskStatus* task)
+{
+    unsigned long start = micros();
+    //-- Periodic tasks keep their phase (unless they fell behind or ran early)
+    unsigned long since = start - task->last_run;
+    if(task->period && since >= task->period && since < task->period * 2) {
+        task->last_run += task->period;
+    } else {
+        task->last_run = start;
+    }
+    task->pending = task->function(task->budget);
+    uint32_t elapsed = micros() - start;
+    task->runs++;
+    task->total_time  += elapsed;
+    task->window_time += elapsed;
+    if(elapsed > task->max_time) {
+        task->max_time = elapsed;
+    }
+    if(task->budget && elapsed > task->budget) {
+        task->overruns++;
+    }
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Scheduler::_updateLoad()
+{
+    unsigned long elapsed = micros() - _stats_time;
+    if(elapsed < SCHEDULER_STATS_PERIOD) {
+        return;
+    }
+    for(int i = 0; i < _count; i++) {
+        _tasks[i].load        = min((_tasks[i].window_time * 100) / elapsed, 100UL);
+        _tasks[i].window_time = 0;
+    }
+    _stats_time = micros();
+}
@@ -0,0 +1,104 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_scheduler.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_SCHEDULER_H
+#define MAVESP8266_SCHEDULER_H
+
+#include "mavesp8266.h"
+
+#define SCHEDULER_MAX_TASKS     12
+#define SCHEDULER_PASS_BUDGET   2000    // Time (us) background tasks may add to a pass
+#define SCHEDULER_MAX_WAIT      100000  // A due task waiting this long (us) goes first
+#define SCHEDULER_STATS_PERIOD  1000000 // Load is measured over this period (us)
+
+//-- Task priorities. Data path tasks run on every pass. The others run in order of
+//   priority for as long as the pass budget lasts (at least one per pass).
+enum {
+    TASK_PRIORITY_DATA = 0,
+    TASK_PRIORITY_HIGH,
+    TASK_PRIORITY_NORMAL,
+    TASK_PRIORITY_LOW,
+};
+
+//-- A task is given its budget (us) and returns true if it has more work right away
+typedef bool (*taskFunction)(uint32_t budget);
+
+struct taskStatus {
+    const char*     name;
+    taskFunction    function;
+    uint8_t         priority;
+    uint32_t        period;         // Run at most this often (us). 0 for every pass.
+    uint32_t        budget;         // Expected longest run (us)
+    uint32_t        runs;
+    uint32_t        overruns;       // Runs that took longer than the budget
+    uint32_t        deferred;       // Passes it was due but the pass budget ran out
+    uint32_t        max_time;       // Longest run (us)
+    uint32_t        total_time;     // Time spent running (us), since boot (wraps)
+    uint8_t         load;           // Percent of the time spent running over the last period
+    //-- Bookkeeping
+    bool            pending;        // Asked to run again right away
+    unsigned long   last_run;       // When it last started (us)
+    uint32_t        window_time;
+};
+
+class MavESP8266Scheduler {
+public:
+    MavESP8266Scheduler();
+
+    bool            add             (const char* name, uint8_t priority, uint32_t period, uint32_t budget, taskFunction function);
+    void            run             (); // One pass
+    unsigned long   idleTime        (); // How long (us) until a task is due
+    //-- Status
+    int             taskCount       () { return _count; }
+    taskStatus*     getTask         (int index) { return index >= 0 && index < _count ? &_tasks[index] : NULL; }
+    uint32_t        passes          () { return _passes; }
+    uint32_t        maxPassTime     () { return _max_pass; }
+
+private:
+    bool            _due            (taskStatus* task, unsigned long now);
+    void            _run            (taskStatus* task);
+    void            _updateLoad     ();
+
+private:
+    taskStatus      _tasks[SCHEDULER_MAX_TASKS];
+    int             _count;
+    uint32_t        _passes;
+    uint32_t        _max_pass;
+    unsigned long   _stats_time;
+};
+
+#endif
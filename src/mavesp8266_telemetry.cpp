@@ -0,0 +1,129 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_telemetry.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_telemetry.h"
+#include "mavesp8266_parameters.h"
+#include "mavesp8266_vehicle.h"
+
+//---------------------------------------------------------------------------------
+MavESP8266Telemetry::MavESP8266Telemetry()
+    : _version(0)
+{
+    memset(&_heartbeat,           0, sizeof(_heartbeat));
+    memset(&_sys_status,          0, sizeof(_sys_status));
+    memset(&_gps_raw_int,         0, sizeof(_gps_raw_int));
+    memset(&_global_position_int, 0, sizeof(_global_position_int));
+    memset(&_battery_status,      0, sizeof(_battery_status));
+    memset(_time, 0, sizeof(_time));
+}
+
+//---------------------------------------------------------------------------------
+//-- Only a change bumps the version, so a client polling an idle vehicle keeps
+//   getting 304s. The first skip bytes (a timestamp, not served) don't count.
+void
+MavESP8266Telemetry::_update(int which, void* value, const void* decoded, size_t len, size_t skip)
+{
+    bool same = _time[which] && !memcmp((uint8_t*)value + skip, (const uint8_t*)decoded + skip, len - skip);
+    memcpy(value, decoded, len);
+    if(!same) {
+        _time[which] = millis() | 1;
+        _version++;
+    }
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266Telemetry::vehicleMessage(mavlink_message_t* message)
+{
+    int which;
+    switch(message->msgid) {
+        case MAVLINK_MSG_ID_HEARTBEAT:              which = TELEM_HEARTBEAT;            break;
+        case MAVLINK_MSG_ID_SYS_STATUS:             which = TELEM_SYS_STATUS;           break;
+        case MAVLINK_MSG_ID_GPS_RAW_INT:            which = TELEM_GPS_RAW_INT;          break;
+        case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:    which = TELEM_GLOBAL_POSITION_INT;  break;
+        case MAVLINK_MSG_ID_BATTERY_STATUS:         which = TELEM_BATTERY_STATUS;       break;
+        default:
+            return false;
+    }
+    if(!(getWorld()->getParameters()->getTelemCache() & (1UL << which))) {
+        return false;
+    }
+    //-- The autopilot only (not a camera or gimbal heartbeat)
+    MavESP8266Vehicle* vehicle = getWorld()->getVehicle();
+    if(message->sysid != vehicle->systemID() || message->compid != vehicle->componentID()) {
+        return false;
+    }
+    switch(which) {
+        case TELEM_HEARTBEAT: {
+            mavlink_heartbeat_t decoded;
+            memset(&decoded, 0, sizeof(decoded));
+            mavlink_msg_heartbeat_decode(message, &decoded);
+            _update(which, &_heartbeat, &decoded, sizeof(decoded), 0);
+            break;
+        }
+        case TELEM_SYS_STATUS: {
+            mavlink_sys_status_t decoded;
+            memset(&decoded, 0, sizeof(decoded));
+            mavlink_msg_sys_status_decode(message, &decoded);
+            _update(which, &_sys_status, &decoded, sizeof(decoded), 0);
+            break;
+        }
+        case TELEM_GPS_RAW_INT: {
+            mavlink_gps_raw_int_t decoded;
+            memset(&decoded, 0, sizeof(decoded));
+            mavlink_msg_gps_raw_int_decode(message, &decoded);
+            _update(which, &_gps_raw_int, &decoded, sizeof(decoded), sizeof(decoded.time_usec));
+            break;
+        }
+        case TELEM_GLOBAL_POSITION_INT: {
+            mavlink_global_position_int_t decoded;
+            memset(&decoded, 0, sizeof(decoded));
+            mavlink_msg_global_position_int_decode(message, &decoded);
+            _update(which, &_global_position_int, &decoded, sizeof(decoded), sizeof(decoded.time_boot_ms));
+            break;
+        }
+        case TELEM_BATTERY_STATUS: {
+            mavlink_battery_status_t decoded;
+            memset(&decoded, 0, sizeof(decoded));
+            mavlink_msg_battery_status_decode(message, &decoded);
+            _update(which, &_battery_status, &decoded, sizeof(decoded), 0);
+            break;
+        }
+    }
+    return false;
+}
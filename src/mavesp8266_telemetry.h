@@ -0,0 +1,83 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_telemetry.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_TELEMETRY_H
+#define MAVESP8266_TELEMETRY_H
+
+#include "mavesp8266.h"
+
+//-- The last value of a few autopilot messages, for clients that don't speak
+//   MAVLink (see /telemetry.json). TELEM_CACHE picks which, one bit each.
+enum {
+    TELEM_HEARTBEAT,
+    TELEM_SYS_STATUS,
+    TELEM_GPS_RAW_INT,
+    TELEM_GLOBAL_POSITION_INT,
+    TELEM_BATTERY_STATUS,
+    TELEM_COUNT
+};
+
+class MavESP8266Telemetry {
+public:
+    MavESP8266Telemetry();
+
+    //-- Never handles the message, only keeps a copy
+    bool        vehicleMessage  (mavlink_message_t* message);
+    //-- Bumped whenever one of the values changes
+    uint32_t    version         () { return _version; }
+    //-- millis() when it last changed, 0 if never seen
+    uint32_t    changed         (int which) { return _time[which]; }
+    const mavlink_heartbeat_t*              heartbeat           () { return &_heartbeat; }
+    const mavlink_sys_status_t*             sysStatus           () { return &_sys_status; }
+    const mavlink_gps_raw_int_t*            gpsRawInt           () { return &_gps_raw_int; }
+    const mavlink_global_position_int_t*    globalPositionInt   () { return &_global_position_int; }
+    const mavlink_battery_status_t*         batteryStatus       () { return &_battery_status; }
+
+private:
+    void        _update         (int which, void* value, const void* decoded, size_t len, size_t skip);
+
+private:
+    mavlink_heartbeat_t             _heartbeat;
+    mavlink_sys_status_t            _sys_status;
+    mavlink_gps_raw_int_t           _gps_raw_int;
+    mavlink_global_position_int_t   _global_position_int;
+    mavlink_battery_status_t        _battery_status;
+    uint32_t                        _time[TELEM_COUNT];
+    uint32_t                        _version;
+};
+
+#endif
@@ -0,0 +1,320 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_udp.cpp
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include "mavesp8266.h"
+#include "mavesp8266_udp.h"
+#include "mavesp8266_events.h"
+
+extern "C" {
+#include "lwip/udp.h"
+#include "netif/etharp.h"
+}
+
+//-- Queued ahead of each datagram
+struct udpHeader {
+    uint16_t    len;
+    uint16_t    port;
+    uint32_t    ip;
+};
+
+//---------------------------------------------------------------------------------
+//-- Runs in the network stack context, never at the same time as loop()
+#if LWIP_VERSION_MAJOR == 1
+static void
+udp_received(void* arg, struct udp_pcb* pcb, struct pbuf* p, ip_addr_t* addr, u16_t port)
+{
+    ((MavESP8266Udp*)arg)->received(p, addr->addr, port);
+}
+#else
+static void
+udp_received(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port)
+{
+    ((MavESP8266Udp*)arg)->received(p, ip4_addr_get_u32(ip_2_ip4(addr)), port);
+}
+#endif
+
+//---------------------------------------------------------------------------------
+MavESP8266Udp::MavESP8266Udp()
+    : _pcb(NULL)
+    , _rx_left(0)
+    , _remote_ip(0)
+    , _remote_port(0)
+    , _dropped(0)
+    , _tx_pbuf(NULL)
+    , _tx_len(0)
+    , _tx_ip(0)
+    , _tx_port(0)
+{
+    memset(&_failures, 0, sizeof(_failures));
+}
+
+//---------------------------------------------------------------------------------
+bool
+MavESP8266Udp::begin(uint16_t port)
+{
+    stop();
+    if(!_rx.begin(UDP_RX_BUFFER_SIZE)) {
+        return false;
+    }
+    _pcb = udp_new();
+    if(!_pcb) {
+        return false;
+    }
+    ip_set_option(_pcb, SOF_BROADCAST);
+    if(udp_bind(_pcb, IP_ADDR_ANY, port) != ERR_OK) {
+        stop();
+        return false;
+    }
+    udp_recv(_pcb, udp_received, this);
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Udp::stop()
+{
+    if(_pcb) {
+        udp_recv(_pcb, NULL, NULL);
+        udp_remove(_pcb);
+        _pcb = NULL;
+    }
+    _rx.end();
+    _rx_left = 0;
+    discard();
+}
+
+//---------------------------------------------------------------------------------
+//-- Queue the datagram whole, or drop it if it does not fit
+void
+MavESP8266Udp::received(struct pbuf* p, uint32_t ip, uint16_t port)
+{
+    if(p->tot_len <= RAW_MAX_DATAGRAM && _rx.space() >= sizeof(udpHeader) + p->tot_len) {
+        udpHeader header;
+        header.len  = p->tot_len;
+        header.port = port;
+        header.ip   = ip;
+        _rx.write((uint8_t*)&header, sizeof(header));
+        for(struct pbuf* q = p; q; q = q->next) {
+            _rx.write((uint8_t*)q->payload, q->len);
+        }
+        MavESP8266Events::signal();
+    } else {
+        _dropped++;
+    }
+    pbuf_free(p);
+}
+
+//---------------------------------------------------------------------------------
+int
+MavESP8266Udp::parsePacket()
+{
+    //-- Skip what was not read of the previous datagram
+    while(_rx_left) {
+        size_t block;
+        _rx.readPtr(&block);
+        block = min(block, (size_t)_rx_left);
+        _rx.consume(block);
+        _rx_left -= block;
+    }
+    if(!_rx.available()) {
+        return 0;
+    }
+    udpHeader header;
+    _rx.read((uint8_t*)&header, sizeof(header));
+    _rx_left     = header.len;
+    _remote_ip   = header.ip;
+    _remote_port = header.port;
+    return _rx_left;
+}
+
+//---------------------------------------------------------------------------------
+int
+MavESP8266Udp::read()
+{
+    uint8_t c;
+    if(!_rx_left || !_rx.read(&c, 1)) {
+        return -1;
+    }
+    _rx_left--;
+    return c;
+}
+
+//---------------------------------------------------------------------------------
+int
+MavESP8266Udp::read(uint8_t* buffer, size_t len)
+{
+    len = _rx.read(buffer, min(len, (size_t)_rx_left));
+    _rx_left -= len;
+    return len;
+}
+
+//---------------------------------------------------------------------------------
+//-- Allocate the pbuf up front so running out of them is known before anything
+//   is serialized
+int
+MavESP8266Udp::beginPacket(IPAddress ip, uint16_t port)
+{
+    discard();
+    _tx_ip   = (uint32_t)ip;
+    _tx_port = port;
+    _tx_pbuf = pbuf_alloc(PBUF_TRANSPORT, UDP_TX_BUFFER_SIZE, PBUF_RAM);
+    if(!_tx_pbuf) {
+        _failures.no_pbuf++;
+        return UDP_WOULD_BLOCK;
+    }
+    return UDP_SEND_OK;
+}
+
+//---------------------------------------------------------------------------------
+uint8_t*
+MavESP8266Udp::reserve(size_t len)
+{
+    if(len > room()) {
+        return NULL;
+    }
+    return (uint8_t*)_tx_pbuf->payload + _tx_len;
+}
+
+//---------------------------------------------------------------------------------
+size_t
+MavESP8266Udp::write(const uint8_t* buffer, size_t len)
+{
+    if(len > room()) {
+        _failures.short_write++;
+        len = room();
+    }
+    if(len) {
+        memcpy(reserve(len), buffer, len);
+        commit(len);
+    }
+    return len;
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Udp::discard()
+{
+    if(_tx_pbuf) {
+        pbuf_free(_tx_pbuf);
+        _tx_pbuf = NULL;
+    }
+    _tx_len = 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- A unicast destination with no complete ARP entry
+static bool
+arp_pending(uint32_t ip)
+{
+    struct eth_addr* eth;
+#if LWIP_VERSION_MAJOR == 1
+    ip_addr_t addr;
+    ip_addr_t* found;
+    addr.addr = ip;
+#else
+    ip4_addr_t addr;
+    const ip4_addr_t* found;
+    ip4_addr_set_u32(&addr, ip);
+#endif
+    if((ip >> 24) == 255) {
+        return false;
+    }
+    return etharp_find_addr(NULL, &addr, &eth, &found) < 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- Running out of memory is worth another try later, anything else is not
+int
+MavESP8266Udp::_send(struct pbuf* p, uint32_t ip, uint16_t port)
+{
+    ip_addr_t dest;
+#if LWIP_VERSION_MAJOR == 1
+    dest.addr = ip;
+#else
+    ip_addr_set_ip4_u32(&dest, ip);
+#endif
+    err_t err = udp_sendto(_pcb, p, &dest, port);
+    if(err == ERR_OK) {
+        return UDP_SEND_OK;
+    }
+    if(err == ERR_MEM || err == ERR_BUF) {
+        //-- lwIP holds one datagram per unresolved address and refuses the rest
+        if(arp_pending(ip)) {
+            _failures.arp_pending++;
+        } else {
+            _failures.stack_full++;
+        }
+        return UDP_WOULD_BLOCK;
+    }
+    _failures.errors++;
+    return UDP_SEND_ERROR;
+}
+
+//---------------------------------------------------------------------------------
+//-- The pbuf is handed to the stack as is and is not ours anymore once sent
+int
+MavESP8266Udp::endPacket()
+{
+    if(!_pcb || !_tx_pbuf || !_tx_len) {
+        discard();
+        return UDP_SEND_ERROR;
+    }
+    pbuf_realloc(_tx_pbuf, _tx_len);
+    int res = _send(_tx_pbuf, _tx_ip, _tx_port);
+    discard();
+    return res;
+}
+
+//---------------------------------------------------------------------------------
+//-- For sending the same datagram to several hosts. The stack may still hold on
+//   to a pbuf after udp_sendto() returns, so each one gets its own.
+int
+MavESP8266Udp::sendTo(IPAddress ip, uint16_t port)
+{
+    if(!_pcb || !_tx_pbuf || !_tx_len) {
+        return UDP_SEND_ERROR;
+    }
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, _tx_len, PBUF_RAM);
+    if(!p) {
+        _failures.no_pbuf++;
+        return UDP_WOULD_BLOCK;
+    }
+    memcpy(p->payload, _tx_pbuf->payload, _tx_len);
+    int res = _send(p, (uint32_t)ip, port);
+    pbuf_free(p);
+    return res;
+}
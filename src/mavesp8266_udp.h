@@ -0,0 +1,114 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavesp8266_udp.h
+ * ESP8266 Wifi AP, MavLink UART/UDP Bridge
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_UDP_H
+#define MAVESP8266_UDP_H
+
+#include "mavesp8266.h"
+
+#define UDP_RX_BUFFER_SIZE      2048                // Received datagrams waiting to be read (power of two)
+#define UDP_TX_BUFFER_SIZE      RAW_MAX_DATAGRAM    // Largest datagram we send (no IP fragmentation)
+
+//-- beginPacket() / endPacket() / sendTo()
+#define UDP_SEND_ERROR          0
+#define UDP_SEND_OK             1
+#define UDP_WOULD_BLOCK         -1                  // Out of packet buffers. Try again on a later pass.
+
+struct pbuf;
+struct udp_pcb;
+
+//-- Why datagrams did not go out
+struct udpSendFailures {
+    uint32_t    no_pbuf;        // No packet buffer to build it in
+    uint32_t    stack_full;     // The stack was out of memory
+    uint32_t    arp_pending;    // Same, while the destination MAC address was still being resolved
+    uint32_t    short_write;    // write() had less room than it was given
+    uint32_t    errors;         // Anything else (no route, interface down)
+};
+
+//---------------------------------------------------------------------------------
+//-- UDP socket on a raw lwIP PCB. The network stack hands datagrams to a callback
+//   that queues them in a ring and wakes the main loop, so nothing needs polling.
+//   The rest follows WiFiUDP.
+class MavESP8266Udp {
+public:
+    MavESP8266Udp();
+
+    bool        begin       (uint16_t port);
+    void        stop        ();
+    //-- Receive
+    bool        pending     () { return _rx.available() > 0; } // A datagram is waiting
+    int         parsePacket (); // Start on the next datagram (drops what is left of the current one)
+    int         available   () { return _rx_left; }
+    int         read        ();
+    int         read        (uint8_t* buffer, size_t len);
+    IPAddress   remoteIP    () { return IPAddress(_remote_ip); }
+    uint16_t    remotePort  () { return _remote_port; }
+    uint32_t    dropped     () { return _dropped; }
+    //-- Send. The datagram is built in the pbuf that goes out: reserve() space,
+    //   serialize into it and commit() what was used.
+    int         beginPacket (IPAddress ip, uint16_t port);
+    size_t      room        () { return _tx_pbuf ? UDP_TX_BUFFER_SIZE - _tx_len : 0; }
+    uint8_t*    reserve     (size_t len);
+    void        commit      (size_t len) { _tx_len += len; }
+    size_t      write       (const uint8_t* buffer, size_t len);
+    size_t      length      () { return _tx_len; }
+    void        discard     ();
+    int         sendTo      (IPAddress ip, uint16_t port); // Send a copy of what was written so far
+    int         endPacket   ();
+    uint32_t    blocked     () { return _failures.no_pbuf + _failures.stack_full + _failures.arp_pending; }
+    udpSendFailures* failures() { return &_failures; }
+    //-- Called by the network stack
+    void        received    (struct pbuf* p, uint32_t ip, uint16_t port);
+
+private:
+    struct udp_pcb*     _pcb;
+    MavESP8266Ring      _rx;
+    uint16_t            _rx_left;   // Bytes of the current datagram not read yet
+    uint32_t            _remote_ip;
+    uint16_t            _remote_port;
+    uint32_t            _dropped;
+    struct pbuf*        _tx_pbuf;
+    uint16_t            _tx_len;
+    uint32_t            _tx_ip;
+    uint16_t            _tx_port;
+    udpSendFailures     _failures;
+
+    int         _send       (struct pbuf* p, uint32_t ip, uint16_t port);
+};
+
+#endif
@@ -39,12 +39,37 @@
 #include "mavesp8266_vehicle.h"
 #include "mavesp8266_parameters.h"
 #include "mavesp8266_component.h"
+#include "mavesp8266_recorder.h"
+#include "mavesp8266_events.h"
+
+//-- Rates tried when detecting the vehicle's baud rate (after the configured one)
+static const uint32_t kBaudRates[] = {921600, 57600, 115200, 460800, 230400, 1500000, 500000, 38400};
+#define BAUD_RATE_COUNT (sizeof(kBaudRates) / sizeof(uint32_t))
 
 //---------------------------------------------------------------------------------
 MavESP8266Vehicle::MavESP8266Vehicle()
     : _queue_count(0)
     , _queue_time(0)
     , _buffer_status(50.0)
+    , _raw_time(0)
+    , _raw_flush_time(0)
+    , _flow_control(false)
+    , _rx_high(0)
+    , _rx_low(0)
+    , _baud_detect(false)
+    , _baud_index(0)
+    , _baud_best(-1)
+    , _baud_score(0)
+    , _baud_best_score(0)
+    , _baud_time(0)
+    , _tx_current(NULL)
+    , _tx_left(0)
+    , _tx_stamp(0)
+    , _tx_peak(0)
+    , _tx_dropped(0)
+    , _tx_stalled(false)
+    , _tx_stall_start(0)
+    , _tx_stall_time(0)
 {
     memset(_message, 0 , sizeof(_message));
 }
@@ -55,40 +80,248 @@ void
 MavESP8266Vehicle::begin(MavESP8266Bridge* forwardTo)
 {
     MavESP8266Bridge::begin(forwardTo);
+    _tx.begin(UAS_TX_BUFFER_SIZE);
+    _tx_priority.begin(UAS_TX_PRIORITY_SIZE);
     //-- Start UART connected to UAS
     Serial.begin(getWorld()->getParameters()->getUartBaudRate());
+    //-- Enough buffer to ride out WiFi stalls. Resized once the UART is up, so
+    //   if there isn't the RAM for it the UART keeps its default buffer.
+    int rxBuffer = Serial.setRxBufferSize(getWorld()->getParameters()->getUartRxBuffer());
+    if(rxBuffer < UART_RXBUF_MIN) {
+        rxBuffer = UART_RXBUF_MIN;
+    }
+    if(rxBuffer != getWorld()->getParameters()->getUartRxBuffer()) {
+        getWorld()->getLogger()->log("UART: %d byte receive buffer (UART_RXBUF not available)\n", rxBuffer);
+    }
     //-- Swap to TXD2/RXD2 (GPIO015/GPIO013) For ESP12 Only
 #ifdef ENABLE_DEBUG
 #ifdef ARDUINO_ESP8266_ESP12
     Serial.swap();
 #endif
+#else
+    if(getWorld()->getParameters()->getUartFlowControl()) {
+        //-- From the buffer actually in use
+        _rx_high = (rxBuffer * 3) / 4;
+        _rx_low  = rxBuffer / 2;
+        _enableFlowControl();
+    }
 #endif
+    _startBaudDetect();
+}
+
+//---------------------------------------------------------------------------------
+//-- RTS/CTS on UART0 (CTS: GPIO13, RTS: GPIO15)
+void
+MavESP8266Vehicle::_enableFlowControl()
+{
+    pinMode(UART_CTS_PIN, FUNCTION_4);
+    pinMode(UART_RTS_PIN, FUNCTION_4);
+    //-- Hold our TX while the vehicle raises CTS
+    USC0(0) |= (1 << UCTXHFE);
+    //-- Raise RTS once the RX FIFO fills up to the threshold
+    USC1(0) = (USC1(0) & ~(0x7F << UCRXHFT)) | (UART_RTS_THRESHOLD << UCRXHFT) | (1 << UCRXHFE);
+    _flow_control = true;
+    getWorld()->getLogger()->log("UART flow control enabled\n");
+}
+
+//---------------------------------------------------------------------------------
+//-- How long (us) we can go without being serviced
+unsigned long
+MavESP8266Vehicle::idleTime()
+{
+    if(Serial.available()) {
+        return 0;
+    }
+    unsigned long elapsed;
+    //-- Uplink waiting for room in the TX FIFO. Come back when half of it went out.
+    if(_txPending()) {
+        return ((UART_TX_FIFO_SIZE / 2) * 10 * 1000000UL) / Serial.baudRate();
+    }
+    //-- Raw mode burst waiting for the UART to go quiet
+    if(_raw.available()) {
+        elapsed = micros() - _raw_time;
+        return elapsed < _raw_flush_time ? _raw_flush_time - elapsed : 0;
+    }
+    //-- Messages waiting for the queue timeout
+    if(_queue_count) {
+        elapsed = micros() - _queue_time;
+        return elapsed < UAS_QUEUE_TIMEOUT ? UAS_QUEUE_TIMEOUT - elapsed : 0;
+    }
+    return EVENT_MAX_SLEEP * 1000UL;
+}
+
+//---------------------------------------------------------------------------------
+uint8_t
+MavESP8266Vehicle::rxPin()
+{
+#if defined(ENABLE_DEBUG) && defined(ARDUINO_ESP8266_ESP12)
+    return UART_RX_SWAPPED_PIN;
+#else
+    return UART_RX_PIN;
+#endif
+}
+
+//---------------------------------------------------------------------------------
+//-- Listen at each candidate rate in turn, starting with the configured one
+void
+MavESP8266Vehicle::_startBaudDetect()
+{
+    if(getWorld()->getParameters()->getUartAutobaud() == UART_AUTOBAUD_OFF) {
+        return;
+    }
+    _baud_detect     = true;
+    _baud_index      = -1;
+    _baud_best       = -1;
+    _baud_best_score = 0;
+    _setBaudRate(getWorld()->getParameters()->getUartBaudRate());
+    getWorld()->getLogger()->log("Detecting vehicle baud rate\n");
+}
+
+//---------------------------------------------------------------------------------
+void
+MavESP8266Vehicle::_checkBaudDetect()
+{
+    uint32_t baud = _baud_index < 0 ? getWorld()->getParameters()->getUartBaudRate() : kBaudRates[_baud_index];
+    if(_baud_score < BAUD_DETECT_LOCK && (millis() - _baud_time) < BAUD_DETECT_WINDOW) {
+        return;
+    }
+    if(_baud_score > _baud_best_score) {
+        _baud_best       = _baud_index;
+        _baud_best_score = _baud_score;
+    }
+    //-- Move on to the next rate (skipping the configured one, already tried)
+    if(_baud_score < BAUD_DETECT_LOCK) {
+        int next = _baud_index + 1;
+        while(next < (int)BAUD_RATE_COUNT && kBaudRates[next] == getWorld()->getParameters()->getUartBaudRate()) {
+            next++;
+        }
+        if(next < (int)BAUD_RATE_COUNT) {
+            _baud_index = next;
+            _setBaudRate(kBaudRates[next]);
+            return;
+        }
+        //-- Went through them all. Nothing at all? Go around again.
+        if(!_baud_best_score) {
+            _baud_index = -1;
+            _setBaudRate(getWorld()->getParameters()->getUartBaudRate());
+            return;
+        }
+        baud = _baud_best < 0 ? getWorld()->getParameters()->getUartBaudRate() : kBaudRates[_baud_best];
+        _setBaudRate(baud);
+    }
+    //-- Lock
+    _baud_detect = false;
+    getWorld()->getLogger()->log("Vehicle baud rate: %u\n", baud);
+    if(baud != getWorld()->getParameters()->getUartBaudRate()) {
+        getWorld()->getParameters()->setUartBaudRate(baud);
+        if(getWorld()->getParameters()->getUartAutobaud() == UART_AUTOBAUD_PERSIST) {
+            getWorld()->getParameters()->saveAllToEeprom();
+        }
+    }
 }
 
 //---------------------------------------------------------------------------------
-//-- Read MavLink message from UAS
 void
-MavESP8266Vehicle::readMessage()
+MavESP8266Vehicle::_setBaudRate(uint32_t baud)
 {
-    if(_queue_count < UAS_QUEUE_SIZE) {
-        if(_readMessage()) {
+    Serial.updateBaudRate(baud);
+    //-- Whatever came in at the previous rate is garbage
+    while(Serial.available()) {
+        Serial.read();
+    }
+    _baud_score = 0;
+    _baud_time  = millis();
+}
+
+//---------------------------------------------------------------------------------
+//-- Count UART errors and, with flow control, stop the RX interrupt while our
+//   buffer is nearly full. The core would otherwise keep moving bytes out of
+//   the FIFO (dropping them once the buffer is full) and RTS would never rise.
+void
+MavESP8266Vehicle::_checkUart()
+{
+    if(Serial.hasOverrun()) {
+        _status.uart_overruns++;
+    }
+    if(Serial.hasRxError()) {
+        _status.uart_errors++;
+    }
+    if(_flow_control) {
+        int available = Serial.available();
+        if(available > _rx_high) {
+            USIE(0) &= ~((1 << UIFF) | (1 << UITO));
+        } else if(available < _rx_low) {
+            USIE(0) |= (1 << UIFF) | (1 << UITO);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Read MavLink messages from UAS for up to budget us
+void
+MavESP8266Vehicle::readMessage(uint32_t budget)
+{
+    _checkUart();
+    if(_baud_detect) {
+        _checkBaudDetect();
+    }
+    unsigned long start = micros();
+    while(true) {
+        //-- Send full batches as we go so the queue doesn't hold us back
+        if(_queue_count >= UAS_QUEUE_THRESHOLD) {
+            flush();
+        }
+        if(_queue_count >= UAS_QUEUE_SIZE || !_readMessage()) {
+            break;
+        }
+        //-- Fast lane: straight out, ahead of the batch
+        mavlink_message_t* msg = &_message[_queue_count];
+        unsigned long parsed = micros();
+        if(isFastLane(msg->msgid) && _forwardTo->sendMessage(msg, 1) == 1) {
+            _forwardTo->addLatency(micros() - parsed);
+            memset(msg, 0, sizeof(mavlink_message_t));
+        } else {
             _queue_count++;
         }
+        if(micros() - start >= budget) {
+            if(Serial.available()) {
+                _status.budget_exhausted++;
+            }
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Forward what has been queued (or buffered in raw mode) once it is time to
+void
+MavESP8266Vehicle::flush()
+{
+    _drainTx();
+    while(_raw.available() && (_raw.available() >= RAW_MAX_DATAGRAM || (micros() - _raw_time) > _raw_flush_time)) {
+        size_t block;
+        const uint8_t* ptr = _raw.readPtr(&block);
+        block = min(block, (size_t)RAW_MAX_DATAGRAM);
+        int sent = _forwardTo->sendMessagRaw((uint8_t*)ptr, block);
+        if(sent <= 0) {
+            break;
+        }
+        _raw.consume(sent);
     }
     //-- Do we have a message to send and is it time to forward data?
-    if(_queue_count && (_queue_count >= UAS_QUEUE_THRESHOLD || (millis() - _queue_time) > UAS_QUEUE_TIMEOUT)) {
+    if(_queue_count && (_queue_count >= UAS_QUEUE_THRESHOLD || (micros() - _queue_time) > UAS_QUEUE_TIMEOUT)) {
         int sent = _forwardTo->sendMessage(_message, _queue_count);
         //-- Sent it all?
         if(sent == _queue_count) {
             memset(_message, 0, sizeof(_message));
             _queue_count = 0;
-            _queue_time  = millis();
+            _queue_time  = micros();
         //-- Sent at least some?
         } else if(sent) {
             //-- Move the pending ones up the queue
             int left = _queue_count - sent;
             for(int i = 0; i < left; i++) {
-                memcpy(&_message[sent+i], &_message[i], sizeof(mavlink_message_t));
+                memcpy(&_message[i], &_message[sent+i], sizeof(mavlink_message_t));
             }
             _queue_count = left;
         }
@@ -100,59 +333,148 @@ MavESP8266Vehicle::readMessage()
             cur_status = ((buffer_left / buffer_size) * 100.0f);
         _buffer_status = (_buffer_status * 0.05f) + (cur_status * 0.95);
     }
-    //-- Update radio status (1Hz)
-    if(_heard_from && (millis() - _last_status_time > 1000)) {
-        delay(0);
-        _sendRadioStatus();
-        _last_status_time = millis();
-    }
 }
 
+//---------------------------------------------------------------------------------
+//-- Raw mode: move whatever the UART has into the buffer. flush() sends it on as
+//   full datagrams, or as soon as the UART goes quiet.
 void
 MavESP8266Vehicle::readMessageRaw() {
-    char buf[1024];
-    int buf_index = 0;
-
-    while(Serial.available() && buf_index < 300)
-    {
-        int result = Serial.read();
-        if (result >= 0)
-        {
-            buf[buf_index] = (char)result;
-            buf_index++;
+    _checkUart();
+    size_t len = Serial.available();
+    while(len) {
+        size_t block;
+        uint8_t* ptr = _raw.writePtr(&block);
+        block = min(block, len);
+        if(!block) {
+            break;
         }
+        block = Serial.readBytes(ptr, block);
+        _raw.commit(block);
+        _status.raw_bytes_received += block;
+        _raw_time = micros();
+        len -= block;
     }
+}
 
-    _forwardTo->sendMessagRaw((uint8_t*)buf, buf_index);
+//---------------------------------------------------------------------------------
+bool
+MavESP8266Vehicle::beginRaw()
+{
+    //-- A few characters worth of silence ends a burst
+    _raw_flush_time = (RAW_FLUSH_CHARS * 10 * 1000000UL) / getWorld()->getParameters()->getUartBaudRate();
+    _raw_time = micros();
+    return MavESP8266Bridge::beginRaw();
 }
 
 //---------------------------------------------------------------------------------
 //-- Send MavLink message to UAS
 int
 MavESP8266Vehicle::sendMessage(mavlink_message_t* message, int count) {
-    for(int i = 0; i < count; i++) {
-        sendMessage(&message[i]);
+    int i;
+    for(i = 0; i < count; i++) {
+        if(!sendMessage(&message[i])) {
+            break;
+        }
     }
-    return count;
+    return i;
 }
 
 //---------------------------------------------------------------------------------
-//-- Send MavLink message to UAS
+//-- Queue MavLink message to UAS. Returns 0 if there is no room for it.
 int
 MavESP8266Vehicle::sendMessage(mavlink_message_t* message) {
-    // Translate message to buffer
-    char buf[300];
-    unsigned len = mavlink_msg_to_send_buffer((uint8_t*)buf, message);
-    // Send it
-    Serial.write((uint8_t*)(void*)buf, len);
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buf, message);
+    //-- Fast lane messages skip ahead of whatever else is waiting
+    if(isFastLane(message->msgid) && _tx_priority.space() >= sizeof(len) + sizeof(uint32_t) + len) {
+        uint32_t now = micros();
+        _tx_priority.write((uint8_t*)&len, sizeof(len));
+        _tx_priority.write((uint8_t*)&now, sizeof(now));
+        _tx_priority.write(buf, len);
+    } else if(_tx.space() >= sizeof(len) + len) {
+        _tx.write((uint8_t*)&len, sizeof(len));
+        _tx.write(buf, len);
+    } else {
+        _tx_dropped++;
+        return 0;
+    }
     _status.packets_sent++;
+    _drainTx();
     return 1;
 }
 
+//---------------------------------------------------------------------------------
+//-- Move queued frames into the UART TX FIFO, as much as it takes without
+//   blocking. A frame that has started goes out whole, then priority frames
+//   go ahead of the rest.
+void
+MavESP8266Vehicle::_drainTx()
+{
+    int room = Serial.availableForWrite();
+    while(room > 0) {
+        if(!_tx_left) {
+            if(_tx_priority.available()) {
+                _tx_current = &_tx_priority;
+                _tx_current->read((uint8_t*)&_tx_left, sizeof(_tx_left));
+                _tx_current->read((uint8_t*)&_tx_stamp, sizeof(_tx_stamp));
+            } else if(_tx.available()) {
+                _tx_current = &_tx;
+                _tx_current->read((uint8_t*)&_tx_left, sizeof(_tx_left));
+            } else {
+                break;
+            }
+        }
+        size_t block;
+        const uint8_t* ptr = _tx_current->readPtr(&block);
+        block = min(block, (size_t)min((int)_tx_left, room));
+        block = Serial.write(ptr, block);
+        _tx_current->consume(block);
+        _tx_left -= block;
+        room     -= block;
+        if(!_tx_left && _tx_current == &_tx_priority) {
+            addLatency(micros() - _tx_stamp);
+        }
+    }
+    _tx_peak = max(_tx_peak, uplinkDepth());
+    //-- Time spent with frames waiting on a full FIFO
+    if(_txPending() && room <= 0) {
+        if(!_tx_stalled) {
+            _tx_stalled     = true;
+            _tx_stall_start = micros();
+        }
+    } else if(_tx_stalled) {
+        _tx_stall_time += micros() - _tx_stall_start;
+        _tx_stalled = false;
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Milliseconds the uplink spent waiting on the UART
+uint32_t
+MavESP8266Vehicle::uplinkStallTime()
+{
+    uint64_t stall = _tx_stall_time;
+    if(_tx_stalled) {
+        stall += micros() - _tx_stall_start;
+    }
+    return (uint32_t)(stall / 1000);
+}
+
+//---------------------------------------------------------------------------------
+//-- Raw mode: only take what fits in the UART TX FIFO so we never block
 int
 MavESP8266Vehicle::sendMessagRaw(uint8_t *buffer, int len) {
-    Serial.write(buffer, len);
-    //Serial.flush();
+    //-- Frames queued before raw mode go first
+    _drainTx();
+    if(_txPending()) {
+        return 0;
+    }
+    len = min(len, Serial.availableForWrite());
+    if(len > 0) {
+        len = Serial.write(buffer, len);
+        _status.raw_bytes_sent += len;
+    }
     return len;
 }
 
@@ -181,6 +503,8 @@ MavESP8266Vehicle::_readMessage()
             msgReceived = mavlink_parse_char(MAVLINK_COMM_1, result, &_message[_queue_count], &uas_status);
             if(msgReceived) {
                 _status.packets_received++;
+                _baud_score++;
+                getWorld()->getRecorder()->record(&_message[_queue_count]);
                 //-- Is this the first packet we got?
                 if(!_heard_from) {
                     if(_message[_queue_count].msgid == MAVLINK_MSG_ID_HEARTBEAT) {
@@ -212,6 +536,7 @@ MavESP8266Vehicle::_readMessage()
         if(_heard_from && (millis() - _last_heartbeat) > HEARTBEAT_TIMEOUT) {
             _heard_from = false;
             getWorld()->getLogger()->log("Heartbeat timeout from Vehicle\n");
+            _startBaudDetect();
         }
     }
     return msgReceived;
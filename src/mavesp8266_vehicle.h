@@ -43,31 +43,89 @@
 //-- UDP Outgoing Packet Queue
 #define UAS_QUEUE_SIZE          60
 #define UAS_QUEUE_THRESHOLD     20
-#define UAS_QUEUE_TIMEOUT       5 // 5ms
+#define UAS_QUEUE_TIMEOUT       5000 // 5ms (in us)
+
+//-- Uplink (GCS to vehicle). Frames wait here until the UART TX FIFO takes them.
+#define UAS_TX_BUFFER_SIZE      2048    // Power of two
+#define UAS_TX_PRIORITY_SIZE    512     // Fast lane messages, sent ahead of the rest
+#define UAS_TX_HIGH_WATER       (UAS_TX_BUFFER_SIZE * 3 / 4) // Stop reading the GCS above this
+#define UART_TX_FIFO_SIZE       128
+
+//-- UART0 RX pin (the wake-up interrupt watches it)
+#define UART_RX_PIN             3
+#define UART_RX_SWAPPED_PIN     13
+
+//-- UART0 hardware flow control (ESP-12 pins, unavailable when the UART is swapped)
+#define UART_CTS_PIN            13
+#define UART_RTS_PIN            15
+#define UART_RTS_THRESHOLD      64  // RX FIFO level (of 128) that raises RTS
+
+//-- Baud rate detection
+#define BAUD_DETECT_WINDOW      120 // Time (ms) spent listening at each candidate rate
+#define BAUD_DETECT_LOCK        3   // Valid frames that lock onto a rate right away
 
 class MavESP8266Vehicle : public MavESP8266Bridge {
 public:
     MavESP8266Vehicle();
 
     void    begin           (MavESP8266Bridge* forwardTo);
-    void    readMessage     ();
+    void    readMessage     (uint32_t budget);
     void    readMessageRaw  ();
+    void    flush           ();
     int     sendMessage     (mavlink_message_t* message, int count);
     int     sendMessage     (mavlink_message_t* message);
     int     sendMessagRaw   (uint8_t *buffer, int len);
+    bool    sendBusy        () { return _tx.available() >= UAS_TX_HIGH_WATER; }
+    bool    beginRaw        ();
     linkStatus* getStatus   ();
+    bool    detectingBaud   () { return _baud_detect; }
+    unsigned long idleTime  ();
+    uint8_t rxPin           ();
+    //-- Uplink queue
+    uint32_t uplinkDepth    () { return _tx.available() + _tx_priority.available(); }
+    uint32_t uplinkPeak     () { return _tx_peak; }
+    uint32_t uplinkStallTime();
+    uint32_t uplinkDropped  () { return _tx_dropped; }
 
 protected:
     void    _sendRadioStatus();
 
 private:
     bool    _readMessage    ();
+    void    _checkUart      ();
+    void    _enableFlowControl();
+    void    _startBaudDetect();
+    void    _checkBaudDetect();
+    void    _setBaudRate    (uint32_t baud);
+    void    _drainTx        ();
+    bool    _txPending      () { return _tx_left || _tx.available() || _tx_priority.available(); }
 
 private:
     int                     _queue_count;
     unsigned long           _queue_time;
     float                   _buffer_status;
+    unsigned long           _raw_time;
+    unsigned long           _raw_flush_time;
+    bool                    _flow_control;
+    int                     _rx_high;
+    int                     _rx_low;
+    bool                    _baud_detect;
+    int                     _baud_index;
+    int                     _baud_best;
+    uint32_t                _baud_score;
+    uint32_t                _baud_best_score;
+    unsigned long           _baud_time;
     mavlink_message_t       _message[UAS_QUEUE_SIZE];
+    MavESP8266Ring          _tx;            // Frames, each after its length (uint16_t)
+    MavESP8266Ring          _tx_priority;   // Same, with the time (uint32_t) it was queued after the length
+    MavESP8266Ring*         _tx_current;    // Where the frame going out now comes from
+    uint16_t                _tx_left;       // Bytes of it not in the FIFO yet
+    uint32_t                _tx_stamp;      // When it was queued (priority frames only)
+    uint32_t                _tx_peak;
+    uint32_t                _tx_dropped;
+    bool                    _tx_stalled;
+    unsigned long           _tx_stall_start;
+    uint64_t                _tx_stall_time; // us
 };
 
 #endif
@@ -0,0 +1,1470 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file replay.cpp
+ * Replays a .tlog through a host build of the bridge
+ *
+ * The recorded frames are fed into the vehicle UART at their recorded time
+ * (optionally sped up) and at the UART wire rate. Everything the GCS side
+ * sends is captured and matched against what went in, so batching and
+ * queueing changes can be compared against real flights.
+ *
+ *   replay [options] flight.tlog
+ *
+ * Run it without arguments for the options (see usage() below).
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "mavesp8266.h"
+#include "mavesp8266_parameters.h"
+#include "mavesp8266_gcs.h"
+#include "mavesp8266_vehicle.h"
+#include "mavesp8266_component.h"
+#include "mavesp8266_recorder.h"
+#include "mavesp8266_events.h"
+#include "mavesp8266_scheduler.h"
+#include "mavesp8266_paramcache.h"
+#include "mavesp8266_mission.h"
+#include "mavesp8266_logdata.h"
+#include "mavesp8266_ftp.h"
+#include "mavesp8266_telemetry.h"
+
+#define REPLAY_DRAIN_TIME       1000000 // Keep running this long (us) after the last byte
+#define REPLAY_WAKE_LATENCY     20      // Time (us) from a wake-up event to loop() running
+#define REPLAY_HISTOGRAM_STEP   128
+#define REPLAY_HISTOGRAM_SIZE   12
+#define REPLAY_GCS_IP           IPAddress(192, 168, 4, 2)
+#define REPLAY_GCS_PORT         14550
+#define REPLAY_PARAM_PERIOD     5000000 // GCS parameter list requests (us apart)
+#define REPLAY_GCS_DELAY        10000   // Mission messages from the GCS: time (us) over WiFi and through the GCS
+#define REPLAY_GCS_TIMEOUT      1500000 // GCS mission protocol timeout (us)
+#define REPLAY_FC_DELAY         200     // Time (us) the autopilot takes to answer a mission message
+#define REPLAY_MISSION_RETRIES  10
+#define REPLAY_LOG_BLOCK        (32 * 90) // The GCS asks for the log this much at a time
+#define REPLAY_FTP_BURST        20      // Chunks the autopilot sends for each FTP burst read
+#define REPLAY_FTP_LOSS         40      // Every this many FTP replies one is lost over WiFi
+#define REPLAY_DROP_START       2000000 // When the GCS drops out (us)
+
+//-- Singletons
+MavESP8266Component     Component;
+MavESP8266Parameters    Parameters;
+MavESP8266GCS           GCS;
+MavESP8266Vehicle       Vehicle;
+MavESP8266Log           Logger;
+MavESP8266Recorder      Recorder;
+MavESP8266Events        Events;
+MavESP8266Scheduler     Scheduler;
+MavESP8266ParamCache    ParamCache;
+MavESP8266Mission       Mission;
+MavESP8266LogData       LogData;
+MavESP8266Ftp           Ftp;
+MavESP8266Telemetry     Telemetry;
+
+//---------------------------------------------------------------------------------
+//-- Accessors
+class MavESP8266WorldImp : public MavESP8266World {
+public:
+    MavESP8266Parameters*   getParameters   () { return &Parameters;    }
+    MavESP8266Component*    getComponent    () { return &Component;     }
+    MavESP8266Vehicle*      getVehicle      () { return &Vehicle;       }
+    MavESP8266GCS*          getGCS          () { return &GCS;           }
+    MavESP8266Log*          getLogger       () { return &Logger;        }
+    MavESP8266Recorder*     getRecorder     () { return &Recorder;      }
+    MavESP8266Events*       getEvents       () { return &Events;        }
+    MavESP8266Scheduler*    getScheduler    () { return &Scheduler;     }
+    MavESP8266ParamCache*   getParamCache   () { return &ParamCache;    }
+    MavESP8266Mission*      getMission      () { return &Mission;       }
+    MavESP8266LogData*      getLogData      () { return &LogData;       }
+    MavESP8266Ftp*          getFtp          () { return &Ftp;           }
+    MavESP8266Telemetry*    getTelemetry    () { return &Telemetry;     }
+};
+
+MavESP8266WorldImp      World;
+
+MavESP8266World* getWorld()
+{
+    return &World;
+}
+
+//---------------------------------------------------------------------------------
+//-- Same tasks as main.cpp (less HTTP)
+static bool taskUart(uint32_t budget) {
+    if(Component.inRawMode()) {
+        Vehicle.readMessageRaw();
+    } else {
+        Vehicle.readMessage(budget);
+    }
+    return false;
+}
+
+static bool taskUdp(uint32_t budget) {
+    if(Component.inRawMode()) {
+        GCS.readMessageRaw();
+    } else {
+        GCS.readMessage(budget);
+    }
+    return false;
+}
+
+static bool taskFlush(uint32_t budget) {
+    Vehicle.flush();
+    return false;
+}
+
+static bool taskRadioStatus(uint32_t budget) {
+    GCS.sendRadioStatus();
+    Vehicle.sendRadioStatus();
+    return false;
+}
+
+static bool taskParameters(uint32_t budget) {
+    return Component.streamParameters(budget);
+}
+
+static bool taskStorage(uint32_t budget) {
+    ParamCache.service();
+    Recorder.service();
+    return false;
+}
+
+static bool taskParamCache(uint32_t budget) {
+    return ParamCache.stream(budget);
+}
+
+static bool taskMission(uint32_t budget) {
+    Mission.service();
+    return false;
+}
+
+bool taskLogData(uint32_t budget) {
+    LogData.service();
+    return LogData.stream(budget);
+}
+
+//---------------------------------------------------------------------------------
+//-- One frame from the log and what became of it
+struct stFrame {
+    uint64_t    time;       // Recorded time stamp (us)
+    uint64_t    arrived;    // Simulated time the last byte reached the UART buffer
+    uint64_t    key;
+    std::string data;
+    bool        overrun;    // Lost at least one byte to a full UART buffer
+    bool        forwarded;
+};
+
+static std::vector<stFrame>                     frames;
+static std::map<uint64_t, std::deque<size_t> >  inFlight;   // Frames waiting to show up on the GCS side
+static std::vector<uint32_t>                    latencies;
+static std::vector<uint32_t>                    fastLatencies;  // Same, fast lane messages only
+static uint32_t     histogram[REPLAY_HISTOGRAM_SIZE];
+static uint32_t     datagrams       = 0;
+static uint64_t     datagramBytes   = 0;
+static uint32_t     broadcasts      = 0;    // Discovery heartbeats (not part of the forwarded stream)
+static uint64_t     broadcastBytes  = 0;
+static uint32_t     framesOut       = 0;
+static uint32_t     framesBridge    = 0;    // Generated by the bridge itself
+static FILE*        capture         = NULL;
+static std::string  gcsStream;              // Frames can span datagrams in raw mode
+static std::string  uplinkStream;           // What the bridge wrote to the vehicle UART
+static uint32_t     uplinkFrames    = 0;
+static std::deque<uint64_t>     commandsSent;   // When each COMMAND_LONG left the GCS
+static std::vector<uint32_t>    commandLatency; // Until its last byte was on the wire (us)
+
+//-- A PARAM_REQUEST_LIST from the GCS and how it was answered
+struct stParamList {
+    uint64_t    sent;
+    uint64_t    done;       // When the GCS had all parameters (0 if it never did)
+    uint32_t    received;
+    bool        vehicle;    // Reached the vehicle (not answered by the bridge)
+};
+
+static uint16_t                 paramCount = 0; // Parameters the simulated autopilot has
+static std::vector<stParamList> paramLists;
+static std::deque<std::string>  vehicleTx;      // Frames the vehicle sends on top of the log
+static uint64_t                 vehicleTxStart = 0;
+
+//-- Mission written by the GCS and read back (-M)
+enum {
+    MISSION_TEST_OFF = 0,
+    MISSION_TEST_WAIT,      // For the vehicle
+    MISSION_TEST_WRITE,
+    MISSION_TEST_READ,
+    MISSION_TEST_DONE,
+    MISSION_TEST_FAILED,
+};
+
+static uint16_t                 missionItems    = 0;
+static uint8_t                  missionTest     = MISSION_TEST_OFF;
+static uint64_t                 missionStart    = 0;
+static uint32_t                 missionTimes[2] = { 0, 0 };  // Write, read (us)
+static uint16_t                 missionNext     = 0;        // Item the GCS expects while reading
+static uint32_t                 missionResent   = 0;        // GCS timeouts
+static std::string              gcsLast;                    // Last datagram the GCS sent (resent on timeout)
+static uint64_t                 gcsLastTime     = 0;
+static std::deque<std::pair<uint64_t, std::string> > gcsOutbox;  // Delayed GCS datagrams
+static std::vector<mavlink_mission_item_int_t> vehicleItems;     // What the autopilot has
+static uint16_t                 vehicleMissionCount = 0;    // Being written
+
+//-- Onboard log downloaded by the GCS (-L)
+static uint32_t                 logSize         = 0;
+static uint8_t                  logTest         = MISSION_TEST_OFF;
+static uint64_t                 logStart        = 0;
+static uint32_t                 logTime         = 0;
+static uint32_t                 logNext         = 0;        // Offset the GCS expects next
+static uint32_t                 logResent       = 0;
+static uint32_t                 logBadBytes     = 0;
+static uint32_t                 logVehicleBytes = 0;        // LOG_DATA bytes the vehicle sent
+
+//-- File read by the GCS over MAVLink FTP with burst reads (-T)
+static uint32_t                 ftpSize         = 0;
+static uint8_t                  ftpTest         = MISSION_TEST_OFF;
+static uint64_t                 ftpStart        = 0;
+static uint32_t                 ftpTime         = 0;
+static std::vector<bool>        ftpHave;                    // Chunks the GCS has
+static uint32_t                 ftpBurstEnd     = 0;        // Where the last burst stopped
+static uint16_t                 ftpSeq          = 0;
+static uint32_t                 ftpReplies      = 0;
+static uint32_t                 ftpLost         = 0;        // Replies dropped on the way to the GCS
+static uint32_t                 ftpRereads      = 0;        // ReadFile sent by the GCS to fill gaps
+static uint32_t                 ftpResent       = 0;        // GCS timeouts
+static uint32_t                 ftpBadBytes     = 0;
+static uint32_t                 ftpVehicleBytes = 0;        // Bytes the vehicle sent
+
+//-- The GCS out of WiFi range for a while, the vehicle sending a STATUSTEXT every second (-D)
+static uint64_t                 dropEnd         = 0;
+static uint32_t                 dropDatagrams   = 0;        // Lost while it was gone
+static uint32_t                 dropTexts       = 0;        // STATUSTEXT sent while it was gone
+static uint32_t                 dropTextsSeen   = 0;        // Of those, received once it was back
+static uint32_t                 dropTextLast    = 0;        // When the last of them came in (us after it was back)
+static uint32_t                 dropFrames      = 0;        // Other frames from before it came back
+static bool                     dropBack        = false;
+
+//-- A dashboard polling /telemetry.json once a second (-g)
+static uint32_t                 telemPolls      = 0;
+static uint32_t                 telemUnchanged  = 0;        // Would have been a 304
+static uint32_t                 telemVersion    = 0;
+
+static bool
+gcsDropped()
+{
+    return dropEnd && hostMicros >= REPLAY_DROP_START && hostMicros < dropEnd;
+}
+
+//---------------------------------------------------------------------------------
+//-- Total frame length (v1 and v2) or 0 if this isn't the start of a frame
+static size_t
+frameLength(const uint8_t* data, size_t len)
+{
+    if(len < 2) {
+        return 0;
+    }
+    if(data[0] == 0xFE) {
+        return data[1] + 8;
+    }
+    if(data[0] == 0xFD && len > 2) {
+        return data[1] + 12 + ((data[2] & 0x01) ? 13 : 0);
+    }
+    return 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- Identify a frame by message id, sender and sequence
+static uint64_t
+frameKey(const uint8_t* data)
+{
+    uint32_t msgid;
+    const uint8_t* hdr;
+    if(data[0] == 0xFE) {
+        hdr   = &data[2];
+        msgid = data[5];
+    } else {
+        hdr   = &data[4];
+        msgid = data[7] | (data[8] << 8) | (data[9] << 16);
+    }
+    return ((uint64_t)msgid << 24) | ((uint64_t)hdr[1] << 16) | ((uint64_t)hdr[2] << 8) | hdr[0];
+}
+
+//---------------------------------------------------------------------------------
+//-- The bridge's own fast lane histogram
+static void
+printHistogram(const char* name, latencyHistogram* histogram)
+{
+    uint32_t total = 0;
+    for(int i = 0; i < LATENCY_BUCKETS; i++) {
+        total += histogram->count[i];
+    }
+    if(!total) {
+        return;
+    }
+    printf("%s", name);
+    for(int i = 0; i < LATENCY_BUCKETS; i++) {
+        if(i < LATENCY_BUCKETS - 1) {
+            printf(" <=%u: %u", kLatencyLimits[i], histogram->count[i]);
+        } else {
+            printf(" more: %u", histogram->count[i]);
+        }
+    }
+    printf(" (max %u us)\n", histogram->max);
+}
+
+//---------------------------------------------------------------------------------
+static bool
+loadTlog(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if(!f) {
+        perror(path);
+        return false;
+    }
+    std::string log;
+    char chunk[4096];
+    size_t n;
+    while((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        log.append(chunk, n);
+    }
+    fclose(f);
+    const uint8_t* data = (const uint8_t*)log.data();
+    size_t pos = 0, skipped = 0;
+    while(pos + 8 < log.length()) {
+        size_t len = frameLength(&data[pos + 8], log.length() - pos - 8);
+        if(!len || pos + 8 + len > log.length()) {
+            //-- Not a record boundary. Resync one byte at a time.
+            pos++;
+            skipped++;
+            continue;
+        }
+        stFrame frame;
+        frame.time = 0;
+        for(int i = 0; i < 8; i++) {
+            frame.time = (frame.time << 8) | data[pos + i];
+        }
+        frame.arrived   = 0;
+        frame.key       = frameKey(&data[pos + 8]);
+        frame.data.assign((const char*)&data[pos + 8], len);
+        frame.overrun   = false;
+        frame.forwarded = false;
+        frames.push_back(frame);
+        pos += 8 + len;
+    }
+    if(skipped) {
+        fprintf(stderr, "%s: skipped %u bytes that were not tlog records\n", path, (unsigned)skipped);
+    }
+    return !frames.empty();
+}
+
+//---------------------------------------------------------------------------------
+//-- Messages the simulated GCS and vehicle take part in
+static bool
+isMission(const uint8_t* frame)
+{
+    if(frame[0] != 0xFE) {
+        return false;
+    }
+    switch(frame[5]) {
+        case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+        case MAVLINK_MSG_ID_MISSION_COUNT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST:
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+        case MAVLINK_MSG_ID_MISSION_ACK:
+        case MAVLINK_MSG_ID_LOG_REQUEST_DATA:
+        case MAVLINK_MSG_ID_LOG_DATA:
+        case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+            return true;
+    }
+    return false;
+}
+
+//-- What the simulated onboard log holds at ofs
+static uint8_t
+logByte(uint32_t ofs)
+{
+    return (uint8_t)((ofs * 7) ^ (ofs >> 8));
+}
+
+static bool
+parseFrame(uint8_t chan, const uint8_t* frame, size_t len, mavlink_message_t* msg)
+{
+    mavlink_status_t status;
+    for(size_t i = 0; i < len; i++) {
+        if(mavlink_parse_char(chan, frame[i], msg, &status)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+//-- The GCS answers after a WiFi and GCS round trip
+static void
+gcsSend(mavlink_message_t* msg)
+{
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buf, msg);
+    gcsLast.assign((const char*)buf, len);
+    gcsLastTime = hostMicros;
+    gcsOutbox.push_back(std::make_pair(hostMicros + REPLAY_GCS_DELAY, gcsLast));
+}
+
+static void
+gcsMissionItem(uint16_t seq)
+{
+    mavlink_message_t msg;
+    mavlink_msg_mission_item_int_pack(255, 190, &msg, Vehicle.systemID(), Vehicle.componentID(), seq, MAV_FRAME_GLOBAL_RELATIVE_ALT_INT,
+                                      MAV_CMD_NAV_WAYPOINT, 0, 1, 0, 0, 0, 0, 473977000 + seq, 85455000, 50);
+    gcsSend(&msg);
+}
+
+//---------------------------------------------------------------------------------
+//-- The GCS asks for the log a block at a time, the next block once it has this one
+static void
+gcsLogRequest()
+{
+    mavlink_message_t msg;
+    mavlink_msg_log_request_data_pack(255, 190, &msg, Vehicle.systemID(), Vehicle.componentID(), 1, logNext,
+                                      min((uint32_t)REPLAY_LOG_BLOCK - logNext % REPLAY_LOG_BLOCK, logSize - logNext));
+    gcsSend(&msg);
+}
+
+static void
+gcsLogData(mavlink_message_t* msg)
+{
+    mavlink_log_data_t data;
+    mavlink_msg_log_data_decode(msg, &data);
+    if(logTest != MISSION_TEST_READ || data.id != 1 || data.ofs != logNext) {
+        return;
+    }
+    for(uint8_t i = 0; i < data.count; i++) {
+        if(data.data[i] != logByte(data.ofs + i)) {
+            logBadBytes++;
+        }
+    }
+    logNext += data.count;
+    gcsLastTime = hostMicros;
+    if(logNext >= logSize || data.count < MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN) {
+        logTime = (uint32_t)(hostMicros - logStart);
+        logTest = logNext == logSize ? MISSION_TEST_DONE : MISSION_TEST_FAILED;
+    } else if(!(logNext % REPLAY_LOG_BLOCK)) {
+        gcsLogRequest();
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- FTP the way QGroundControl downloads a file: burst reads, then ReadFile for
+//   each chunk missing from the burst
+static void
+ftpRequest(uint8_t opcode, uint32_t offset)
+{
+    uint8_t payload[MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN];
+    memset(payload, 0, sizeof(payload));
+    ftpHeader header;
+    memset(&header, 0, sizeof(header));
+    header.seq     = ++ftpSeq;
+    header.opcode  = opcode;
+    header.offset  = offset;
+    if(opcode == FTP_OP_OPEN_RO) {
+        header.size = strlen("@SYS/replay.bin");
+        memcpy(&payload[sizeof(header)], "@SYS/replay.bin", header.size);
+    } else if(opcode == FTP_OP_READ || opcode == FTP_OP_BURST_READ) {
+        header.size = FTP_DATA_LEN;
+    }
+    memcpy(payload, &header, sizeof(header));
+    mavlink_message_t msg;
+    mavlink_msg_file_transfer_protocol_pack(255, 190, &msg, 0, Vehicle.systemID(), Vehicle.componentID(), payload);
+    gcsSend(&msg);
+}
+
+//-- Next step once a burst (or a gap in it) is in
+static void
+ftpNext()
+{
+    for(uint32_t chunk = 0; chunk * FTP_DATA_LEN < ftpBurstEnd; chunk++) {
+        if(!ftpHave[chunk]) {
+            ftpRereads++;
+            ftpRequest(FTP_OP_READ, chunk * FTP_DATA_LEN);
+            return;
+        }
+    }
+    if(ftpBurstEnd < ftpSize) {
+        ftpRequest(FTP_OP_BURST_READ, ftpBurstEnd);
+    } else {
+        ftpRequest(FTP_OP_TERMINATE, 0);
+    }
+}
+
+static void
+gcsFtp(mavlink_message_t* msg)
+{
+    mavlink_file_transfer_protocol_t ftp;
+    mavlink_msg_file_transfer_protocol_decode(msg, &ftp);
+    ftpHeader header;
+    memcpy(&header, ftp.payload, sizeof(header));
+    if(ftpTest != MISSION_TEST_READ || header.opcode != FTP_OP_ACK) {
+        return;
+    }
+    gcsLastTime = hostMicros;
+    switch(header.req_opcode) {
+        case FTP_OP_OPEN_RO:
+            ftpRequest(FTP_OP_BURST_READ, 0);
+            break;
+        case FTP_OP_READ:
+        case FTP_OP_BURST_READ: {
+            uint32_t chunk = header.offset / FTP_DATA_LEN;
+            if(chunk < ftpHave.size() && !ftpHave[chunk]) {
+                for(uint8_t i = 0; i < header.size; i++) {
+                    if(ftp.payload[sizeof(header) + i] != logByte(header.offset + i)) {
+                        ftpBadBytes++;
+                    }
+                }
+                ftpHave[chunk] = true;
+            }
+            if(header.req_opcode == FTP_OP_READ || header.burst_complete) {
+                if(header.req_opcode == FTP_OP_BURST_READ) {
+                    ftpBurstEnd = header.offset + header.size;
+                }
+                ftpNext();
+            }
+            break;
+        }
+        case FTP_OP_TERMINATE:
+            ftpTime = (uint32_t)(hostMicros - ftpStart);
+            ftpTest = MISSION_TEST_DONE;
+            for(size_t i = 0; i < ftpHave.size(); i++) {
+                if(!ftpHave[i]) {
+                    ftpTest = MISSION_TEST_FAILED;
+                }
+            }
+            break;
+    }
+}
+
+static void
+gcsMission(mavlink_message_t* msg)
+{
+    mavlink_message_t reply;
+    switch(msg->msgid) {
+        case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+            gcsFtp(msg);
+            break;
+        case MAVLINK_MSG_ID_LOG_DATA:
+            gcsLogData(msg);
+            break;
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST: {
+            mavlink_mission_request_int_t req;
+            mavlink_msg_mission_request_int_decode(msg, &req);
+            if(missionTest == MISSION_TEST_WRITE && req.seq < missionItems) {
+                gcsMissionItem(req.seq);
+            }
+            break;
+        }
+        case MAVLINK_MSG_ID_MISSION_ACK: {
+            mavlink_mission_ack_t ack;
+            mavlink_msg_mission_ack_decode(msg, &ack);
+            if(missionTest != MISSION_TEST_WRITE) {
+                break;
+            }
+            if(ack.type != MAV_MISSION_ACCEPTED) {
+                missionTest = MISSION_TEST_FAILED;
+                break;
+            }
+            missionTimes[0] = (uint32_t)(hostMicros - missionStart);
+            //-- Read it back
+            missionTest  = MISSION_TEST_READ;
+            missionStart = hostMicros;
+            mavlink_msg_mission_request_list_pack(255, 190, &reply, Vehicle.systemID(), Vehicle.componentID());
+            gcsSend(&reply);
+            break;
+        }
+        case MAVLINK_MSG_ID_MISSION_COUNT: {
+            mavlink_mission_count_t cnt;
+            mavlink_msg_mission_count_decode(msg, &cnt);
+            if(missionTest == MISSION_TEST_READ && cnt.count == missionItems) {
+                missionNext = 0;
+                mavlink_msg_mission_request_int_pack(255, 190, &reply, Vehicle.systemID(), Vehicle.componentID(), 0);
+                gcsSend(&reply);
+            }
+            break;
+        }
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT: {
+            mavlink_mission_item_int_t item;
+            mavlink_msg_mission_item_int_decode(msg, &item);
+            if(missionTest != MISSION_TEST_READ || item.seq != missionNext) {
+                break;
+            }
+            if(++missionNext < missionItems) {
+                mavlink_msg_mission_request_int_pack(255, 190, &reply, Vehicle.systemID(), Vehicle.componentID(), missionNext);
+            } else {
+                missionTimes[1] = (uint32_t)(hostMicros - missionStart);
+                missionTest = MISSION_TEST_DONE;
+                mavlink_msg_mission_ack_pack(255, 190, &reply, Vehicle.systemID(), Vehicle.componentID(), MAV_MISSION_ACCEPTED);
+            }
+            gcsSend(&reply);
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Everything the bridge sends to the GCS ends up here
+static void
+gcsReceive(IPAddress ip, uint16_t port, const uint8_t* data, size_t len)
+{
+    if(ip[3] == 255) {
+        broadcasts++;
+        broadcastBytes += len;
+        return;
+    }
+    if(gcsDropped()) {
+        dropDatagrams++;
+        return;
+    }
+    datagrams++;
+    datagramBytes += len;
+    histogram[min(len / REPLAY_HISTOGRAM_STEP, (size_t)REPLAY_HISTOGRAM_SIZE - 1)]++;
+    gcsStream.append((const char*)data, len);
+    data = (const uint8_t*)gcsStream.data();
+    len  = gcsStream.length();
+    size_t pos = 0;
+    while(pos < len) {
+        if((data[pos] == 0xFE || data[pos] == 0xFD) && len - pos < 3) {
+            //-- Need the rest of the header
+            break;
+        }
+        size_t flen = frameLength(&data[pos], len - pos);
+        if(!flen) {
+            pos++;
+            continue;
+        }
+        if(pos + flen > len) {
+            break;
+        }
+        framesOut++;
+        std::map<uint64_t, std::deque<size_t> >::iterator i = inFlight.find(frameKey(&data[pos]));
+        if(i != inFlight.end() && !i->second.empty()) {
+            stFrame& frame = frames[i->second.front()];
+            i->second.pop_front();
+            frame.forwarded = true;
+            latencies.push_back((uint32_t)(hostMicros - frame.arrived));
+            uint32_t msgid = (uint32_t)(frameKey(&data[pos]) >> 24);
+            if(GCS.isFastLane(msgid)) {
+                fastLatencies.push_back(latencies.back());
+            }
+        } else if(isMission(&data[pos]) && data[pos + 3] == Vehicle.systemID()) {
+            mavlink_message_t msg;
+            bool lost = data[pos + 5] == MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL && !(++ftpReplies % REPLAY_FTP_LOSS);
+            if(lost) {
+                ftpLost++;
+            } else if((missionTest || logTest || ftpTest) && parseFrame(MAVLINK_COMM_3, &data[pos], flen, &msg)) {
+                gcsMission(&msg);
+            }
+        } else if(dropEnd && data[pos + 5] == MAVLINK_MSG_ID_STATUSTEXT && data[pos + 3] == Vehicle.systemID()) {
+            dropTextsSeen++;
+            dropTextLast = (uint32_t)(hostMicros - dropEnd);
+        } else if(dropEnd && hostMicros >= dropEnd && data[pos + 3] == Vehicle.systemID() && data[pos + 4] == Vehicle.componentID()) {
+            //-- Kept by the bridge while the GCS was gone
+            dropFrames++;
+        } else if(data[pos] == 0xFE && data[pos + 5] == MAVLINK_MSG_ID_PARAM_VALUE && !paramLists.empty() &&
+                  data[pos + 3] == Vehicle.systemID() && data[pos + 4] == Vehicle.componentID()) {
+            stParamList& list = paramLists.back();
+            if(++list.received == paramCount) {
+                list.done = hostMicros;
+            }
+        } else {
+            framesBridge++;
+        }
+        if(capture) {
+            uint8_t ts[8];
+            for(int b = 0; b < 8; b++) {
+                ts[b] = (uint8_t)(hostMicros >> (56 - (b * 8)));
+            }
+            fwrite(ts, 1, sizeof(ts), capture);
+            fwrite(&data[pos], 1, flen, capture);
+        }
+        pos += flen;
+    }
+    gcsStream.erase(0, pos);
+}
+
+//---------------------------------------------------------------------------------
+//-- Pretend to be a GCS so the bridge stops broadcasting
+static void
+gcsHeartbeat()
+{
+    mavlink_message_t msg;
+    mavlink_msg_heartbeat_pack(255, 190, &msg, MAV_TYPE_GCS, MAV_AUTOPILOT_INVALID, 0, 0, MAV_STATE_ACTIVE);
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buf, &msg);
+    WiFiUDP::hostInject(Parameters.getWifiUdpCport(), REPLAY_GCS_IP, REPLAY_GCS_PORT, buf, len);
+}
+
+//---------------------------------------------------------------------------------
+//-- A mission upload sized burst, then a command that should not wait behind it
+static void
+gcsUplink(int count)
+{
+    uint8_t  datagram[RAW_MAX_DATAGRAM];
+    uint16_t len = 0;
+    mavlink_message_t msg;
+    for(int i = 0; i <= count; i++) {
+        if(i < count) {
+            mavlink_msg_mission_item_int_pack(255, 190, &msg, 1, 1, i, MAV_FRAME_GLOBAL_RELATIVE_ALT_INT,
+                                              MAV_CMD_NAV_WAYPOINT, 0, 1, 0, 0, 0, 0, 473977000 + i, 85455000, 50);
+        } else {
+            mavlink_msg_command_long_pack(255, 190, &msg, 1, 1, MAV_CMD_DO_SET_MODE, 0, 1, 4, 0, 0, 0, 0, 0);
+        }
+        if(len + MAVLINK_MAX_PACKET_LEN > sizeof(datagram)) {
+            WiFiUDP::hostInject(Parameters.getWifiUdpCport(), REPLAY_GCS_IP, REPLAY_GCS_PORT, datagram, len);
+            len = 0;
+        }
+        len += mavlink_msg_to_send_buffer(&datagram[len], &msg);
+    }
+    WiFiUDP::hostInject(Parameters.getWifiUdpCport(), REPLAY_GCS_IP, REPLAY_GCS_PORT, datagram, len);
+    commandsSent.push_back(hostMicros);
+}
+
+//---------------------------------------------------------------------------------
+//-- One test at a time
+static bool
+gcsTestRunning()
+{
+    return missionTest == MISSION_TEST_WRITE || missionTest == MISSION_TEST_READ ||
+           logTest == MISSION_TEST_READ || ftpTest == MISSION_TEST_READ;
+}
+
+//---------------------------------------------------------------------------------
+//-- Start writing the mission, deliver what the GCS sent by now and resend on timeouts
+static void
+gcsMissionService()
+{
+    if(missionTest == MISSION_TEST_WAIT && Vehicle.heardFrom()) {
+        missionTest  = MISSION_TEST_WRITE;
+        missionStart = hostMicros;
+        mavlink_message_t msg;
+        mavlink_msg_mission_count_pack(255, 190, &msg, Vehicle.systemID(), Vehicle.componentID(), missionItems);
+        gcsSend(&msg);
+    }
+    if(logTest == MISSION_TEST_WAIT && Vehicle.heardFrom() && missionTest != MISSION_TEST_WAIT && !gcsTestRunning()) {
+        logTest  = MISSION_TEST_READ;
+        logStart = hostMicros;
+        gcsLogRequest();
+    }
+    if(ftpTest == MISSION_TEST_WAIT && Vehicle.heardFrom() && missionTest != MISSION_TEST_WAIT &&
+       logTest != MISSION_TEST_WAIT && !gcsTestRunning()) {
+        ftpTest  = MISSION_TEST_READ;
+        ftpStart = hostMicros;
+        ftpHave.assign((ftpSize + FTP_DATA_LEN - 1) / FTP_DATA_LEN, false);
+        ftpRequest(FTP_OP_OPEN_RO, 0);
+    }
+    while(!gcsOutbox.empty() && gcsOutbox.front().first <= hostMicros) {
+        const std::string& datagram = gcsOutbox.front().second;
+        WiFiUDP::hostInject(Parameters.getWifiUdpCport(), REPLAY_GCS_IP, REPLAY_GCS_PORT, (const uint8_t*)datagram.data(), datagram.length());
+        gcsOutbox.pop_front();
+    }
+    if((missionTest == MISSION_TEST_WRITE || missionTest == MISSION_TEST_READ) && hostMicros >= gcsLastTime + REPLAY_GCS_TIMEOUT) {
+        if(++missionResent > REPLAY_MISSION_RETRIES) {
+            missionTest = MISSION_TEST_FAILED;
+            return;
+        }
+        gcsLastTime = hostMicros;
+        gcsOutbox.push_back(std::make_pair(hostMicros + REPLAY_GCS_DELAY, gcsLast));
+    }
+    //-- Ask again for the rest of the block
+    if(logTest == MISSION_TEST_READ && hostMicros >= gcsLastTime + REPLAY_GCS_TIMEOUT) {
+        if(++logResent > REPLAY_MISSION_RETRIES) {
+            logTest = MISSION_TEST_FAILED;
+            return;
+        }
+        gcsLogRequest();
+    }
+    if(ftpTest == MISSION_TEST_READ && hostMicros >= gcsLastTime + REPLAY_GCS_TIMEOUT) {
+        if(++ftpResent > REPLAY_MISSION_RETRIES) {
+            ftpTest = MISSION_TEST_FAILED;
+            return;
+        }
+        gcsLastTime = hostMicros;
+        gcsOutbox.push_back(std::make_pair(hostMicros + REPLAY_GCS_DELAY, gcsLast));
+    }
+}
+
+static bool
+gcsMissionActive()
+{
+    return gcsTestRunning() || !gcsOutbox.empty();
+}
+
+//---------------------------------------------------------------------------------
+//-- A GCS (re)connecting asks the autopilot for all of its parameters
+static void
+gcsParamList()
+{
+    mavlink_message_t msg;
+    mavlink_msg_param_request_list_pack(255, 190, &msg, Vehicle.systemID(), Vehicle.componentID());
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buf, &msg);
+    WiFiUDP::hostInject(Parameters.getWifiUdpCport(), REPLAY_GCS_IP, REPLAY_GCS_PORT, buf, len);
+    stParamList list = { hostMicros, 0, 0, false };
+    paramLists.push_back(list);
+}
+
+//---------------------------------------------------------------------------------
+//-- Queue a frame from the vehicle, after delay us if it has nothing else to send
+static void
+vehicleSend(mavlink_message_t* msg, uint32_t delay)
+{
+    if(vehicleTx.empty()) {
+        vehicleTxStart = (hostMicros + delay) * 1000;
+    }
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buf, msg);
+    vehicleTx.push_back(std::string((const char*)buf, len));
+}
+
+//---------------------------------------------------------------------------------
+//-- The autopilot's FTP server: one file, one session
+static void
+vehicleFtpReply(mavlink_message_t* msg, ftpHeader* request, uint32_t offset, uint32_t size, bool complete)
+{
+    uint8_t payload[MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN];
+    memset(payload, 0, sizeof(payload));
+    ftpHeader header;
+    memset(&header, 0, sizeof(header));
+    header.seq            = request->seq + 1;
+    header.opcode         = FTP_OP_ACK;
+    header.req_opcode     = request->opcode;
+    header.burst_complete = complete;
+    header.offset         = offset;
+    header.size           = size;
+    memcpy(payload, &header, sizeof(header));
+    if(request->opcode == FTP_OP_OPEN_RO) {
+        memcpy(&payload[sizeof(header)], &ftpSize, sizeof(ftpSize));
+    } else {
+        for(uint32_t i = 0; i < size; i++) {
+            payload[sizeof(header) + i] = logByte(offset + i);
+        }
+        ftpVehicleBytes += size;
+    }
+    mavlink_message_t reply;
+    mavlink_msg_file_transfer_protocol_pack(Vehicle.systemID(), Vehicle.componentID(), &reply, 0, msg->sysid, msg->compid, payload);
+    vehicleSend(&reply, REPLAY_FC_DELAY);
+}
+
+static void
+vehicleFtp(mavlink_message_t* msg)
+{
+    mavlink_file_transfer_protocol_t ftp;
+    mavlink_msg_file_transfer_protocol_decode(msg, &ftp);
+    ftpHeader request;
+    memcpy(&request, ftp.payload, sizeof(request));
+    switch(request.opcode) {
+        case FTP_OP_OPEN_RO:
+            vehicleFtpReply(msg, &request, 0, sizeof(ftpSize), false);
+            break;
+        case FTP_OP_READ:
+            if(request.offset < ftpSize) {
+                vehicleFtpReply(msg, &request, request.offset, min((uint32_t)FTP_DATA_LEN, ftpSize - request.offset), false);
+            }
+            break;
+        case FTP_OP_BURST_READ: {
+            uint32_t end = min(ftpSize, request.offset + REPLAY_FTP_BURST * FTP_DATA_LEN);
+            for(uint32_t ofs = request.offset; ofs < end; ofs += FTP_DATA_LEN) {
+                uint32_t size = min((uint32_t)FTP_DATA_LEN, end - ofs);
+                vehicleFtpReply(msg, &request, ofs, size, ofs + size >= end);
+            }
+            break;
+        }
+        case FTP_OP_TERMINATE:
+            vehicleFtpReply(msg, &request, 0, 0, false);
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- The autopilot's side of the mission protocol, answering whoever asks
+static void
+vehicleMission(mavlink_message_t* msg)
+{
+    uint8_t sys  = Vehicle.systemID();
+    uint8_t comp = Vehicle.componentID();
+    mavlink_message_t reply;
+    switch(msg->msgid) {
+        case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+            vehicleFtp(msg);
+            break;
+        case MAVLINK_MSG_ID_MISSION_COUNT: {
+            mavlink_mission_count_t cnt;
+            mavlink_msg_mission_count_decode(msg, &cnt);
+            vehicleMissionCount = cnt.count;
+            vehicleItems.clear();
+            mavlink_msg_mission_request_int_pack(sys, comp, &reply, msg->sysid, msg->compid, 0);
+            vehicleSend(&reply, REPLAY_FC_DELAY);
+            break;
+        }
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT: {
+            mavlink_mission_item_int_t item;
+            mavlink_msg_mission_item_int_decode(msg, &item);
+            if(item.seq != vehicleItems.size() || item.seq >= vehicleMissionCount) {
+                break;
+            }
+            vehicleItems.push_back(item);
+            if(vehicleItems.size() < vehicleMissionCount) {
+                mavlink_msg_mission_request_int_pack(sys, comp, &reply, msg->sysid, msg->compid, item.seq + 1);
+            } else {
+                mavlink_msg_mission_ack_pack(sys, comp, &reply, msg->sysid, msg->compid, MAV_MISSION_ACCEPTED);
+            }
+            vehicleSend(&reply, REPLAY_FC_DELAY);
+            break;
+        }
+        case MAVLINK_MSG_ID_LOG_REQUEST_DATA: {
+            //-- Streamed as fast as the UART goes
+            mavlink_log_request_data_t req;
+            mavlink_msg_log_request_data_decode(msg, &req);
+            uint32_t end = req.ofs + min(req.count, logSize - min(req.ofs, logSize));
+            for(uint32_t ofs = req.ofs; ofs < end; ofs += MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN) {
+                uint8_t data[MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN];
+                uint8_t count = min((uint32_t)MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN, end - ofs);
+                for(uint8_t i = 0; i < count; i++) {
+                    data[i] = logByte(ofs + i);
+                }
+                mavlink_msg_log_data_pack(sys, comp, &reply, req.id, ofs, count, data);
+                vehicleSend(&reply, REPLAY_FC_DELAY);
+                logVehicleBytes += count;
+            }
+            break;
+        }
+        case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+            mavlink_msg_mission_count_pack(sys, comp, &reply, msg->sysid, msg->compid, vehicleItems.size());
+            vehicleSend(&reply, REPLAY_FC_DELAY);
+            break;
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST: {
+            mavlink_mission_request_int_t req;
+            mavlink_msg_mission_request_int_decode(msg, &req);
+            if(req.seq < vehicleItems.size()) {
+                mavlink_mission_item_int_t item = vehicleItems[req.seq];
+                item.target_system    = msg->sysid;
+                item.target_component = msg->compid;
+                mavlink_msg_mission_item_int_encode(sys, comp, &reply, &item);
+                vehicleSend(&reply, REPLAY_FC_DELAY);
+            }
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- The autopilot answers with its parameters, as fast as the UART goes
+static void
+vehicleParams()
+{
+    for(uint16_t i = 0; i < paramCount; i++) {
+        mavlink_param_value_t param;
+        memset(&param, 0, sizeof(param));
+        snprintf(param.param_id, sizeof(param.param_id), "PARAM_%04u", i);
+        param.param_value = i;
+        param.param_count = paramCount;
+        param.param_index = i;
+        param.param_type  = MAV_PARAM_TYPE_REAL32;
+        mavlink_message_t msg;
+        mavlink_msg_param_value_encode(Vehicle.systemID(), Vehicle.componentID(), &msg, &param);
+        vehicleSend(&msg, 0);
+    }
+}
+
+//---------------------------------------------------------------------------------
+//-- Whatever the bridge writes to the vehicle UART
+static void
+vehicleReceive(const uint8_t* data, size_t len, uint64_t sentAt)
+{
+    uplinkStream.append((const char*)data, len);
+    size_t pos = 0;
+    while(pos < uplinkStream.length()) {
+        const uint8_t* frame = (const uint8_t*)uplinkStream.data() + pos;
+        if(frame[0] == 0xFE && uplinkStream.length() - pos < 2) {
+            //-- Need the length
+            break;
+        }
+        size_t flen = frameLength(frame, uplinkStream.length() - pos);
+        if(!flen) {
+            pos++;
+            continue;
+        }
+        if(pos + flen > uplinkStream.length()) {
+            break;
+        }
+        uplinkFrames++;
+        if(frame[5] == MAVLINK_MSG_ID_COMMAND_LONG && !commandsSent.empty()) {
+            commandLatency.push_back((uint32_t)(sentAt - commandsSent.front()));
+            commandsSent.pop_front();
+        }
+        if(frame[0] == 0xFE && frame[5] == MAVLINK_MSG_ID_PARAM_REQUEST_LIST && paramCount && !paramLists.empty()) {
+            paramLists.back().vehicle = true;
+            vehicleParams();
+        }
+        mavlink_message_t msg;
+        if((missionTest || logTest || ftpTest) && isMission(frame) && parseFrame(MAVLINK_COMM_0, frame, flen, &msg)) {
+            vehicleMission(&msg);
+        }
+        pos += flen;
+    }
+    uplinkStream.erase(0, pos);
+}
+
+//---------------------------------------------------------------------------------
+static void
+usage()
+{
+    fprintf(stderr,
+            "usage: replay [options] flight.tlog\n"
+            "  -s speed    Replay speed factor (default 1, 0 for as fast as the UART allows)\n"
+            "  -b baud     UART baud rate (default UART_BAUDRATE parameter)\n"
+            "  -V baud     Vehicle baud rate, if different (exercises rate detection)\n"
+            "  -r bytes    UART RX buffer size (default UART_RXBUF parameter)\n"
+            "  -B us       UART drain budget per pass (default UART_BUDGET parameter)\n"
+            "  -c ns       CPU time to read and parse one UART byte (default 1000)\n"
+            "  -l us       Time taken by the rest of each loop iteration (default 100)\n"
+            "  -m bytes    Largest datagram the UDP stack takes (default no limit)\n"
+            "  -f sends    UDP sends out of every 100 refused for lack of memory (default 0)\n"
+            "  -g          Send GCS heartbeats (1Hz) so the bridge unicasts, poll /telemetry.json as often\n"
+            "  -U frames   Send a burst of mission items and a command to the vehicle (1Hz)\n"
+            "  -P params   Vehicle with this many parameters, listed by the GCS every 5s (enables the file system)\n"
+            "  -M items    Write a mission of this many items to the vehicle and read it back (10ms WiFi each way)\n"
+            "  -X          Turn on the mission proxy (MISSION_PROXY)\n"
+            "  -L kbytes   Download an onboard log of this size, 32 chunks per request (10ms WiFi each way)\n"
+            "  -A          Turn on log read-ahead (LOG_READAHEAD)\n"
+            "  -T kbytes   Read a file of this size over MAVLink FTP, one reply in 40 lost over WiFi\n"
+            "  -n          Turn off FTP re-reads answered by the bridge (FTP_RESEND)\n"
+            "  -F mask     Fast lane messages (FAST_LANE)\n"
+            "  -D seconds  The GCS drops out 2s in for this long (use with -g and a low -s)\n"
+            "  -K seconds  Messages kept for the GCS while it is gone (GCS_BACKLOG, 0 off)\n"
+            "  -R          Replay with the bridge in raw (transparent) mode\n"
+            "  -w file     Write what the GCS received as a .tlog\n");
+    exit(1);
+}
+
+//---------------------------------------------------------------------------------
+int
+main(int argc, char* argv[])
+{
+    double   speed      = 1.0;
+    uint32_t baud       = 0;
+    uint32_t vehicleBaud = 0;
+    uint32_t rxBuffer   = 0;
+    uint32_t budget     = 0;
+    hostByteCost        = 1000;
+    uint32_t loopTime   = 100;
+    bool     heartbeat  = false;
+    int      burst      = 0;
+    bool     raw        = false;
+    bool     proxy      = false;
+    bool     readAhead  = false;
+    bool     ftpResend  = true;
+    uint16_t backlog    = DEFAULT_GCS_BACKLOG;
+    bool     setFastLane = false;
+    uint32_t fastLane   = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "s:b:V:r:B:c:l:m:f:gU:P:M:XL:AT:nF:D:K:Rw:")) != -1) {
+        switch(opt) {
+            case 's': speed    = atof(optarg); break;
+            case 'b': baud     = atoi(optarg); break;
+            case 'V': vehicleBaud = atoi(optarg); break;
+            case 'r': rxBuffer = atoi(optarg); break;
+            case 'B': budget   = atoi(optarg); break;
+            case 'c': hostByteCost = atoi(optarg); break;
+            case 'l': loopTime = atoi(optarg); break;
+            case 'm': WiFiUDP::hostTxLimit = atoi(optarg); break;
+            case 'f': WiFiUDP::hostFailRate = atoi(optarg); break;
+            case 'g': heartbeat = true; break;
+            case 'U': burst    = atoi(optarg); break;
+            case 'P':
+                paramCount = atoi(optarg);
+                FS::hostEnabled = paramCount > 0;
+                break;
+            case 'M':
+                missionItems = atoi(optarg);
+                missionTest  = missionItems ? MISSION_TEST_WAIT : MISSION_TEST_OFF;
+                break;
+            case 'X': proxy = true; break;
+            case 'L':
+                logSize = atoi(optarg) * 1024;
+                logTest = logSize ? MISSION_TEST_WAIT : MISSION_TEST_OFF;
+                break;
+            case 'A': readAhead = true; break;
+            case 'T':
+                ftpSize = atoi(optarg) * 1024;
+                ftpTest = ftpSize ? MISSION_TEST_WAIT : MISSION_TEST_OFF;
+                break;
+            case 'n': ftpResend = false; break;
+            case 'F': fastLane = strtoul(optarg, NULL, 0); setFastLane = true; break;
+            case 'D': dropEnd = REPLAY_DROP_START + (uint64_t)(atof(optarg) * 1000000); break;
+            case 'K': backlog = atoi(optarg); break;
+            case 'R': raw = true; break;
+            case 'w':
+                capture = fopen(optarg, "wb");
+                if(!capture) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage();
+        }
+    }
+    if(optind != argc - 1 || speed < 0 || !loopTime) {
+        usage();
+    }
+    if(!loadTlog(argv[optind])) {
+        fprintf(stderr, "%s: no frames\n", argv[optind]);
+        return 1;
+    }
+
+    //-- Bring up the bridge the same way setup() does
+    Logger.begin(2048);
+    Parameters.begin();
+    if(baud) {
+        Parameters.setUartBaudRate(baud);
+    }
+    if(rxBuffer) {
+        Parameters.setUartRxBuffer(rxBuffer);
+    }
+    if(budget) {
+        Parameters.setUartBudget(budget);
+    }
+    Parameters.setMissionProxy(proxy);
+    Parameters.setLogReadAhead(readAhead);
+    Parameters.setFtpResend(ftpResend);
+    Parameters.setGcsBacklog(backlog);
+    if(setFastLane) {
+        Parameters.setFastLane(fastLane);
+    }
+    WiFiUDP::hostSend = gcsReceive;
+    HardwareSerial::hostTx = vehicleReceive;
+    GCS.begin((MavESP8266Bridge*)&Vehicle, IPAddress(192, 168, 4, 255));
+    Vehicle.begin((MavESP8266Bridge*)&GCS);
+    ParamCache.begin();
+    Recorder.begin();
+    Scheduler.add("uart",    TASK_PRIORITY_DATA,   0,       Parameters.getUartBudget(), taskUart);
+    Scheduler.add("udp",     TASK_PRIORITY_DATA,   0,       Parameters.getUdpBudget(),  taskUdp);
+    Scheduler.add("flush",   TASK_PRIORITY_DATA,   0,       1000, taskFlush);
+    Scheduler.add("status",  TASK_PRIORITY_HIGH,   1000000, 500,  taskRadioStatus);
+    Scheduler.add("params",  TASK_PRIORITY_NORMAL, 0,       1000, taskParameters);
+    Scheduler.add("fcparams",TASK_PRIORITY_NORMAL, 0,       2000, taskParamCache);
+    Scheduler.add("mission", TASK_PRIORITY_NORMAL, 50000,   500,  taskMission);
+    Scheduler.add("logdata", TASK_PRIORITY_NORMAL, 0,       2000, taskLogData);
+    Scheduler.add("storage", TASK_PRIORITY_LOW,    0,       5000, taskStorage);
+    baud = Serial.baudRate();
+    if(!vehicleBaud) {
+        vehicleBaud = baud;
+    }
+    if(raw && !Component.enterRawMode()) {
+        fprintf(stderr, "Could not enter raw mode\n");
+        return 1;
+    }
+
+    //-- Time (ns) the UART needs for one byte (start + 8 data + stop bits)
+    const uint64_t byteTime  = 10000000000ULL / vehicleBaud;
+    const uint64_t startTime = frames[0].time;
+    uint64_t wire     = 0;      // When the UART finished the last byte (ns)
+    uint64_t lastByte = 0;
+    uint64_t nextBeat = 0;
+    uint64_t nextList = 0;
+    size_t   pi       = 0;
+    uint32_t overrunBytes = 0;
+    uint64_t sleptTime    = 0;
+    uint32_t sleeps       = 0;
+    size_t   fi = 0, bi = 0;
+    while(fi < frames.size() || !vehicleTx.empty() || Serial.available() || gcsMissionActive() || hostMicros < lastByte + REPLAY_DRAIN_TIME) {
+        //-- Frames the vehicle sends on its own go out between log frames
+        while(bi == 0 && !vehicleTx.empty()) {
+            uint64_t at = max(vehicleTxStart, wire) + byteTime;
+            if(at > hostMicros * 1000) {
+                break;
+            }
+            wire = at;
+            if(!Serial.inject(vehicleTx.front()[pi])) {
+                overrunBytes++;
+            }
+            if(++pi == vehicleTx.front().length()) {
+                vehicleTx.pop_front();
+                pi = 0;
+                lastByte = wire / 1000;
+            }
+        }
+        //-- Move whatever made it across the wire by now into the UART buffer
+        while(fi < frames.size() && (bi || vehicleTx.empty())) {
+            stFrame& frame = frames[fi];
+            uint64_t due = speed > 0 ? (uint64_t)((frame.time - startTime) * 1000.0 / speed) : 0;
+            uint64_t at  = max(due, wire) + byteTime;
+            if(at > hostMicros * 1000) {
+                break;
+            }
+            wire = at;
+            //-- Sampled at the wrong rate, bytes come out as garbage
+            uint8_t c = frame.data[bi];
+            if(Serial.baudRate() != vehicleBaud) {
+                c ^= 0xA5;
+            }
+            if(!Serial.inject(c)) {
+                frame.overrun = true;
+                overrunBytes++;
+            }
+            if(++bi == frame.data.length()) {
+                frame.arrived = wire / 1000;
+                lastByte = frame.arrived;
+                if(!frame.overrun) {
+                    inFlight[frame.key].push_back(fi);
+                }
+                fi++;
+                bi = 0;
+            }
+        }
+        if((heartbeat || burst) && hostMicros >= nextBeat) {
+            if(gcsDropped()) {
+                mavlink_message_t msg;
+                mavlink_msg_statustext_pack(Vehicle.systemID(), Vehicle.componentID(), &msg, MAV_SEVERITY_WARNING, "Replay warning");
+                vehicleSend(&msg, 0);
+                dropTexts++;
+            } else if(heartbeat) {
+                if(Vehicle.heardFrom()) {
+                    telemPolls++;
+                    if(Telemetry.version() == telemVersion) {
+                        telemUnchanged++;
+                    }
+                    telemVersion = Telemetry.version();
+                }
+                if(dropEnd && hostMicros >= dropEnd && !dropBack) {
+                    //-- Back. What was held while it was gone only comes in from the backlog.
+                    dropBack = true;
+                    inFlight.clear();
+                }
+                gcsHeartbeat();
+            }
+            if(burst) {
+                gcsUplink(burst);
+            }
+            nextBeat = hostMicros + 1000000;
+        }
+        if(paramCount && fi < frames.size() && Vehicle.heardFrom() && hostMicros >= nextList) {
+            gcsParamList();
+            nextList = hostMicros + REPLAY_PARAM_PERIOD;
+        }
+        if(missionTest || logTest || ftpTest) {
+            gcsMissionService();
+        }
+        Scheduler.run();
+        //-- Sleep like MavESP8266Events::idle() does, until the next byte is in, a
+        //   heartbeat is due or a link needs servicing
+        unsigned long idle = min(Scheduler.idleTime(), min(GCS.idleTime(), Vehicle.idleTime()));
+        idle = min(idle / 1000, (unsigned long)EVENT_MAX_SLEEP) * 1000;
+        if(idle) {
+            uint64_t until = hostMicros + idle;
+            if(!vehicleTx.empty()) {
+                until = min(until, (max(vehicleTxStart, wire) + byteTime) / 1000 + REPLAY_WAKE_LATENCY);
+            } else if(fi < frames.size()) {
+                uint64_t due = speed > 0 ? (uint64_t)((frames[fi].time - startTime) * 1000.0 / speed) : 0;
+                until = min(until, (max(due, wire) + byteTime) / 1000 + REPLAY_WAKE_LATENCY);
+            }
+            if(heartbeat || burst) {
+                until = min(until, nextBeat + REPLAY_WAKE_LATENCY);
+            }
+            if(paramCount && fi < frames.size() && Vehicle.heardFrom()) {
+                until = min(until, nextList + REPLAY_WAKE_LATENCY);
+            }
+            if(!gcsOutbox.empty()) {
+                until = min(until, gcsOutbox.front().first + REPLAY_WAKE_LATENCY);
+            } else if(gcsMissionActive()) {
+                until = min(until, gcsLastTime + REPLAY_GCS_TIMEOUT + REPLAY_WAKE_LATENCY);
+            }
+            if(until > hostMicros) {
+                sleptTime += until - hostMicros;
+                sleeps++;
+                hostAdvance(until - hostMicros);
+                continue;
+            }
+        }
+        hostAdvance(loopTime);
+    }
+    if(capture) {
+        fclose(capture);
+    }
+
+    //-- Report
+    uint32_t overrunFrames = 0, lost = 0;
+    uint64_t bytesIn = 0;
+    for(size_t i = 0; i < frames.size(); i++) {
+        bytesIn += frames[i].data.length();
+        if(frames[i].overrun) {
+            overrunFrames++;
+        } else if(!frames[i].forwarded) {
+            lost++;
+        }
+    }
+    //-- Rates are over the time data was coming in, not the drain time at the end
+    double seconds = max(lastByte, (uint64_t)1) / 1000000.0;
+    printf("Replayed %u frames (%llu bytes) in %.2f s at %gx speed, %u baud\n",
+           (unsigned)frames.size(), (unsigned long long)bytesIn, seconds, speed, vehicleBaud);
+    if(Serial.baudRate() != baud || vehicleBaud != baud) {
+        printf("Baud rate:  %lu at the end%s\n", Serial.baudRate(), Vehicle.detectingBaud() ? " (still detecting)" : "");
+    }
+    printf("Idle:       %.1f%% of the time asleep (%u sleeps)\n",
+           hostMicros ? sleptTime * 100.0 / hostMicros : 0.0, sleeps);
+    printf("UART:       %u bytes overrun (%u frames, %u seen by the bridge), %.1f kB/s in\n",
+           overrunBytes, overrunFrames, Vehicle.getStatus()->uart_overruns, bytesIn / seconds / 1024.0);
+    printf("Budget:     %u UART and %u UDP drains cut short\n",
+           Vehicle.getStatus()->budget_exhausted, GCS.getStatus()->budget_exhausted);
+    printf("Forwarded:  %u frames, %u not forwarded, %u from the bridge itself\n",
+           (unsigned)latencies.size(), lost, framesBridge);
+    printf("Datagrams:  %u (%llu bytes, %.1f kB/s, %.1f bytes and %.1f frames on average)\n",
+           datagrams, (unsigned long long)datagramBytes, datagramBytes / seconds / 1024.0,
+           datagrams ? (double)datagramBytes / datagrams : 0.0,
+           datagrams ? (double)framesOut / datagrams : 0.0);
+    if(GCS.getStatus()->discovery_held) {
+        printf("Discovery:  %u frames held back while no GCS was heard (-g to stream them)\n",
+               GCS.getStatus()->discovery_held);
+    }
+    if(burst) {
+        printf("Uplink:     %u frames to the vehicle, queue peak %u bytes, %u ms waiting on the UART, %u dropped, %llu ms blocked in write()\n",
+               uplinkFrames, Vehicle.uplinkPeak(), Vehicle.uplinkStallTime(), Vehicle.uplinkDropped(),
+               (unsigned long long)(Serial.txBlocked() / 1000));
+        uint64_t total = 0;
+        uint32_t worst = 0;
+        for(size_t i = 0; i < commandLatency.size(); i++) {
+            total += commandLatency[i];
+            worst  = max(worst, commandLatency[i]);
+        }
+        printf("Commands:   %u sent, %u delivered, avg %llu us, max %u us from the GCS to the vehicle\n",
+               (unsigned)(commandLatency.size() + commandsSent.size()), (unsigned)commandLatency.size(),
+               (unsigned long long)(commandLatency.empty() ? 0 : total / commandLatency.size()), worst);
+    }
+    if(paramCount) {
+        uint32_t lists[2] = { 0, 0 }, incomplete = 0;
+        uint64_t total[2] = { 0, 0 };
+        for(size_t i = 0; i < paramLists.size(); i++) {
+            if(!paramLists[i].done) {
+                incomplete++;
+                continue;
+            }
+            lists[paramLists[i].vehicle]++;
+            total[paramLists[i].vehicle] += paramLists[i].done - paramLists[i].sent;
+        }
+        printf("Params:     %u lists of %u, %u from the vehicle (avg %.1f ms), %u from the cache (avg %.1f ms), %u incomplete\n",
+               (unsigned)paramLists.size(), paramCount,
+               lists[1], lists[1] ? total[1] / 1000.0 / lists[1] : 0.0,
+               lists[0], lists[0] ? total[0] / 1000.0 / lists[0] : 0.0, incomplete);
+        printf("Cache:      state %u, %u/%u fresh, %u records, %u served, %u dropped\n",
+               ParamCache.state(), ParamCache.freshCount(), ParamCache.paramCount(), ParamCache.logRecords(),
+               ParamCache.paramsServed(), ParamCache.recordsDropped());
+    }
+    if(missionItems) {
+        static const char* results[] = { "off", "vehicle not heard", "write incomplete", "read incomplete", "ok", "failed" };
+        printf("Mission:    %u items, written in %.1f ms, read in %.1f ms (%s), %u GCS timeouts, vehicle has %u%s\n",
+               missionItems, missionTimes[0] / 1000.0, missionTimes[1] / 1000.0, results[missionTest], missionResent,
+               (unsigned)vehicleItems.size(), Parameters.getMissionProxy() ? ", proxied" : "");
+        if(Parameters.getMissionProxy()) {
+            printf("Proxy:      %u read, %u written, %u failed, last %u ms\n",
+                   Mission.downloads(), Mission.uploads(), Mission.failures(), Mission.lastTransfer());
+        }
+    }
+    if(logSize) {
+        static const char* results[] = { "off", "vehicle not heard", "", "incomplete", "ok", "failed" };
+        printf("Log:        %u of %u bytes in %.1f ms (%.1f kB/s, %s), %u bad bytes, %u GCS timeouts, %u bytes from the vehicle%s\n",
+               logNext, logSize, logTime / 1000.0, logTime ? logNext * 1000.0 / logTime : 0.0, results[logTest],
+               logBadBytes, logResent, logVehicleBytes, Parameters.getLogReadAhead() ? ", read ahead" : "");
+        if(Parameters.getLogReadAhead()) {
+            printf("Read-ahead: %u requests from the GCS, %u found in RAM, %u to the vehicle, %u bytes served\n",
+                   LogData.requests(), LogData.fromWindow(), LogData.vehicleRequests(), LogData.bytesServed());
+        }
+    }
+    if(ftpSize) {
+        static const char* results[] = { "off", "vehicle not heard", "", "incomplete", "ok", "failed" };
+        printf("FTP:        %u bytes in %.1f ms (%.1f kB/s, %s), %u bad bytes, %u lost over WiFi, %u re-reads, %u GCS timeouts, %u bytes from the vehicle\n",
+               ftpSize, ftpTime / 1000.0, ftpTime ? ftpSize * 1000.0 / ftpTime : 0.0, results[ftpTest],
+               ftpBadBytes, ftpLost, ftpRereads, ftpResent, ftpVehicleBytes);
+        ftpSession* session = Ftp.getSession(0);
+        if(session) {
+            printf("Session:    %s, %u bytes, %u messages, %u bursts, %u gaps, %u resent by the bridge\n",
+                   session->path, session->bytes, session->messages, session->bursts, session->gaps, session->resent);
+        }
+    }
+    if(dropEnd) {
+        MavESP8266Backlog* kept = GCS.backlog();
+        printf("Dropout:    %.1f s, %u datagrams lost, %u of %u STATUSTEXT reached the GCS after it came back (the last %.1f ms after), %u older frames\n",
+               (dropEnd - REPLAY_DROP_START) / 1000000.0, dropDatagrams, dropTextsSeen, dropTexts, dropTextLast / 1000.0, dropFrames);
+        printf("Backlog:    %u kept, %u sent, %u dropped%s\n", kept->kept(), kept->sent(), kept->dropped(),
+               Parameters.getGcsBacklog() ? "" : " (off)");
+    }
+    if(telemPolls) {
+        printf("Telemetry:  %u changes, polled every second: %u of %u polls unchanged (304)\n",
+               Telemetry.version(), telemUnchanged, telemPolls);
+    }
+    udpSendFailures* failures = GCS.sendFailures();
+    if(failures->no_pbuf || failures->stack_full || failures->arp_pending || failures->short_write || failures->errors) {
+        printf("Send fails: %u no pbuf, %u stack full, %u ARP pending, %u short, %u other; %u retries, %u messages given up\n",
+               failures->no_pbuf, failures->stack_full, failures->arp_pending, failures->short_write, failures->errors,
+               GCS.getStatus()->send_retries, GCS.getStatus()->send_abandoned);
+    }
+    printf("Broadcast:  %u datagrams (%llu bytes, %.2f%% of all bytes sent)\n",
+           broadcasts, (unsigned long long)broadcastBytes,
+           (datagramBytes + broadcastBytes) ? broadcastBytes * 100.0 / (datagramBytes + broadcastBytes) : 0.0);
+    for(int i = 0; i < REPLAY_HISTOGRAM_SIZE; i++) {
+        if(histogram[i]) {
+            printf("  %4u-%-4u  %u\n", i * REPLAY_HISTOGRAM_STEP, (i + 1) * REPLAY_HISTOGRAM_STEP - 1, histogram[i]);
+        }
+    }
+    if(!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        uint64_t total = 0;
+        for(size_t i = 0; i < latencies.size(); i++) {
+            total += latencies[i];
+        }
+        size_t n = latencies.size();
+        printf("Latency:    avg %llu us, p50 %u us, p95 %u us, p99 %u us, max %u us\n",
+               (unsigned long long)(total / n), latencies[n / 2], latencies[(n * 95) / 100],
+               latencies[(n * 99) / 100], latencies[n - 1]);
+    }
+    if(!fastLatencies.empty()) {
+        std::sort(fastLatencies.begin(), fastLatencies.end());
+        size_t n = fastLatencies.size();
+        printf("Fast lane:  %u frames, p50 %u us, p99 %u us, max %u us from the UART to the GCS\n",
+               (unsigned)n, fastLatencies[n / 2], fastLatencies[(n * 99) / 100], fastLatencies[n - 1]);
+    }
+    printHistogram("  to GCS    ", &GCS.getStatus()->fast_latency);
+    printHistogram("  to vehicle", &Vehicle.getStatus()->fast_latency);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file Arduino.h
+ * Host stand-in for the parts of the ESP8266 Arduino core used by the bridge.
+ * Time only moves when the replay harness advances it.
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_HOST_ARDUINO_H
+#define MAVESP8266_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <string>
+
+typedef uint8_t     uint8;
+typedef uint16_t    uint16;
+typedef uint32_t    uint32;
+typedef int8_t      sint8;
+
+#define PROGMEM
+#define ICACHE_RAM_ATTR
+#define PGM_P       const char*
+class __FlashStringHelper;
+#define FPSTR(p)    (reinterpret_cast<const __FlashStringHelper *>(p))
+#define F(s)        FPSTR(s)
+
+//-- Same as the 2.x core
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+//---------------------------------------------------------------------------------
+//-- Simulated clock
+extern uint64_t     hostMicros;
+void                hostAdvance     (uint64_t us);
+void                hostCharge      (uint32_t ns);  // CPU time spent by the bridge
+extern uint32_t     hostByteCost;                   // CPU time (ns) per UART byte read
+
+unsigned long       millis          ();
+unsigned long       micros          ();
+void                delay           (unsigned long ms);
+void                delayMicroseconds(unsigned int us);
+void                yield           ();
+
+int                 ets_vsnprintf   (char* buffer, size_t size, const char* format, va_list arg);
+
+//---------------------------------------------------------------------------------
+//-- Pins and UART registers (writes are accepted and otherwise ignored)
+#define INPUT               0x00
+#define OUTPUT              0x01
+#define INPUT_PULLUP        0x02
+#define FUNCTION_4          0xC0
+void                pinMode         (uint8_t pin, uint8_t mode);
+
+extern uint32_t     hostUartRegs[2][3];
+#define USC0(u)             hostUartRegs[(u) & 1][0]
+#define USC1(u)             hostUartRegs[(u) & 1][1]
+#define USIE(u)             hostUartRegs[(u) & 1][2]
+#define UCTXHFE             15
+#define UCRXHFT             16
+#define UCRXHFE             23
+#define UIFF                0
+#define UITO                8
+
+extern uint32_t     hostGpioRegs[17];
+extern uint32_t     hostGpioStatus;
+#define GPC(p)              hostGpioRegs[(p) & 15]
+#define GPIEC               hostGpioStatus
+#define GPCI                7
+#define CHANGE              3
+void                attachInterrupt (uint8_t pin, void (*handler)(), int mode);
+#define noInterrupts()
+#define interrupts()
+
+//---------------------------------------------------------------------------------
+class String {
+public:
+    String                  (const char* s = "") : _s(s ? s : "") {}
+    String                  (const std::string& s) : _s(s) {}
+    String&     operator += (const String& s)   { _s += s._s; return *this; }
+    String&     operator += (const char* s)     { _s += s; return *this; }
+    String&     operator += (char c)            { _s += c; return *this; }
+    bool        operator == (const char* s) const { return _s == s; }
+    const char* c_str       () const            { return _s.c_str(); }
+    unsigned    length      () const            { return _s.length(); }
+    long        toInt       () const            { return atol(_s.c_str()); }
+private:
+    std::string _s;
+};
+
+//---------------------------------------------------------------------------------
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t  write   (uint8_t c) = 0;
+    virtual size_t  write   (const uint8_t* buffer, size_t size);
+    size_t  print           (const char* s);
+    size_t  print           (long n);
+    size_t  print           (unsigned long n);
+    size_t  print           (int n)             { return print((long)n); }
+    size_t  print           (unsigned int n)    { return print((unsigned long)n); }
+    template <typename T>
+    size_t  println         (T v)               { size_t n = print(v); return n + print("\n"); }
+    size_t  println         ()                  { return print("\n"); }
+};
+
+//---------------------------------------------------------------------------------
+//-- UART. The harness plays the other end of the wire through inject().
+class HardwareSerial : public Print {
+public:
+    HardwareSerial          ();
+    void    begin           (unsigned long baud)    { _baud = baud; }
+    void    end             ()                      { }
+    void    swap            ()                      { }
+    void    flush           ()                      { }
+    void    updateBaudRate  (unsigned long baud)    { _baud = baud; }
+    unsigned long baudRate  ()                      { return _baud; }
+    size_t  setRxBufferSize (size_t size);
+    int     available       ();
+    int     peek            ();
+    int     read            ();
+    size_t  readBytes       (uint8_t* buffer, size_t size);
+    size_t  write           (uint8_t c);
+    size_t  write           (const uint8_t* buffer, size_t size);
+    int     availableForWrite();
+    bool    hasOverrun      ();
+    bool    hasRxError      ()                      { return false; }
+    //-- Host side
+    bool    inject          (uint8_t c);    // False if the RX buffer was full (byte lost)
+    uint32_t txBytes        ()                      { return _tx_bytes; }
+    uint64_t txBlocked      ()                      { return _tx_blocked; }
+    static void (*hostTx)(const uint8_t* data, size_t len, uint64_t sentAt); // sentAt: last byte on the wire (us)
+private:
+    uint32_t _txLevel       ();
+    std::string     _rx;
+    size_t          _rx_head;
+    size_t          _rx_size;
+    bool            _overrun;
+    unsigned long   _baud;
+    uint32_t        _tx_bytes;
+    uint64_t        _tx_done;       // When the TX FIFO will be empty (ns)
+    uint64_t        _tx_blocked;    // Time (us) write() spent waiting for FIFO room
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+//---------------------------------------------------------------------------------
+class EspClass {
+public:
+    void        reset               ();
+    void        restart             ();
+    uint32_t    getFreeHeap         ()  { return 40 * 1024; }
+    uint32_t    getFreeSketchSpace  ()  { return 512 * 1024; }
+};
+
+extern EspClass ESP;
+
+#endif
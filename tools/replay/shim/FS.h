@@ -0,0 +1,98 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file FS.h
+ * Host stand-in for the ESP8266 Arduino core. Files are kept in memory and
+ * only exist when FS::hostEnabled is set (see -P), otherwise begin() fails
+ * and the telemetry log and parameter cache stay disabled during a replay.
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_HOST_FS_H
+#define MAVESP8266_HOST_FS_H
+
+#include "Arduino.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+struct FSInfo {
+    size_t totalBytes;
+    size_t usedBytes;
+    size_t blockSize;
+    size_t pageSize;
+    size_t maxOpenFiles;
+    size_t maxPathLength;
+};
+
+typedef std::shared_ptr<std::string> HostFile;
+
+class File {
+public:
+    File        () : _pos(0) {}
+    File        (HostFile data, size_t pos) : _data(data), _pos(pos) {}
+    operator bool           () const    { return (bool)_data; }
+    int         read        ();
+    size_t      read        (uint8_t* buf, size_t len);
+    size_t      write       (uint8_t c) { return write(&c, 1); }
+    size_t      write       (const uint8_t* buf, size_t len);
+    bool        seek        (uint32_t pos, SeekMode mode = SeekSet);
+    size_t      size        () const    { return _data ? _data->length() : 0; }
+    void        flush       ()          { }
+    void        close       ()          { _data.reset(); }
+private:
+    HostFile    _data;
+    size_t      _pos;
+};
+
+class FS {
+public:
+    bool        begin       ()          { return hostEnabled; }
+    bool        info        (FSInfo& info);
+    File        open        (const char* path, const char* mode);
+    bool        remove      (const char* path) { return _files.erase(path) > 0; }
+    bool        rename      (const char* from, const char* to);
+    static bool hostEnabled;
+private:
+    std::map<std::string, HostFile> _files;
+};
+
+extern FS SPIFFS;
+
+#endif
@@ -0,0 +1,64 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file IPAddress.h
+ * Host stand-in for the ESP8266 Arduino core.
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_HOST_IPADDRESS_H
+#define MAVESP8266_HOST_IPADDRESS_H
+
+#include "Arduino.h"
+
+class IPAddress {
+public:
+    IPAddress               ()                  { _a.dword = 0; }
+    IPAddress               (uint32_t address)  { _a.dword = address; }
+    IPAddress               (uint8_t a, uint8_t b, uint8_t c, uint8_t d) { _a.bytes[0] = a; _a.bytes[1] = b; _a.bytes[2] = c; _a.bytes[3] = d; }
+    operator uint32_t       () const            { return _a.dword; }
+    uint8_t  operator[]     (int index) const   { return _a.bytes[index]; }
+    uint8_t& operator[]     (int index)         { return _a.bytes[index]; }
+    String   toString       () const
+    {
+        char s[16];
+        snprintf(s, sizeof(s), "%u.%u.%u.%u", _a.bytes[0], _a.bytes[1], _a.bytes[2], _a.bytes[3]);
+        return String(s);
+    }
+private:
+    union {
+        uint8_t  bytes[4];
+        uint32_t dword;
+    } _a;
+};
+
+#endif
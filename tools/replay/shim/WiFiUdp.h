@@ -0,0 +1,76 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file WiFiUdp.h
+ * Host stand-in for the ESP8266 Arduino core. Datagrams sent are handed to
+ * hostSend and datagrams are received from what the harness queues with
+ * hostInject().
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_HOST_WIFIUDP_H
+#define MAVESP8266_HOST_WIFIUDP_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiUDP {
+public:
+    WiFiUDP                 ();
+    uint8_t     begin       (uint16_t port)     { _port = port; return 1; }
+    int         parsePacket ();
+    int         available   ()                  { return _in.length() - _in_pos; }
+    int         read        ();
+    int         read        (unsigned char* buffer, size_t len);
+    int         beginPacket (IPAddress ip, uint16_t port);
+    size_t      write       (uint8_t c)         { return write(&c, 1); }
+    size_t      write       (const uint8_t* buffer, size_t size);
+    int         endPacket   ();
+    IPAddress   remoteIP    ()                  { return _remote_ip; }
+    uint16_t    remotePort  ()                  { return _remote_port; }
+    //-- Host side
+    static void (*hostSend) (IPAddress ip, uint16_t port, const uint8_t* data, size_t len);
+    static size_t hostTxLimit;  // Largest datagram the stack would take (0 for no limit)
+    static int  hostFailRate;   // Sends out of every 100 refused for lack of memory, in a row
+    static void hostInject  (uint16_t port, IPAddress from, uint16_t fromPort, const uint8_t* data, size_t len);
+private:
+    uint16_t    _port;
+    std::string _in;
+    size_t      _in_pos;
+    IPAddress   _remote_ip;
+    uint16_t    _remote_port;
+    std::string _out;
+    IPAddress   _out_ip;
+    uint16_t    _out_port;
+};
+
+#endif
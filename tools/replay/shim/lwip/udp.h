@@ -0,0 +1,102 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file lwip/udp.h
+ * Host stand-in for the parts of lwIP (2.x API) used by the bridge. Bound PCBs
+ * receive what the harness queues with WiFiUDP::hostInject().
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_HOST_LWIP_UDP_H
+#define MAVESP8266_HOST_LWIP_UDP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LWIP_VERSION_MAJOR  2
+
+typedef int8_t      err_t;
+typedef uint8_t     u8_t;
+typedef uint16_t    u16_t;
+
+#define ERR_OK              0
+#define ERR_MEM             -1
+#define ERR_BUF             -2
+#define ERR_VAL             -6
+#define ERR_USE             -8
+
+struct ip4_addr { uint32_t addr; };
+typedef struct ip4_addr ip4_addr_t;
+typedef ip4_addr_t      ip_addr_t;
+
+#define IP_ADDR_ANY                 ((ip_addr_t*)NULL)
+#define ip_2_ip4(a)                 (a)
+#define ip4_addr_get_u32(a)         ((a)->addr)
+#define ip_addr_set_ip4_u32(a, v)   ((a)->addr = (v))
+#define ip4_addr_set_u32(a, v)      ((a)->addr = (v))
+
+//-- Packet buffers (always PBUF_RAM)
+struct pbuf {
+    struct pbuf*    next;
+    void*           payload;
+    u16_t           tot_len;
+    u16_t           len;
+};
+
+typedef enum { PBUF_TRANSPORT } pbuf_layer;
+typedef enum { PBUF_RAM } pbuf_type;
+
+struct pbuf*    pbuf_alloc      (pbuf_layer layer, u16_t length, pbuf_type type);
+u8_t            pbuf_free       (struct pbuf* p);
+void            pbuf_realloc    (struct pbuf* p, u16_t size);
+
+//-- UDP
+struct udp_pcb;
+typedef void (*udp_recv_fn)(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port);
+
+struct udp_pcb {
+    u8_t            so_options;
+    u16_t           local_port;
+    udp_recv_fn     recv;
+    void*           recv_arg;
+};
+
+#define SOF_BROADCAST               0x20
+#define ip_set_option(pcb, opt)     ((pcb)->so_options |= (opt))
+
+struct udp_pcb* udp_new         ();
+void            udp_remove      (struct udp_pcb* pcb);
+err_t           udp_bind        (struct udp_pcb* pcb, const ip_addr_t* ipaddr, u16_t port);
+void            udp_recv        (struct udp_pcb* pcb, udp_recv_fn recv, void* recv_arg);
+err_t           udp_sendto      (struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* dst_ip, u16_t dst_port);
+
+#endif
@@ -0,0 +1,587 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file shim.cpp
+ * Host stand-in for the parts of the ESP8266 Arduino core used by the bridge.
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#include <deque>
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "FS.h"
+#include "WiFiUdp.h"
+extern "C" {
+    #include "user_interface.h"
+}
+
+extern "C" {
+#include "lwip/udp.h"
+#include "netif/etharp.h"
+}
+
+uint64_t        hostMicros = 0;
+HardwareSerial  Serial;
+HardwareSerial  Serial1;
+EspClass        ESP;
+EEPROMClass     EEPROM;
+FS              SPIFFS;
+uint32_t        hostUartRegs[2][3];
+uint32_t        hostGpioRegs[17];
+uint32_t        hostGpioStatus;
+
+//---------------------------------------------------------------------------------
+void            hostAdvance         (uint64_t us)   { hostMicros += us; }
+uint32_t        hostByteCost        = 0;
+static uint32_t hostNanos           = 0;
+
+void
+hostCharge(uint32_t ns)
+{
+    hostNanos  += ns;
+    hostMicros += hostNanos / 1000;
+    hostNanos  %= 1000;
+}
+unsigned long   millis              ()              { return (unsigned long)(hostMicros / 1000); }
+unsigned long   micros              ()              { return (unsigned long)hostMicros; }
+void            delay               (unsigned long ms) { hostAdvance((uint64_t)ms * 1000); }
+void            delayMicroseconds   (unsigned int us) { hostAdvance(us); }
+void            yield               ()              { }
+
+void            pinMode             (uint8_t pin, uint8_t mode) { }
+void            attachInterrupt     (uint8_t pin, void (*handler)(), int mode) { }
+extern "C" void esp_schedule        () { }
+
+int
+ets_vsnprintf(char* buffer, size_t size, const char* format, va_list arg)
+{
+    return vsnprintf(buffer, size, format, arg);
+}
+
+//---------------------------------------------------------------------------------
+void
+EspClass::reset()
+{
+    fprintf(stderr, "Bridge asked for a reset\n");
+    exit(1);
+}
+
+void
+EspClass::restart()
+{
+    reset();
+}
+
+//---------------------------------------------------------------------------------
+size_t
+Print::write(const uint8_t* buffer, size_t size)
+{
+    size_t n = 0;
+    while(size--) {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t
+Print::print(const char* s)
+{
+    return write((const uint8_t*)s, strlen(s));
+}
+
+size_t
+Print::print(long n)
+{
+    char s[24];
+    snprintf(s, sizeof(s), "%ld", n);
+    return print(s);
+}
+
+size_t
+Print::print(unsigned long n)
+{
+    char s[24];
+    snprintf(s, sizeof(s), "%lu", n);
+    return print(s);
+}
+
+//---------------------------------------------------------------------------------
+HardwareSerial::HardwareSerial()
+    : _rx_head(0)
+    , _rx_size(256)     // Core default
+    , _overrun(false)
+    , _baud(115200)
+    , _tx_bytes(0)
+    , _tx_done(0)
+    , _tx_blocked(0)
+{
+}
+
+void (*HardwareSerial::hostTx)(const uint8_t* data, size_t len, uint64_t sentAt) = NULL;
+
+//---------------------------------------------------------------------------------
+//-- The TX FIFO (128 bytes) empties at the wire rate
+#define HOST_UART_TX_FIFO   128
+
+uint32_t
+HardwareSerial::_txLevel()
+{
+    uint64_t now = hostMicros * 1000;
+    if(_tx_done <= now) {
+        return 0;
+    }
+    uint64_t byteTime = 10000000000ULL / _baud;
+    return (uint32_t)((_tx_done - now + byteTime - 1) / byteTime);
+}
+
+int
+HardwareSerial::availableForWrite()
+{
+    return HOST_UART_TX_FIFO - min(_txLevel(), (uint32_t)HOST_UART_TX_FIFO);
+}
+
+size_t
+HardwareSerial::setRxBufferSize(size_t size)
+{
+    _rx_size = size;
+    return size;
+}
+
+int
+HardwareSerial::available()
+{
+    return _rx.length() - _rx_head;
+}
+
+int
+HardwareSerial::peek()
+{
+    return available() ? (uint8_t)_rx[_rx_head] : -1;
+}
+
+int
+HardwareSerial::read()
+{
+    if(!available()) {
+        return -1;
+    }
+    uint8_t c = _rx[_rx_head++];
+    hostCharge(hostByteCost);
+    if(_rx_head == _rx.length()) {
+        _rx.clear();
+        _rx_head = 0;
+    }
+    return c;
+}
+
+size_t
+HardwareSerial::readBytes(uint8_t* buffer, size_t size)
+{
+    size_t n = 0;
+    while(n < size && available()) {
+        buffer[n++] = read();
+    }
+    return n;
+}
+
+size_t
+HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+//-- Like the core, spins until the FIFO has room for everything
+size_t
+HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    uint64_t byteTime = 10000000000ULL / _baud;
+    uint64_t now      = hostMicros * 1000;
+    uint32_t level    = _txLevel();
+    if(level + size > HOST_UART_TX_FIFO) {
+        uint64_t wait = (level + size - HOST_UART_TX_FIFO) * byteTime;
+        _tx_blocked += wait / 1000;
+        hostMicros  += wait / 1000;
+    }
+    _tx_done = max(_tx_done, now) + size * byteTime;
+    _tx_bytes += size;
+    if(hostTx) {
+        hostTx(buffer, size, _tx_done / 1000);
+    }
+    return size;
+}
+
+bool
+HardwareSerial::hasOverrun()
+{
+    bool overrun = _overrun;
+    _overrun = false;
+    return overrun;
+}
+
+bool
+HardwareSerial::inject(uint8_t c)
+{
+    if((size_t)available() >= _rx_size) {
+        _overrun = true;
+        return false;
+    }
+    _rx += (char)c;
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- In-memory SPIFFS, the size of a 1MB partition
+bool FS::hostEnabled = false;
+
+bool
+FS::info(FSInfo& info)
+{
+    memset(&info, 0, sizeof(info));
+    if(!hostEnabled) {
+        return false;
+    }
+    info.totalBytes = 1024 * 1024;
+    for(std::map<std::string, HostFile>::iterator i = _files.begin(); i != _files.end(); ++i) {
+        info.usedBytes += i->second->length();
+    }
+    info.blockSize    = 8192;
+    info.pageSize     = 256;
+    info.maxOpenFiles = 5;
+    info.maxPathLength = 32;
+    return true;
+}
+
+File
+FS::open(const char* path, const char* mode)
+{
+    if(!hostEnabled) {
+        return File();
+    }
+    std::map<std::string, HostFile>::iterator i = _files.find(path);
+    if(mode[0] == 'r') {
+        return i == _files.end() ? File() : File(i->second, 0);
+    }
+    if(i == _files.end() || mode[0] == 'w') {
+        //-- Handles still open keep the old contents
+        HostFile data(new std::string());
+        _files[path] = data;
+        return File(data, 0);
+    }
+    return File(i->second, i->second->length());
+}
+
+bool
+FS::rename(const char* from, const char* to)
+{
+    std::map<std::string, HostFile>::iterator i = _files.find(from);
+    if(i == _files.end() || _files.count(to)) {
+        return false;
+    }
+    _files[to] = i->second;
+    _files.erase(i);
+    return true;
+}
+
+int
+File::read()
+{
+    uint8_t c;
+    return read(&c, 1) ? c : -1;
+}
+
+size_t
+File::read(uint8_t* buf, size_t len)
+{
+    if(!_data || _pos >= _data->length()) {
+        return 0;
+    }
+    len = min(len, _data->length() - _pos);
+    memcpy(buf, _data->data() + _pos, len);
+    _pos += len;
+    return len;
+}
+
+size_t
+File::write(const uint8_t* buf, size_t len)
+{
+    if(!_data) {
+        return 0;
+    }
+    _data->replace(_pos, len, (const char*)buf, len);
+    _pos += len;
+    return len;
+}
+
+bool
+File::seek(uint32_t pos, SeekMode mode)
+{
+    if(!_data) {
+        return false;
+    }
+    size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? _pos : _data->length());
+    if(base + pos > _data->length()) {
+        return false;
+    }
+    _pos = base + pos;
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+//-- Associated stations. The GCS is the only one and has 192.168.4.2.
+static struct station_info hostStation = { { NULL }, { 0x02, 0, 0, 0, 0, 0x01 }, { (uint32_t)IPAddress(192, 168, 4, 2) } };
+
+struct station_info*
+wifi_softap_get_station_info(void)
+{
+    return &hostStation;
+}
+
+//---------------------------------------------------------------------------------
+struct HostDatagram {
+    uint16_t    port;
+    IPAddress   from;
+    uint16_t    fromPort;
+    std::string data;
+};
+
+static std::deque<HostDatagram> hostInbound;
+
+void  (*WiFiUDP::hostSend)(IPAddress ip, uint16_t port, const uint8_t* data, size_t len) = NULL;
+size_t WiFiUDP::hostTxLimit = 0;
+int    WiFiUDP::hostFailRate = 0;
+
+WiFiUDP::WiFiUDP()
+    : _port(0)
+    , _in_pos(0)
+    , _remote_port(0)
+    , _out_port(0)
+{
+}
+
+//---------------------------------------------------------------------------------
+//-- lwIP. A pbuf and its payload are one allocation.
+static std::deque<struct udp_pcb*> hostPcbs;
+
+struct pbuf*
+pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type)
+{
+    struct pbuf* p = (struct pbuf*)malloc(sizeof(struct pbuf) + length);
+    p->next     = NULL;
+    p->payload  = p + 1;
+    p->tot_len  = length;
+    p->len      = length;
+    return p;
+}
+
+u8_t
+pbuf_free(struct pbuf* p)
+{
+    u8_t count = 0;
+    while(p) {
+        struct pbuf* next = p->next;
+        free(p);
+        p = next;
+        count++;
+    }
+    return count;
+}
+
+void
+pbuf_realloc(struct pbuf* p, u16_t size)
+{
+    //-- Shrink only, like lwIP
+    if(size < p->len) {
+        p->len     = size;
+        p->tot_len = size;
+    }
+}
+
+struct udp_pcb*
+udp_new()
+{
+    return (struct udp_pcb*)calloc(1, sizeof(struct udp_pcb));
+}
+
+void
+udp_remove(struct udp_pcb* pcb)
+{
+    for(std::deque<struct udp_pcb*>::iterator i = hostPcbs.begin(); i != hostPcbs.end(); i++) {
+        if(*i == pcb) {
+            hostPcbs.erase(i);
+            break;
+        }
+    }
+    free(pcb);
+}
+
+err_t
+udp_bind(struct udp_pcb* pcb, const ip_addr_t* ipaddr, u16_t port)
+{
+    for(std::deque<struct udp_pcb*>::iterator i = hostPcbs.begin(); i != hostPcbs.end(); i++) {
+        if((*i)->local_port == port) {
+            return ERR_USE;
+        }
+    }
+    pcb->local_port = port;
+    hostPcbs.push_back(pcb);
+    return ERR_OK;
+}
+
+void
+udp_recv(struct udp_pcb* pcb, udp_recv_fn recv, void* recv_arg)
+{
+    pcb->recv     = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+err_t
+udp_sendto(struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* dst_ip, u16_t dst_port)
+{
+    static uint32_t sends = 0;
+    if(WiFiUDP::hostTxLimit && p->tot_len > WiFiUDP::hostTxLimit) {
+        return ERR_VAL;
+    }
+    if((int)(sends++ % 100) < WiFiUDP::hostFailRate) {
+        return ERR_MEM;
+    }
+    std::string data;
+    for(struct pbuf* q = p; q; q = q->next) {
+        data.append((const char*)q->payload, q->len);
+    }
+    if(WiFiUDP::hostSend) {
+        WiFiUDP::hostSend(IPAddress(dst_ip->addr), dst_port, (const uint8_t*)data.data(), data.length());
+    }
+    return ERR_OK;
+}
+
+int
+etharp_find_addr(struct netif* netif, const ip4_addr_t* ipaddr, struct eth_addr** eth_ret, const ip4_addr_t** ip_ret)
+{
+    static struct eth_addr eth;
+    *eth_ret = &eth;
+    *ip_ret  = ipaddr;
+    return 0;
+}
+
+//---------------------------------------------------------------------------------
+//-- A bound PCB gets the datagram right away (as a two part chain), otherwise it
+//   waits for WiFiUDP::parsePacket()
+void
+WiFiUDP::hostInject(uint16_t port, IPAddress from, uint16_t fromPort, const uint8_t* data, size_t len)
+{
+    for(std::deque<struct udp_pcb*>::iterator i = hostPcbs.begin(); i != hostPcbs.end(); i++) {
+        if((*i)->local_port == port && (*i)->recv) {
+            size_t first = len / 2;
+            struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, first, PBUF_RAM);
+            memcpy(p->payload, data, first);
+            p->next = pbuf_alloc(PBUF_TRANSPORT, len - first, PBUF_RAM);
+            memcpy(p->next->payload, data + first, len - first);
+            p->tot_len = len;
+            ip_addr_t addr;
+            addr.addr = (uint32_t)from;
+            (*i)->recv((*i)->recv_arg, *i, p, &addr, fromPort);
+            return;
+        }
+    }
+    HostDatagram d;
+    d.port      = port;
+    d.from      = from;
+    d.fromPort  = fromPort;
+    d.data.assign((const char*)data, len);
+    hostInbound.push_back(d);
+}
+
+int
+WiFiUDP::parsePacket()
+{
+    for(std::deque<HostDatagram>::iterator i = hostInbound.begin(); i != hostInbound.end(); i++) {
+        if(i->port == _port) {
+            _in           = i->data;
+            _in_pos       = 0;
+            _remote_ip    = i->from;
+            _remote_port  = i->fromPort;
+            hostInbound.erase(i);
+            return _in.length();
+        }
+    }
+    _in.clear();
+    _in_pos = 0;
+    return 0;
+}
+
+int
+WiFiUDP::read()
+{
+    return _in_pos < _in.length() ? (uint8_t)_in[_in_pos++] : -1;
+}
+
+int
+WiFiUDP::read(unsigned char* buffer, size_t len)
+{
+    len = min(len, _in.length() - _in_pos);
+    memcpy(buffer, _in.data() + _in_pos, len);
+    _in_pos += len;
+    return len;
+}
+
+int
+WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    _out.clear();
+    _out_ip   = ip;
+    _out_port = port;
+    return 1;
+}
+
+size_t
+WiFiUDP::write(const uint8_t* buffer, size_t size)
+{
+    if(hostTxLimit) {
+        size = min(size, hostTxLimit - min(hostTxLimit, _out.length()));
+    }
+    _out.append((const char*)buffer, size);
+    return size;
+}
+
+int
+WiFiUDP::endPacket()
+{
+    if(!_out.length()) {
+        return 0;
+    }
+    if(hostSend) {
+        hostSend(_out_ip, _out_port, (const uint8_t*)_out.data(), _out.length());
+    }
+    _out.clear();
+    return 1;
+}
@@ -0,0 +1,65 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2015, 2016 Gus Grubba. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file user_interface.h
+ * Host stand-in for the Espressif SDK. The bridge always sees an access
+ * point with one station attached.
+ *
+ * @author Gus Grubba <mavlink@grubba.com>
+ */
+
+#ifndef MAVESP8266_HOST_USER_INTERFACE_H
+#define MAVESP8266_HOST_USER_INTERFACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STATION_MODE    0x01
+#define SOFTAP_MODE     0x02
+
+static inline uint8_t   wifi_get_opmode             (void) { return SOFTAP_MODE; }
+static inline uint8_t   wifi_softap_get_station_num (void) { return 1; }
+static inline bool      wifi_softap_dhcps_start     (void) { return true; }
+static inline bool      wifi_softap_dhcps_stop      (void) { return true; }
+static inline int8_t    wifi_station_get_rssi       (void) { return 0; }
+
+//-- The one station, with a DHCP lease for the GCS address (see shim.cpp)
+struct station_info {
+    struct { struct station_info* stqe_next; } next;
+    uint8_t bssid[6];
+    struct { uint32_t addr; } ip;
+};
+#define STAILQ_NEXT(elm, field) ((elm)->field.stqe_next)
+
+struct station_info*    wifi_softap_get_station_info    (void);
+static inline void      wifi_softap_free_station_info   (void) {}
+
+#endif
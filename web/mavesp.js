@@ -0,0 +1,5 @@
+function $(id){return document.getElementById(id);}
+function inputblur(obj){var btn=obj.parentNode.parentNode.getElementsByTagName("button")[0];if(obj.getAttribute("oldValue")!=null){if(obj.getAttribute("oldValue")!=obj.value){btn.setAttribute("class","buttonChange")}else{btn.setAttribute("class","")}}};
+function inputfocus(obj){if(obj.getAttribute('oldValue') == null){obj.setAttribute('oldValue',obj.value)};}
+function save(obj){var input=obj.parentNode.parentNode.getElementsByTagName("input")[0];window.location.href="/setparameters?" +input.id + "=" + input.value;}
+function bindBtn(){var btns=$("configData").getElementsByTagName("button");for(var i=0;i<btns.length;i++){btns[i].onclick=function(){save(this);}}}